@@ -0,0 +1,30 @@
+#pragma once
+#include "LibHeader.h"
+
+#include <vector>
+
+class SkeletalAnimation;
+
+// clip sampled at a fixed rate into bone palettes, frame f holds bones
+// [f * boneCount, (f + 1) * boneCount) and the frame after the last is the end pose of the clip
+struct BakedAnimation
+{
+  std::vector<glm::mat4> matrices;
+  int frameCount = 0; // frames in one loop, matrices hold frameCount + 1 palettes
+  int boneCount = 0;
+  float sampleRate = 0.f; // frames per second
+  float duration = 0.f; // seconds
+
+  bool Empty() const;
+  // palette at a time in seconds, neighbouring frames are blended the same way the vertex shaders do
+  void Sample(float seconds, std::vector<glm::mat4>& palette) const;
+};
+
+namespace AnimationBaker
+{
+  // evaluates the clip through an Animator, no gl calls so it runs headless
+  BakedAnimation Bake(SkeletalAnimation& animation, float sampleRate);
+  // largest matrix element difference against an Animator, sampled halfway between
+  // frames where the blend error peaks
+  float Validate(const BakedAnimation& baked, SkeletalAnimation& animation);
+}
@@ -2,8 +2,11 @@
 #include "ManagerBase.h"
 #include "SkeletalAnimation.h"
 #include "Animator.h"
+#include "AnimationBaker.h"
+#include "MotionMatching.h"
 
 #include <memory>
+#include <vector>
 
 class AnimationManager : public ManagerBase<AnimationManager>
 {
@@ -15,9 +18,108 @@ public:
   void Update() override;
   void DrawBone(ShaderProgram* shaderProgram);
 
+  // copies of the animated model on a grid around it, each with its own playback
+  void SpawnCrowd(int count, float spacing);
+  void ClearCrowd();
+  // bake the played clip for gpu crowd playback and measure it against the animator
+  void BakeCrowdClip();
+  // load the clips of the other sections as blend layers on the animator, the
+  // played clip keeps layer 0
+  void LoadBlendClips(const std::string& playedClip);
+  // interpolate every rotation key interval of the played clip with each mode,
+  // timed scalar and batched, error measured against exact slerp
+  void BenchmarkRotationInterpolation();
+  // time the motion matching search, kd-tree against a full scan, on a synthetic database
+  // of poseSearchBenchmark.frames frames, far more than the loaded clips hold
+  void BenchmarkPoseSearch();
+  // build the database from the played and blend clips and let it drive the animator
+  // along the path, false when the rig has no feet or hips to match
+  bool StartMotionMatching();
+  void StopMotionMatching();
+
   std::unique_ptr<SkeletalAnimation> animation;
   std::unique_ptr<Animator> animator;
+  Model* model = nullptr; // skinned by the animator, owned by its object
 
   bool PlayAnimation = false;
+
+  // locomotion clips of every section sharing the skeleton, blended instead of reloaded
+  std::vector<std::unique_ptr<SkeletalAnimation>> blendClips;
+  int walkLayer = -1; // animator layers of Animation1 and Animation2
+  int runLayer = -1;
+  bool blendBySpeed = false; // weights from the path speed, otherwise crossfades from the ui
+  float walkSpeed = 0.6f; // path speed of a pure walk
+  float runSpeed = 1.2f; // and of a pure run
+  float crossFadeTime = 0.3f;
+
+  // pose search instead of the fixed loop, built on first use per loaded section
+  std::unique_ptr<MotionMatching> motionMatching;
+  bool useMotionMatching = false;
+
+  // crowd instances share the immutable clip, only the animator is per instance
+  struct CrowdInstance
+  {
+    std::unique_ptr<Animator> animator;
+    glm::mat4 modelTr = glm::mat4(1.f);
+    float phaseOffset = 0.f; // fraction of the loop at bakedTime 0, for baked playback
+    float playbackSpeed = 1.f;
+  };
+  std::vector<CrowdInstance> crowd;
+  int crowdSize = 64;
+  float crowdSpacing = 300.f;
+
+  // crowd update rate and bone set by distance to the camera
+  struct AnimationLOD
+  {
+    bool enabled = true;
+    float nearDistance = 1500.f; // full rate inside
+    float farDistance = 6000.f; // farInterval and bone culling from here on
+    int farInterval = 4; // frames per pose evaluation at farDistance
+    float cullFraction = 0.15f; // share of the skeleton reach culled past the midpoint
+    bool freezeOffscreen = true;
+  };
+  AnimationLOD lod;
+  int lodCounts[3] = { 0, 0, 0 }; // full rate, reduced, frozen in the last update
+
+  // crowd palettes read from a baked clip in the vertex shader, no per instance cpu work
+  BakedAnimation baked;
+  bool bakedPlayback = false;
+  float bakeRate = 30.f; // frames per second
+  float bakeError = 0.f; // from AnimationBaker::Validate
+  int bakeVersion = 0; // bumped per bake so the renderer uploads it once
+  float bakedTime = 0.f; // seconds
+
+  // indexed by RotationInterpolation
+  struct InterpolationBenchmark
+  {
+    float scalarMilliseconds[3] = { 0.f, 0.f, 0.f };
+    float batchMilliseconds[3] = { 0.f, 0.f, 0.f };
+    float maxError[3] = { 0.f, 0.f, 0.f }; // radians of rotation
+    // Multiply, Compose and Inverse kernels against the scalar Quaternion and VQS operators
+    float operationScalarMilliseconds[3] = { 0.f, 0.f, 0.f };
+    float operationBatchMilliseconds[3] = { 0.f, 0.f, 0.f };
+    float operationMaxError[3] = { 0.f, 0.f, 0.f }; // radians for Multiply, largest matrix entry for VQS
+    int samples = 0;
+  };
+  InterpolationBenchmark interpolationBenchmark;
+
+  struct PoseSearchBenchmark
+  {
+    int frames = 50000;
+    int queries = 0;
+    float buildMilliseconds = 0.f;
+    float treeMicroseconds = 0.f; // per query
+    float bruteForceMicroseconds = 0.f;
+    int mismatches = 0; // queries where the tree and the scan found different distances
+  };
+  PoseSearchBenchmark poseSearchBenchmark;
 private:
+  // pick interval, bone culling and visibility for every crowd instance
+  void SelectLOD();
+  // path ahead of the player in model space, as the motion matching query
+  MotionMatching::Trajectory DesiredTrajectory();
+
+  // bounding sphere of the model in its own space, padded for the animated pose
+  glm::vec3 boundsCenter = glm::vec3(0.f);
+  float boundsRadius = 0.f;
 };
@@ -1,5 +1,7 @@
 #pragma once
 #include "LibHeader.h"
+#include "PoseBuffer.h"
+#include "DualQuaternion.h"
 #include <vector>
 
 struct NodeData;
@@ -13,22 +15,90 @@ public:
 
   void UpdateAnimation(float dt);
   void PlayAnimation(SkeletalAnimation* pAnimation);
+  // jump to a time in ticks of the played animation, wrapped into the clip
+  void Seek(float time);
+
+  // clips blended on top of the played animation, layer 0 is the played animation itself;
+  // nodes are matched by name so the clip must share the skeleton
+  int AddLayer(SkeletalAnimation* clip);
+  int GetLayerCount() const;
+  SkeletalAnimation* GetLayerClip(int layer) const;
+  float GetLayerWeight(int layer) const;
+  void SetLayerWeight(int layer, float weight);
+  // move all weight onto one layer over duration seconds
+  void CrossFade(int layer, float duration);
+  // weight split between two layers, 0 is fully a and 1 fully b
+  void Blend1D(int a, int b, float parameter);
+  // start a layer at its own time in ticks, it then runs at its clip's rate instead of
+  // staying in phase with the others
+  void SeekLayer(int layer, float time);
+  float GetLayerTime(int layer) const;
 
   std::vector<glm::mat4>& GetFinalBoneMatrices();
-  std::vector<glm::mat4> GetPreOffSetMatrices();
+  // rigid part of the final matrices, converted on first use after the pose changed
+  std::vector<DualQuaternion>& GetFinalBoneDualQuaternions();
+  const std::vector<glm::mat4>& GetPreOffSetMatrices() const;
 
   float speed = 1.f;
   float SlidingSkiddingControl = 1.f;
+  bool useCompressedClip = false; // sample the packed clip instead of the raw bone tracks
+  RotationInterpolation rotationInterpolation = RotationInterpolation::CorrectedNlerp;
+
+  // level of detail, set by the owner before UpdateAnimation
+  struct LOD
+  {
+    int interval = 1; // frames per pose evaluation, the frames in between blend toward it
+    float cullFraction = 0.f; // bones with less than this share of the skeleton reach keep the bind pose
+    bool visible = true; // hidden animators keep their clock but freeze the pose
+  };
+  LOD lod;
 
   void UpdateVBO();
 
-  void CalculateBoneTransform(const NodeData* node, glm::mat4 parentTransform);
+  // sample the weighted layers into one local pose, then evaluate the flattened
+  // skeleton in one pass, parents are always ready before children
+  void CalculateBoneTransforms();
 
-  
 private:
+  struct Layer
+  {
+    SkeletalAnimation* clip = nullptr;
+    float weight = 0.f;
+    float fadeFrom = 0.f; // weight when the running crossfade started
+    bool synced = true; // follows m_Phase, otherwise its own phase
+    float phase = 0.f;
+    std::vector<int> tracks; // bone track per skeleton node, -1 when the clip does not animate it
+    std::vector<int> cursors; // last key per bone track, raw or compressed
+  };
+
+  // size per-bone and per-node buffers for the current animation, the palette holds every bone id
+  void ResizeBuffers();
+  void SampleLayer(Layer& layer, float minReach, PoseBuffer& pose);
+  // clip cycles per second of the weighted synced layers, clips of different length stay in phase
+  float PhaseRate();
+
   std::vector<glm::mat4> m_FinalBoneMatrices;
+  std::vector<DualQuaternion> m_FinalBoneDualQuaternions;
+  bool m_DualQuaternionsDirty = true;
   std::vector<glm::mat4> m_PreOffSetMatrices;
+  std::vector<glm::mat4> m_GlobalTransforms; // per skeleton node, sized once per animation
+  std::vector<Layer> m_Layers;
+  PoseBuffer m_BindPose;
+  PoseBuffer m_Pose; // blended result
+  PoseBuffer m_LayerPose; // scratch for the layer being blended in
+  std::vector<glm::mat4> m_LocalTransforms; // per skeleton node, from the blended pose
+  // key rotations gathered from every track, interpolated in one batch
+  std::vector<Quaternion> m_RotationFrom;
+  std::vector<Quaternion> m_RotationTo;
+  std::vector<float> m_RotationFactor;
+  std::vector<int> m_RotationNode;
+  std::vector<glm::mat4> m_LodFrom; // palette shown at the start of a reduced rate interval
+  std::vector<glm::mat4> m_LodTo; // palette evaluated at its end
+  int m_LodFrame = 0;
+  int m_FadeTarget = -1;
+  float m_FadeTime = 0.f;
+  float m_FadeDuration = 0.f;
   SkeletalAnimation* m_CurrentAnimation;
-  float m_CurrentTime;
+  float m_Phase = 0.f; // normalized clip time shared by every layer
   float m_DeltaTime;
 };
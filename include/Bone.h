@@ -1,57 +1,58 @@
 #pragma once
 #include "LibHeader.h"
 #include "Quaternion.h"
+#include "VQS.h"
 
 #include <vector>
 #include <string>
 
 struct aiNodeAnim;
 
-struct KeyPosition
-{
-  glm::vec3 position;
-  float timeStamp;
-};
-struct KeyRotation
-{
-  Quaternion orientation;
-  float timeStamp;
-};
-struct KeyScale
-{
-  glm::vec3 scale;
-  float timeStamp;
-};
-
 class Bone
 {
-  float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime);
-  glm::mat4 InterpolatePosition(float animationTime);
-  glm::mat4 InterpolateRotation(float animationTime);
-  glm::mat4 InterpolateScaling(float animationTime);
+  float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const;
 public:
   Bone() = default;
   ~Bone() = default;
 
   Bone(const std::string& name, int ID, const aiNodeAnim* channel);
+  // tracks already on a shared time array, from the animation cache
+  Bone(const std::string& name, int ID, std::vector<float> times, std::vector<glm::vec3> positions,
+    std::vector<Quaternion> rotations, std::vector<glm::vec3> scales);
   void Update(float animationTime);
+  // interpolated pose, does not touch the cached local transform
+  VQS Sample(float animationTime);
+  // read only sampling with the caller's key cursor, safe to share one bone between animators
+  VQS Sample(float animationTime, int& cursor,
+    RotationInterpolation mode = RotationInterpolation::CorrectedNlerp) const;
 
   glm::mat4 getLocalTransform();
+  VQS getLocalPose();
   std::string getBoneName() const;
   int getBoneID();
 
-  int getPositionIndex(float animationTime);
-  int getRotationIndex(float animationTime);
-  int getScaleIndex(float animationTime);
+  // raw tracks, every key of all three channels
+  const std::vector<float>& getTimes() const;
+  const std::vector<glm::vec3>& getPositions() const;
+  const std::vector<Quaternion>& getRotations() const;
+  const std::vector<glm::vec3>& getScales() const;
 
-private:
-  std::vector<KeyPosition> m_Positions;
-  std::vector<KeyRotation> m_Rotations;
-  std::vector<KeyScale> m_Scales;
-  int m_NumPositions;
-  int m_NumRotations;
-  int m_NumScalings;
+  // key k with times[k] <= animationTime < times[k + 1], clamped to the track
+  int getKeyIndex(float animationTime);
+  int getKeyIndex(float animationTime, int& cursor) const;
+  // key before animationTime and the factor toward the next one, for callers that
+  // interpolate many tracks at once. single key tracks return key 0 with factor 0
+  int getKeyPair(float animationTime, int& cursor, float& factor) const;
 
+private:
+  // position, rotation and scale keys resampled onto one shared time array
+  std::vector<float> m_Times;
+  std::vector<glm::vec3> m_Positions;
+  std::vector<Quaternion> m_Rotations;
+  std::vector<glm::vec3> m_Scales;
+  int m_Cursor = 0; // key of the last sample, forward playback stays on it or moves to the next
+
+  VQS m_LocalPose;
   glm::mat4 m_LocalTransform;
   std::string m_Name;
   int m_ID;
@@ -4,6 +4,7 @@
 #include "Shape.h"
 
 class ShaderProgram;
+class OcclusionCuller;
 
 class BspTree
 {
@@ -38,12 +39,16 @@ public:
   void ClearLeafNodes();
 
   void Draw(ShaderProgram* shaderProgam);
+  // occlusion culling, occluders are the largest leaves
+  void SelectOccluders(int max_leaves);
+  void RasterizeOccluders(OcclusionCuller* culler, const glm::mat4& modelTr);
 
   TreeNode* root_ = nullptr;
   int level = 0;
   int max_triangles_ = 0;
   std::vector<glm::vec3> aligned_axes_plane_normal_;
   std::vector<TreeNode*> leaf_nodes_;
+  std::vector<TreeNode*> occluder_nodes_;
 private:
   // draw tree
   std::vector<unsigned> VAOs_;
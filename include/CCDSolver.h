@@ -1,9 +1,18 @@
 #pragma once
 #include "Bone.h"
 
+enum class IKConstraint
+{
+  None,
+  Hinge,
+  BallSocket
+};
+
 struct IKData
 {
-  std::string name;
+  int boneID = -1; // slot in the bone matrices
+  IKConstraint constraint = IKConstraint::None;
+  float coneLimit = 0.f; // radians, ball and socket only
   glm::vec3 worldPosition;
   glm::vec3 localPosition;
   Quaternion worldRotation;
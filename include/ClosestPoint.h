@@ -0,0 +1,37 @@
+#pragma once
+#include "LibHeader.h"
+
+// point-primitive closest point kernels shared by distance queries
+namespace ClosestPoint
+{
+  // 4 triangles in SoA layout, one sse register per coordinate
+  struct alignas(16) Triangle4
+  {
+    float ax[4], ay[4], az[4];
+    float bx[4], by[4], bz[4];
+    float cx[4], cy[4], cz[4];
+
+    void Set(int lane, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
+  };
+
+  // closest point on segment AB to P, t is the parameter along AB
+  glm::vec3 PointSegment(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, float& t);
+
+  // closest point on triangle ABC to P (voronoi region test)
+  glm::vec3 PointTriangle(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
+  // same, weights receives barycentric coordinates, vertices outside the region get exactly 0
+  glm::vec3 PointTriangle(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C, glm::vec3& weights);
+
+  // closest point on 4 triangles at once, writes squared distance and point per lane,
+  // optional outV / outW receive the barycentric weights of B and C
+  void PointTriangle4(const glm::vec3& P, const Triangle4& tri, float outDistSq[4], glm::vec3 outPoint[4],
+    float outV[4] = nullptr, float outW[4] = nullptr);
+
+  // closest point on solid tetrahedron ABCD to P, P itself when inside,
+  // the 4 faces are evaluated in one PointTriangle4 call
+  glm::vec3 PointTetrahedron(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C,
+    const glm::vec3& D, glm::vec4& weights);
+
+  // squared distance from P to aabb, 0 if P is inside
+  float PointAABBDistSq(const glm::vec3& P, const glm::vec3& min, const glm::vec3& max);
+}
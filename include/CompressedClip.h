@@ -0,0 +1,76 @@
+#pragma once
+#include "LibHeader.h"
+#include "VQS.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Bone;
+struct FlatSkeleton;
+
+struct ClipCompressionSettings
+{
+  // largest displacement a dropped key may cause at the tip of the bone's subtree,
+  // rotation and scale tolerances of each bone are derived from it and the subtree reach
+  float positionError = 0.01f;
+  float maxAngleError = 0.01f; // radians, used for leaf bones
+  std::unordered_map<std::string, float> boneError; // positionError override per bone name
+};
+
+// animation clip packed into 20 byte keys: 48-bit smallest-three rotation, 16-bit time and
+// range-quantized translation and scale, keys that interpolation reproduces within the
+// bone tolerance are dropped. sampling decodes straight from the packed stream
+class CompressedClip
+{
+public:
+  using Settings = ClipCompressionSettings;
+
+  CompressedClip() = default;
+
+  // tracks follow the order of bones
+  void Compress(const std::vector<Bone>& bones, const FlatSkeleton& skeleton, float duration,
+    const Settings& settings = Settings());
+  void Clear();
+  bool Empty() const;
+
+  // pose of a track, cursor is the caller's last key of that track (one per animator)
+  VQS Sample(int track, float animationTime, int& cursor,
+    RotationInterpolation mode = RotationInterpolation::CorrectedNlerp) const;
+
+  int GetTrackCount() const;
+  int GetKeyCount() const;
+  size_t GetMemory() const; // bytes
+
+private:
+  struct PackedKey
+  {
+    uint16_t time;
+    uint16_t rotation[3];
+    uint16_t translation[3];
+    uint16_t scale[3];
+  };
+
+  struct Track
+  {
+    uint32_t firstKey = 0;
+    uint32_t keyCount = 0;
+    glm::vec3 translationMin = {};
+    glm::vec3 translationExtent = {};
+    glm::vec3 scaleMin = {};
+    glm::vec3 scaleExtent = {};
+  };
+
+  static void EncodeRotation(Quaternion q, uint16_t* out);
+  static Quaternion DecodeRotation(const uint16_t* in);
+  static void EncodeRange(const glm::vec3& v, const glm::vec3& min, const glm::vec3& extent, uint16_t* out);
+  static glm::vec3 DecodeRange(const uint16_t* in, const glm::vec3& min, const glm::vec3& extent);
+
+  float KeyTime(const PackedKey& key) const;
+  int KeyIndex(const Track& track, float animationTime, int& cursor) const;
+
+  std::vector<Track> tracks_;
+  std::vector<PackedKey> keys_;
+  float duration_ = 0.f;
+};
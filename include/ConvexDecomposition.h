@@ -0,0 +1,67 @@
+#pragma once
+#include "LibHeader.h"
+#include "ConvexHull.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DecompositionParameters
+{
+  int resolution = 48; // voxels along the longest axis
+  int maxPieces = 32;
+  int maxDepth = 8; // splits per branch
+  int planesPerAxis = 8; // candidate cut planes tested per axis
+  float concavity = 0.02f; // (hull volume - part volume) / mesh volume accepted as convex
+};
+
+// approximate convex decomposition of a triangle mesh (v-hacd style), the mesh is
+// voxelized and split by axis aligned planes until every part is nearly convex
+class ConvexDecomposition
+{
+public:
+  using Parameters = DecompositionParameters;
+  struct Piece
+  {
+    ConvexHull hull_;
+    glm::vec3 min_ = {}; // bounds of the hull vertices
+    glm::vec3 max_ = {};
+  };
+
+  ConvexDecomposition() = default;
+
+  void Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+    const Parameters& params = Parameters());
+  // reads <cacheDir>/<hash>.hulls when it matches the mesh and parameters, otherwise builds and writes it
+  void BuildCached(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+    const std::string& cacheDir, const Parameters& params = Parameters());
+  void Clear();
+  bool Empty() const;
+
+  bool Save(const std::string& path, uint64_t key) const;
+  bool Load(const std::string& path, uint64_t key);
+
+  std::vector<Piece> pieces_;
+private:
+  struct Part
+  {
+    std::vector<glm::ivec3> voxels_;
+    float concavity_ = 0.f;
+    int depth_ = 0;
+  };
+
+  void Voxelize(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices, int resolution);
+  void HullPoints(const std::vector<glm::ivec3>& voxels, std::vector<glm::vec3>& points) const;
+  float Concavity(const std::vector<glm::ivec3>& voxels) const;
+  bool Split(const Part& part, const Parameters& params, Part& left, Part& right) const;
+  void AddPiece(const std::vector<glm::ivec3>& voxels);
+
+  static uint64_t Hash(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+    const Parameters& params);
+
+  // voxel grid, only alive during Build
+  std::vector<unsigned char> grid_;
+  glm::vec3 origin_ = {};
+  float voxelSize_ = 0.f;
+  glm::ivec3 dims_ = {};
+  float meshVolume_ = 0.f;
+};
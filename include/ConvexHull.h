@@ -0,0 +1,44 @@
+#pragma once
+#include "LibHeader.h"
+#include <vector>
+
+// 3D convex hull built with quickhull, keeps vertex adjacency so support
+// queries can hill-climb from the previous support vertex
+class ConvexHull
+{
+public:
+  ConvexHull() = default;
+  ConvexHull(const std::vector<glm::vec3>& points);
+  ConvexHull(const std::vector<glm::vec4>& points);
+
+  void Build(const std::vector<glm::vec3>& points);
+  void Clear();
+  bool Empty() const;
+
+  // furthest hull vertex along dir, hint is the start vertex and receives the result
+  glm::vec3 Support(const glm::vec3& dir, int& hint) const;
+  int SupportIndex(const glm::vec3& dir, int& hint) const;
+
+  std::vector<glm::vec3> vertices_;
+  std::vector<glm::ivec3> faces_; // ccw seen from outside
+  // neighbors of vertex i are adjacency_[adjacencyOffset_[i] .. adjacencyOffset_[i + 1])
+  std::vector<int> adjacencyOffset_;
+  std::vector<int> adjacency_;
+private:
+  struct Face
+  {
+    int v[3];
+    int adj[3]; // face across edge v[i] -> v[(i + 1) % 3]
+    glm::vec3 n;
+    float d;
+    std::vector<int> outside;
+    bool alive = true;
+    bool visited = false;
+  };
+
+  int AddFace(std::vector<Face>& faces, const std::vector<glm::vec3>& points, int a, int b, int c);
+  void ComputeHorizon(std::vector<Face>& faces, const glm::vec3& eye, int face, int enterEdge,
+    std::vector<int>& visible, std::vector<glm::ivec3>& horizon, float eps);
+  void BuildFromFaces(const std::vector<Face>& faces, const std::vector<glm::vec3>& points);
+  void BuildFallback(const std::vector<glm::vec3>& points);
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include "Quaternion.h"
+#include "VQS.h"
+#include <glm/glm/vec4.hpp>
+
+// rigid transform as a real and a dual quaternion, blends of these keep volume where
+// linear blend skinning collapses twisting joints. scale is not represented
+class DualQuaternion
+{
+public:
+  DualQuaternion() = default;
+  ~DualQuaternion() = default;
+
+  DualQuaternion(Quaternion rotation, glm::vec3 translation);
+  // scale of the vqs is dropped
+  DualQuaternion(const VQS& vqs);
+  // rigid part of an affine matrix, the basis columns are normalized first
+  static DualQuaternion FromMatrix(const glm::mat4& m);
+
+  // apply rhs first, then this
+  DualQuaternion operator*(const DualQuaternion& rhs) const;
+  DualQuaternion operator*(float s) const;
+  DualQuaternion operator+(const DualQuaternion& rhs) const;
+  // unit length real part, required after blending
+  DualQuaternion normalize() const;
+
+  glm::vec3 transformPoint(const glm::vec3& p) const;
+  glm::vec3 transformVector(const glm::vec3& v) const;
+
+  Quaternion getRotation() const;
+  glm::vec3 getTranslation() const;
+  glm::mat4 toMat4() const;
+
+  // x, y, z, w like the shader palette, two vec4 per bone
+  glm::vec4 real = glm::vec4(0.f, 0.f, 0.f, 1.f);
+  glm::vec4 dual = glm::vec4(0.f);
+};
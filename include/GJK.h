@@ -1,9 +1,13 @@
 #pragma once
 #include "Shape.h"
 #include "Octree.h"
+#include "ConvexHull.h"
+#include "Quaternion.h"
 #include <vector>
 
 class ShaderProgram;
+class MeshBVH;
+class ConvexDecomposition;
 
 class Simplex
 {
@@ -28,33 +32,146 @@ private:
 
 namespace GJK
 {
-  bool Run(
-    const std::vector<glm::vec4>& objectVertices,
-    const std::vector<glm::ivec3>& objectIndices,
-    const glm::vec3& objectCenter,
-    const std::vector<glm::vec4>& modelVertices,
-    const std::vector<glm::ivec3>& modelIndices,
-    const glm::vec3& modelCenter
-  );
-  glm::vec3 supportFunction(
-    glm::vec3 dir,
-    const std::vector<glm::vec4>& objectVertices,
-    const std::vector<glm::ivec3>& objectIndices,
-    const std::vector<glm::vec4>& modelVertices,
-    const std::vector<glm::ivec3>& modelIndices
-  );
-  glm::vec3 getFurthestPoint(glm::vec3 dir, 
-    const std::vector<glm::vec4>& vertices,
-    const std::vector<glm::ivec3>& indices
-  );
-  bool handleSimplex(
-    Simplex* simplex, glm::vec3& dir
-  );
-  bool DetectCollision_BroadPhase(Object* S, Octree::TreeNode* node);
-  bool DetectCollision_MidPhase(Object* S, Octree::TreeNode* node);
-  bool DetectCollision_NarrowPhase(Object* S, Octree::TreeNode* node);
-  glm::vec3 ClosestPointOnPoint(const glm::vec3& X, const glm::vec3& P);
-  glm::vec3 ClosestPointOnLineSegment(const glm::vec3& X, const glm::vec3& P0, const glm::vec3& P1);
-  glm::vec3 ClosestPointOnTriangle(const glm::vec3& X, const glm::vec3& P0, const glm::vec3& P1, const glm::vec3& P2);
-  glm::vec3 ClosestPointOnTetraHedron(const glm::vec3& X, const glm::vec3& P0, const glm::vec3& P1, const glm::vec3& P2, const glm::vec3& P3);
+  // convex shape for gjk, support query runs on the hull in local space
+  // by rotating the search direction, vertices are never transformed up front
+  struct Collider
+  {
+    Collider() = default;
+    Collider(const ConvexHull* hull, const glm::vec3& position, const Quaternion& orientation,
+      const glm::vec3& scale, int hint = 0);
+
+    // world space support point along world space dir
+    glm::vec3 Support(const glm::vec3& dir);
+
+    const ConvexHull* hull_ = nullptr;
+    glm::vec3 position_ = {};
+    Quaternion orientation_;
+    Quaternion inverse_; // conjugate of orientation_
+    glm::vec3 scale_ = { 1.f,1.f,1.f };
+    int hint_ = 0; // last support vertex, start of hill climbing
+  };
+
+  // point of the minkowski difference with the witness points that produced it
+  struct SupportPoint
+  {
+    glm::vec3 p = {}; // a - b
+    glm::vec3 a = {}; // on object
+    glm::vec3 b = {}; // on model
+  };
+
+  // normal points from object into model, object moves by -normal * depth to separate
+  struct Contact
+  {
+    glm::vec3 normal = {};
+    float depth = 0.f;
+    glm::vec3 pointA = {}; // deepest point of object inside model
+    glm::vec3 pointB = {}; // deepest point of model inside object
+  };
+
+  // up to 4 contact points kept between frames, points are anchored in local
+  // space of both shapes and dropped once they separate or slide too far
+  struct ContactManifold
+  {
+    static constexpr int MAX_POINTS = 4;
+
+    // re-evaluate cached points with the current transforms
+    void Refresh(const glm::mat4& transformA, const glm::mat4& transformB);
+    // merge a new contact, replaces a nearby point or the least useful one when full
+    void Add(const Contact& contact, const glm::mat4& transformA, const glm::mat4& transformB);
+    void Clear();
+
+    Contact points[MAX_POINTS];
+    glm::vec3 localA[MAX_POINTS];
+    glm::vec3 localB[MAX_POINTS];
+    int count = 0;
+    float breakingThreshold = 2.f; // world units, scene is in the thousands
+  };
+
+  // state of a pair kept between frames to warm start the next query
+  struct SimplexCache
+  {
+    glm::vec3 dir = {}; // last search direction
+    int hintA = 0; // last support vertices on both hulls
+    int hintB = 0;
+    int count = 0; // simplex size of the last query, 0 = cold start
+  };
+
+  struct Result
+  {
+    SupportPoint simplex[4]; // newest point first
+    int count = 0;
+    int iterations = 0;
+    bool hit = false;
+    Contact contact; // valid when hit and contact was requested
+  };
+
+  // closest features of two separated shapes
+  struct DistanceResult
+  {
+    SupportPoint simplex[4]; // vertices of the closest feature
+    int count = 0;
+    int iterations = 0;
+    bool overlap = false;
+    float distance = 0.f;
+    glm::vec3 normal = {}; // from model toward object
+    glm::vec3 pointA = {}; // closest point on object
+    glm::vec3 pointB = {}; // closest point on model
+  };
+
+  // first contact of two linearly moving shapes, t in [0, 1] along the motion
+  struct ImpactResult
+  {
+    SupportPoint simplex[4];
+    int count = 0;
+    int iterations = 0;
+    bool hit = false;
+    float t = 0.f;
+    glm::vec3 normal = {}; // from model toward object at contact
+    glm::vec3 pointA = {};
+    glm::vec3 pointB = {};
+  };
+
+  // one object against one overlapping octree leaf
+  struct CollisionPair
+  {
+    Object* object = nullptr;
+    Octree::TreeNode* node = nullptr;
+    float enter = 0.f; // entry time of the swept box, 0 for static queries
+    SimplexCache* cache = nullptr; // resolved before the parallel narrow phase
+    Collider objectCollider;
+    Collider modelCollider;
+    // exact triangle test after the hull test, skipped when either mesh is null
+    const MeshBVH* objectMesh = nullptr;
+    const MeshBVH* modelMesh = nullptr;
+    glm::mat4 objectToModel = glm::mat4(1.f);
+    glm::vec3 regionMin = {}; // leaf box in model space
+    glm::vec3 regionMax = {};
+    // convex pieces of the model inside the leaf replace the leaf box when set
+    const ConvexDecomposition* pieces = nullptr;
+    Collider shapeCollider; // object's own hull
+    Collider pieceCollider; // model transform, hull is set per piece
+    Result result;
+  };
+
+  // reentrant, allocation free intersection query, EPA runs when computeContact is set
+  bool Run(Collider& object, Collider& model, Result& result,
+    SimplexCache* cache = nullptr, bool computeContact = true);
+  // gjk distance query, returns false when the shapes overlap
+  bool Distance(Collider& object, Collider& model, DistanceResult& result, SimplexCache* cache = nullptr);
+  // conservative advancement over the given translations
+  bool TimeOfImpact(Collider& object, const glm::vec3& motionA, Collider& model, const glm::vec3& motionB,
+    ImpactResult& result, float tolerance = 0.01f);
+  SupportPoint supportFunction(glm::vec3 dir, Collider& object, Collider& model);
+  // expanding polytope from a tetrahedron that contains the origin
+  bool EPA(Collider& object, Collider& model, const SupportPoint* simplex, Contact& contact);
+  // collect pairs of all objects into one batch, run them in parallel, then merge contacts on the calling thread
+  bool DetectCollision_BroadPhase(const std::vector<Object*>& objects, Octree::TreeNode* node);
+  // appends every leaf whose aabb overlaps S, iterative traversal
+  void CollectPairs(Object* S, Octree::TreeNode* root, std::vector<CollisionPair>& pairs);
+  // returns number of colliding pairs, results are written into each pair
+  int DetectCollision_NarrowPhase(std::vector<CollisionPair>& pairs);
+  // leaves hit by the box of S swept along motion, sorted by entry time
+  void CollectPairsSwept(Object* S, const glm::vec3& motion, Octree::TreeNode* root, std::vector<CollisionPair>& pairs);
+  // earliest time of impact of S moving by motion, toi is in [0, 1]
+  bool DetectCollision_Continuous(Object* S, const glm::vec3& motion, Octree::TreeNode* node, float& toi);
 }
@@ -4,7 +4,7 @@
 
 class Object;
 class ShaderProgram;
-struct NodeData;
+struct FlatSkeleton;
 
 class InverseKinematicManager : public ManagerBase<InverseKinematicManager>
 {
@@ -57,10 +57,16 @@ private:
   unsigned keyFrame;
   unsigned jointIndex;
 
-  void ApplyTransformationHierarchy(const NodeData* node,
+  // one forward pass over the skeleton, chain joints take their solved transform and the
+  // bones below a chain joint follow it
+  void ApplyTransformationHierarchy(const FlatSkeleton& skeleton,
     std::vector<std::vector<IKData>>& intermediateValue,
     unsigned keyFrame,
-    float step,
-    std::vector<glm::mat4>& preOffSetMatrices, glm::mat4 parentTransform, bool enterIKChain);
-  bool isInsideIKChain(const std::string& name, int& index);
+    std::vector<glm::mat4>& preOffSetMatrices);
+  // chain joint of every bone id, rebuilt whenever the chain is solved
+  void BuildChainIndex(int boneCount);
+  std::vector<int> m_ChainIndex; // -1 outside the IK chain
+  // per skeleton node, transform passed down from the closest chain joint above
+  std::vector<glm::mat4> m_ParentTransform;
+  std::vector<char> m_BelowChain;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <limits>
+#include <vector>
+
+constexpr unsigned KDTREE_LEAF_SIZE = 16;
+
+// static kd-tree over points of any dimension for exact nearest neighbour queries, points
+// are copied in leaf order and padded to whole sse registers so leaves are scanned 4 wide
+class KDTree
+{
+public:
+  struct Node
+  {
+    float split_ = 0.f;
+    int axis_ = -1; // -1 for leaves
+    unsigned first_ = 0; // leaf: first point, internal: left child (right = first_ + 1)
+    unsigned count_ = 0; // leaf: point count, internal: 0
+  };
+
+  KDTree() = default;
+
+  // points are count rows of dimension floats
+  void Build(const std::vector<float>& points, unsigned dimension);
+  void Clear();
+  bool Empty() const;
+
+  // index of the closest point in build order and its squared distance, -1 when empty or
+  // when the query holds a nan
+  int Nearest(const float* query, float& distSq) const;
+  // same answer by scanning every point, for checking and timing the tree
+  int NearestBruteForce(const float* query, float& distSq) const;
+
+  unsigned GetDimension() const;
+  unsigned GetCount() const;
+private:
+  void BuildRec(unsigned nodeIndex, unsigned begin, unsigned end, const std::vector<float>& points,
+    std::vector<unsigned>& order);
+  // squared distance of the padded query to stored row i
+  float DistanceSq(const float* query, unsigned row) const;
+
+  std::vector<Node> nodes_;
+  std::vector<float> rows_; // stride_ floats per point, zero padded
+  std::vector<unsigned> index_; // build order index per row
+  unsigned dimension_ = 0;
+  unsigned stride_ = 0;
+};
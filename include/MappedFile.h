@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+// fnv-1a over size bytes, pass a previous result as seed to hash several buffers as one stream
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED);
+
+// read-only view of a whole file mapped into memory, unmapped on destruction
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::string& path);
+  void Close();
+  bool IsOpen() const;
+
+  const unsigned char* Data() const;
+  size_t Size() const;
+
+private:
+  const unsigned char* data_ = nullptr;
+  size_t size_ = 0;
+  void* file_ = nullptr; // platform handles
+  void* mapping_ = nullptr;
+};
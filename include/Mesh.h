@@ -44,8 +44,21 @@ public:
     std::vector<glm::vec4> weights,
     std::vector<unsigned int> indices, std::vector<Texture> textures);
 
+  // meshes are copied around by value while loading, so the owning model releases the gl objects
+  void Release();
+
   // render the mesh
   void Draw(ShaderProgram* shader);
+  // bind pose vao drawn once per instance, skinning happens in the vertex shader
+  void DrawInstanced(ShaderProgram* shader, int instanceCount);
+
+  // skinned position and normal per vertex (interleaved), written once per frame by the
+  // skinning pass and drawn as a static mesh by every later pass
+  void SetupSkinnedBuffer();
+  unsigned int skinnedVAO = 0;
+  unsigned int skinnedVBO = 0;
+  bool preSkinned = false;
+  std::vector<glm::vec3> skinnedVertices; // cpu skinning output
 
   // render normals
   void DrawVertexNormals();
@@ -69,6 +82,7 @@ private:
 
   // initializes all the buffer objects/arrays
   void setupMesh();
+  void BindTextures(ShaderProgram* shader);
 
   void setupVertexNormalDebug();
   void setupFaceNormalDebug();
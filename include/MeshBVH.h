@@ -0,0 +1,62 @@
+#pragma once
+#include "LibHeader.h"
+#include "ClosestPoint.h"
+#include <limits>
+#include <vector>
+
+constexpr unsigned BVH_LEAF_SIZE = 4; // one Triangle4 packet per leaf
+
+// static triangle bvh for distance queries on model geometry (model space)
+class MeshBVH
+{
+public:
+  struct Node
+  {
+    glm::vec3 min_;
+    unsigned first_ = 0; // leaf: packet index, internal: left child (right = first_ + 1)
+    glm::vec3 max_;
+    unsigned count_ = 0; // leaf: triangle count, internal: 0
+  };
+  struct Hit
+  {
+    glm::vec3 point_;
+    float distSq_ = std::numeric_limits<float>::max();
+    unsigned triangle_ = 0; // index of first vertex index / 3
+  };
+  struct TrianglePair
+  {
+    unsigned triangle_ = 0; // triangle of this bvh
+    unsigned otherTriangle_ = 0; // triangle of the other bvh
+  };
+
+  MeshBVH() = default;
+  MeshBVH(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+
+  void Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+  void Clear();
+  bool Empty() const;
+
+  // closest surface point to P, returns false if nothing within maxDist
+  bool ClosestPoint(const glm::vec3& P, Hit& out,
+    float maxDist = std::numeric_limits<float>::max()) const;
+  // k closest triangles sorted by distance
+  void KNearest(const glm::vec3& P, unsigned k, std::vector<Hit>& out) const;
+  // all triangles within radius (unsorted)
+  void WithinRadius(const glm::vec3& P, float radius, std::vector<Hit>& out) const;
+
+  // traverse both hierarchies together (bvtt), other is mapped into this space by otherToThis,
+  // only triangles of this overlapping [regionMin, regionMax] count, stops at the first hit
+  // unless pairs is given
+  bool Intersect(const MeshBVH& other, const glm::mat4& otherToThis, const glm::vec3& regionMin,
+    const glm::vec3& regionMax, std::vector<TrianglePair>* pairs = nullptr) const;
+
+  const std::vector<Node>& GetNodes() const;
+private:
+  void BuildRec(unsigned nodeIndex, unsigned begin, unsigned end,
+    const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+    const std::vector<glm::vec3>& centroids, std::vector<unsigned>& triangles);
+
+  std::vector<Node> nodes_;
+  std::vector<ClosestPoint::Triangle4> packets_;
+  std::vector<unsigned> packetTriangles_; // triangle index per packet lane
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include <map>
+#include <unordered_map>
 
 #include "Mesh.h"
 #include "Shader.h"
@@ -18,10 +18,23 @@ namespace AssimpHelper
   glm::mat4 ConvertRowMajorToColumnMajor(aiMatrix4x4& assimpMatrix);
 }
 
-struct BoneInfo
+// bone names interned into dense ids while loading, ids index the bone matrix palette
+// and every per bone array, names are only looked up again when something is loaded
+class BoneTable
 {
-  int id;
-  glm::mat4 offset;
+public:
+  // id of name, a new name gets the next id and its offset
+  int Intern(const std::string& name, const glm::mat4& offset = glm::mat4(1.f));
+  // -1 when the name was never interned
+  int Find(const std::string& name) const;
+  int Size() const;
+  const std::string& Name(int id) const;
+  // mesh to bone space, identity for bones that only animate
+  const glm::mat4& Offset(int id) const;
+private:
+  std::unordered_map<std::string, int> m_IDs;
+  std::vector<std::string> m_Names;
+  std::vector<glm::mat4> m_Offsets;
 };
 
 class Model
@@ -36,16 +49,17 @@ public:
 
   // constructor, expects a filepath to a 3D model.
   Model(std::string const& path, bool gamma = false);
+  ~Model();
 
   // draws the model, and thus all its meshes
   void Draw(ShaderProgram* shader);
+  void DrawInstanced(ShaderProgram* shader, int instanceCount);
 
   void DrawVertexNormals();
   void DrawFaceNormals();
 
   // animation
-  std::map<std::string, BoneInfo>& getBoneInfoMap();
-  int& getBoneCount();
+  BoneTable& getBoneTable();
 private:
   // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
   void loadModel(std::string const& path);
@@ -60,8 +74,7 @@ private:
   std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
 
   // animation
-  std::map<std::string, BoneInfo> m_BoneInfoMap;
-  int m_BoneCounter = 0;
+  BoneTable m_BoneTable;
 
   void SetVertexBoneDataToDefault(glm::ivec4& m_BoneIDs, glm::vec4& m_Weights);
   void SetVertexBoneData(glm::ivec4& m_BoneIDs, glm::vec4& m_Weights, int boneID, float weight);
@@ -0,0 +1,94 @@
+#pragma once
+#include "LibHeader.h"
+#include "KDTree.h"
+#include <string>
+#include <vector>
+
+class Animator;
+class SkeletalAnimation;
+
+struct MotionMatchingSettings
+{
+  float sampleRate = 30.f; // database frames per second
+  float trajectoryStep = 1.f / 3.f; // seconds between trajectory samples
+  float searchInterval = 0.1f; // seconds between searches
+  float blendTime = 0.2f; // crossfade into a new frame
+  float sameClipWindow = 0.2f; // seconds, a match this close to the playing frame is not a jump
+  // feature group weights
+  float footWeight = 0.75f;
+  float hipVelocityWeight = 1.f;
+  float trajectoryPositionWeight = 1.f;
+  float trajectoryDirectionWeight = 1.5f;
+  // matched case insensitively against the bone names, mixamo rigs use these
+  std::string leftFoot = "leftfoot";
+  std::string rightFoot = "rightfoot";
+  std::string hips = "hips";
+};
+
+// motion matching over every frame of a set of clips sharing the skeleton. a frame is
+// described by its foot positions, hip velocity and the root trajectory of the next second
+// in character space; the frame closest to the current pose and the desired path is
+// searched every few frames and crossfaded in on the animator.
+// the clips are expected in place or with root motion facing +z in model space, the root
+// is the hip on the ground and it moves at the speed the planted foot slides under it
+class MotionMatching
+{
+public:
+  static constexpr int TRAJECTORY_SAMPLES = 3;
+  // left foot 3, right foot 3, hip velocity 3, trajectory positions and directions 2 each
+  static constexpr int FEATURE_COUNT = 9 + 4 * TRAJECTORY_SAMPLES;
+
+  using Settings = MotionMatchingSettings;
+
+  // wanted root path in model space, positions are relative to the model origin
+  struct Trajectory
+  {
+    glm::vec2 position[TRAJECTORY_SAMPLES]; // x, z
+    glm::vec2 direction[TRAJECTORY_SAMPLES];
+  };
+
+  // sample every clip through a scratch animator and index the frames, false when the
+  // feet or hips are not found
+  bool Build(const std::vector<SkeletalAnimation*>& clips, const Settings& settings = Settings());
+  void Clear();
+  bool Empty() const;
+
+  // add two layers per clip to the animator, so a clip can also fade into itself; the
+  // layers stay on the animator after a stop and are picked up again by the next attach
+  void Attach(Animator& animator);
+  // search when the interval has passed and crossfade to a better frame
+  void Update(Animator& animator, const Trajectory& desired, float dt);
+
+  Settings settings;
+  bool useKDTree = true; // otherwise brute force, for comparison
+  // stats of the last search
+  float searchMicroseconds = 0.f;
+  float matchCost = 0.f;
+  int matchedFrame = -1;
+  int transitions = 0;
+
+  int GetFrameCount() const;
+private:
+  struct Frame
+  {
+    int clip = 0;
+    float time = 0.f; // ticks
+  };
+
+  // frame of the database the active layer is closest to
+  int CurrentFrame(const Animator& animator) const;
+  void Normalize(const float* raw, float* normalized) const;
+
+  std::vector<SkeletalAnimation*> m_Clips;
+  std::vector<int> m_ClipFirstFrame; // database frame of each clip's time 0, plus the end
+  std::vector<Frame> m_Frames;
+  std::vector<float> m_Features; // normalized, FEATURE_COUNT per frame
+  float m_Offset[FEATURE_COUNT] = {}; // mean
+  float m_Scale[FEATURE_COUNT] = {}; // weight / deviation of the feature group
+  KDTree m_Tree;
+  int m_HipBone = -1; // palette slot of the hips, for the query root
+
+  std::vector<int> m_Layers; // two per clip on the attached animator
+  int m_ActiveLayer = -1; // index into m_Layers
+  float m_SearchTimer = 0.f;
+};
@@ -52,6 +52,7 @@ public:
   float tiling = 10.f;
 
   bool isWireFrame = false;
+  bool isVisible = true; // false when occlusion culled
 
   Physics* physics = nullptr;
 private:
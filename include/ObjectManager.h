@@ -5,10 +5,14 @@
 #include "BoundingVolume.h"
 #include "RenderManager.h"
 #include "Octree.h"
+#include "GJK.h"
+#include <map>
 
-class Simplex;
 class BspTree;
 class ShaderProgram;
+class OcclusionCuller;
+class MeshBVH;
+class ConvexDecomposition;
 
 class ObjectManager : public ManagerBase<ObjectManager>
 {
@@ -34,14 +38,61 @@ public:
     bool treeReady = false;
     bool treeEmpty = true;
   };
+  struct OcclusionController
+  {
+    void Cull(Octree::TreeNode** node);
+    void Reset(Octree::TreeNode** node);
+    // flag the nodes containing occluder triangles, point is a triangle center in world space
+    void MarkOccluder(Octree::TreeNode** node, const glm::vec3& point);
+    void ClearOccluders(Octree::TreeNode** node);
+    OcclusionCuller* culler = nullptr;
+    // model space bounds of every loaded section, models are culled one section at a time
+    std::vector<glm::vec3> sectionMin;
+    std::vector<glm::vec3> sectionMax;
+    int width = 256;
+    int height = 128;
+    int max_occluders = 64; // largest bsp leaves drawn into depth buffer
+    bool enableFlag = false;
+    bool occluderDirty = true;
+    bool active = false;
+    int visibleNodes = 0;
+    int culledNodes = 0;
+  };
+  struct ClosestPointController
+  {
+    MeshBVH* bvh = nullptr; // built from total model geometry on load
+    unsigned k = 8;
+    bool enableFlag = false;
+    glm::vec3 point = {};
+    float distance = 0.f;
+    unsigned triangle = 0;
+    std::vector<unsigned> nearestTriangles;
+  };
   struct GJK_Controller
   {
+    // persistent contacts of one colliding pair
+    struct CachedManifold
+    {
+      Object* objectA = nullptr; // bounding volume objects of the pair
+      Object* objectB = nullptr;
+      GJK::ContactManifold manifold;
+    };
+    void RefreshManifolds();
+    std::map<std::pair<const void*, const void*>, CachedManifold> manifolds;
+    std::map<std::pair<const void*, const void*>, GJK::SimplexCache> simplexCache; // warm start per pair
+    std::vector<GJK::CollisionPair> pairs; // overlapping leaves of the last query
+    GJK::Contact contact; // deepest contact found by EPA
+
     Simplex* simplex = nullptr;
     glm::vec3 dir;
     bool startFlag = false;
     bool stopFlag = false;
     bool resetFlag = false;
     bool updateSpherePos = true;
+    bool continuous = true; // time of impact sweep instead of discrete steps
+    bool exact = true; // triangle level test after the bounding box gjk
+    bool convexPieces = true; // gjk against the model's convex decomposition inside hit leaves
+    ConvexDecomposition* decomposition = nullptr; // built on load, cached in ./cache
   };
 public:
   ObjectManager() = default;
@@ -70,6 +121,8 @@ public:
 
   OctreeController octreeController;
   BspTreeController bsptreeConroller;
+  OcclusionController occlusionController;
+  ClosestPointController closestPointController;
   GJK_Controller gjkController;
 
   bool renderModel = true;
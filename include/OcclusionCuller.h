@@ -0,0 +1,48 @@
+#pragma once
+#include "LibHeader.h"
+#include <vector>
+
+// CPU software depth rasterizer + hierarchical-z (Hi-Z) pyramid
+// occluders are drawn at low resolution, then bounding boxes are tested
+// against the farthest depth stored in the pyramid
+class OcclusionCuller
+{
+public:
+  OcclusionCuller() = default;
+  OcclusionCuller(int width, int height);
+  ~OcclusionCuller() = default;
+
+  void Resize(int width, int height);
+
+  // clear depth buffer and save camera matrices for this frame
+  void BeginFrame(const glm::mat4& worldProj, const glm::mat4& worldView);
+
+  // rasterize triangle list (3 indices per triangle) into depth buffer
+  void RasterizeOccluder(const std::vector<glm::vec3>& vertices,
+    const std::vector<unsigned int>& indices,
+    const glm::mat4& modelTr);
+
+  // build max-depth mip chain from depth buffer (call once after all occluders)
+  void BuildHiZ();
+
+  // world space aabb test, false if box is off screen or fully hidden behind occluders
+  bool IsVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+  int GetWidth() const;
+  int GetHeight() const;
+  int GetLevelCount() const;
+  const std::vector<float>& GetDepthBuffer() const;
+
+  unsigned rasterizedTriangles = 0;
+private:
+  void RasterizeTriangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2);
+  glm::vec3 ToScreen(const glm::vec4& clip) const;
+
+  int width_ = 0;
+  int height_ = 0;
+  glm::mat4 viewProj_ = glm::mat4(1.f);
+
+  // level 0 is the depth buffer, depth is stored in [0,1] (1 = far)
+  std::vector<std::vector<float>> hiZ_;
+  std::vector<glm::ivec2> levelSize_;
+};
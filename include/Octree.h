@@ -23,6 +23,8 @@ public:
     BoundingVolume* bv_ = nullptr;
     TreeNode* children_[MAX_CHILDREN]{ nullptr };
     std::vector<glm::vec3> vertices_; // for power plant will be vertices
+    bool visible_ = true; // result of last occlusion test
+    bool occluder_ = false; // holds occluder geometry, so it is never tested against the depth buffer
   };
 
 public:
@@ -0,0 +1,29 @@
+#pragma once
+#include "LibHeader.h"
+#include "Quaternion.h"
+
+#include <vector>
+
+struct FlatSkeleton;
+class VQS;
+
+// local space pose of every skeleton node, one array per channel so clips can be
+// sampled and blended before a single hierarchy pass
+struct PoseBuffer
+{
+  std::vector<glm::vec3> translation;
+  std::vector<Quaternion> rotation;
+  std::vector<glm::vec3> scale;
+  std::vector<unsigned char> animated; // 0 keeps the exact bind transform of the node
+
+  size_t Size() const;
+  // bind pose decomposed into channels, every node marked as not animated
+  void SetBind(const FlatSkeleton& skeleton);
+  void Set(size_t node, const VQS& pose);
+  // move toward other by t, rotations take the shorter arc and are renormalized
+  void Blend(const PoseBuffer& other, float t);
+  // local transform of a node, the bind matrix itself when it is not animated
+  glm::mat4 LocalTransform(const FlatSkeleton& skeleton, size_t node) const;
+  // LocalTransform of every node, animated ones built four at a time
+  void LocalTransforms(const FlatSkeleton& skeleton, std::vector<glm::mat4>& out) const;
+};
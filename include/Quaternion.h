@@ -6,11 +6,26 @@
 
 class Quaternion;
 
+// how rotation keys are interpolated, both fast modes skip acos and sin
+enum class RotationInterpolation
+{
+  Slerp, // exact
+  CorrectedNlerp, // nlerp with t bent toward constant speed, within 1e-4 rad up to 90 degree key gaps
+  Nlerp, // exact at the keys, up to 0.016 rad off between 90 degree keys
+};
+
 // interpolation
 namespace Interpolation
 {
   Quaternion lerp(Quaternion q1, Quaternion q2, float t);
   Quaternion Slerp(Quaternion q1, Quaternion q2, float t);
+  // shorter arc, normalized
+  Quaternion Nlerp(Quaternion q1, Quaternion q2, float t);
+  Quaternion CorrectedNlerp(Quaternion q1, Quaternion q2, float t);
+  // polynomial in t and |cos theta| (kavan et al., refit by a. kapoulkine) that
+  // makes nlerp follow slerp's constant angular speed
+  float CorrectedNlerpFactor(float cosTheta, float t);
+  Quaternion Interpolate(Quaternion q1, Quaternion q2, float t, RotationInterpolation mode);
   glm::vec3 lerp(glm::vec3 v1, glm::vec3 v2, float t);
   glm::vec3 Elerp(glm::vec3 s1, glm::vec3 s2, float t);
 }
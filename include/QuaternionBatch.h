@@ -0,0 +1,33 @@
+#pragma once
+#include "Quaternion.h"
+#include <cstddef>
+
+// sse kernels over arrays, four quaternions per step with a padded tail. the arrays
+// stay in the usual Quaternion layout and are transposed to one register per component
+// while they are processed; out may alias an input
+namespace QuaternionBatch
+{
+  // out[i] = a[i] * b[i]
+  void Multiply(const Quaternion* a, const Quaternion* b, Quaternion* out, size_t count);
+  // normalized lerp on the shorter arc
+  void Nlerp(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count);
+  void Nlerp(const Quaternion* a, const Quaternion* b, float t, Quaternion* out, size_t count);
+  // slerp on the shorter arc without trig (eberly's polynomial fit), normalized
+  void Slerp(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count);
+  // Interpolation::CorrectedNlerp
+  void CorrectedNlerp(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count);
+  // by mode, the polynomial slerp stands in for the exact one, they agree to float precision
+  void Interpolate(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count,
+    RotationInterpolation mode);
+
+  // translation * rotation * scale, the matrices VQS::toMat4 builds
+  void ToMat4(const glm::vec3* translation, const Quaternion* rotation, const glm::vec3* scale,
+    glm::mat4* out, size_t count);
+  // VQS::operator* on split channels, b is applied first
+  void Compose(const glm::vec3* translationA, const Quaternion* rotationA, const glm::vec3* scaleA,
+    const glm::vec3* translationB, const Quaternion* rotationB, const glm::vec3* scaleB,
+    glm::vec3* translation, Quaternion* rotation, glm::vec3* scale, size_t count);
+  // VQS::inverse on split channels, rotations are unit so the inverse is the conjugate
+  void Inverse(const glm::vec3* translationIn, const Quaternion* rotationIn, const glm::vec3* scaleIn,
+    glm::vec3* translation, Quaternion* rotation, glm::vec3* scale, size_t count);
+}
@@ -3,6 +3,8 @@
 #include "ManagerBase.h"
 #include "GBuffer.h"
 #include "FBO.h"
+#include "DualQuaternion.h"
+#include <vector>
 
 class ShaderProgram;
 
@@ -31,6 +33,10 @@ public:
   void BeginFrame();
   void EndFrame();
 
+  // write the final bone matrices once per frame into the palette shared by the MRT and shadow programs
+  void UploadBonePalette();
+  // skin the animated model once per frame into each mesh's skinned buffer
+  void SkinningPass();
   void MRT_Pass();
   void ShadowPass();
   void LightingPass();
@@ -51,6 +57,7 @@ public:
   ShaderProgram* Spline_Program = nullptr;
   ShaderProgram* IK_Program = nullptr;
   ShaderProgram* Spring_Program = nullptr;
+  ShaderProgram* Skin_Program = nullptr; // transform feedback only, no fragment stage
 
   int width;
   int height;
@@ -73,9 +80,34 @@ public:
   bool simplexDraw = false; // gjk
   int debugDrawType = to_integral(DebugDrawType::Invalid);
   bool depthCopy = true;
+  bool preSkinning = true; // otherwise MRT and shadow passes each skin in their vertex shader
+  bool cpuSkinning = false; // sse skinning and upload instead of transform feedback
+  bool dualQuaternionSkinning = false; // 2 x vec4 per bone instead of a mat4, no candy wrapper twist
 
   GLuint emptyVAOid_;
 
+  static constexpr GLuint BONE_PALETTE_BINDING = 0; // std430 finalBonesMatrices[] in MRT.vert and shadow.vert
+  static constexpr GLuint INSTANCE_BINDING = 1; // std430 instanceTr[], crowd model transforms
+  static constexpr GLuint BAKED_BINDING = 2; // std430 bakedMatrices[], palettes of the baked crowd clip
+  static constexpr GLuint INSTANCE_PLAYBACK_BINDING = 3; // std430 instancePlayback[], phase and speed per crowd instance
+  static constexpr GLuint DUAL_QUATERNION_BINDING = 4; // std430 boneDualQuaternions[], replaces binding 0 in dual quaternion mode
+  GLuint bonePaletteSSBO_ = 0;
+  size_t bonePaletteCapacity_ = 0; // in matrices, the buffer only grows
+  GLuint instanceSSBO_ = 0;
+  size_t instanceCapacity_ = 0;
+  GLuint bakedSSBO_ = 0;
+  size_t bakedCapacity_ = 0;
+  int bakedVersion_ = 0;
+  GLuint instancePlaybackSSBO_ = 0;
+  size_t instancePlaybackCapacity_ = 0;
+  GLuint dualQuaternionSSBO_ = 0;
+  size_t dualQuaternionCapacity_ = 0;
+  // primary animator's palette followed by one palette per crowd instance
+  std::vector<glm::mat4> bonePalette_;
+  std::vector<glm::mat4> instanceTransforms_;
+  std::vector<glm::vec4> instancePlayback_;
+  std::vector<DualQuaternion> dualQuaternionPalette_; // same layout as bonePalette_
+
   struct Sun
   {
     glm::mat4 SunView;
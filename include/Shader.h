@@ -1,5 +1,6 @@
 #pragma once
 #include "LibHeader.h"
+#include <string>
 
 class ShaderProgram
 {
@@ -15,4 +16,6 @@ public:
   int programID;
 
   char* ReadFile(const char* name);
+  // file contents with every #include "file" line replaced by that file, relative to the including shader
+  std::string ReadSource(const std::string& name, int depth = 0);
 };
\ No newline at end of file
@@ -7,6 +7,8 @@ constexpr float EPSILON = 0.00000001f;
 
 class Shape;
 class Ray;
+class ConvexHull;
+class MeshBVH;
 struct Slab;
 
 class Intersection
@@ -125,13 +127,18 @@ class Shape
 public:
   // Constructor and destructor
   Shape() = default;
-  virtual ~Shape() = default;
+  virtual ~Shape();
 
   // spatial data structure, bounding volume hierarchy
   virtual bool intersect(const Ray& ray, Intersection& intersection) = 0;
   virtual BoundingVolume* bbox() = 0;
   
 
+  // convex hull of Pnt, built on first use
+  ConvexHull* GetHull();
+  // triangle bvh of Pnt / Tri in object space, built on first use
+  MeshBVH* GetBVH();
+
   virtual void ComputeSize();
   virtual void MakeVAO();
   virtual void DrawVAO();
@@ -168,4 +175,6 @@ public:
 
   Object* parent = nullptr;
 private:
+  ConvexHull* hull_ = nullptr;
+  MeshBVH* bvh_ = nullptr;
 };
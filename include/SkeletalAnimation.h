@@ -2,9 +2,10 @@
 #include "LibHeader.h"
 #include "Model.h"
 #include "Bone.h"
+#include "CompressedClip.h"
 
+#include <cstdint>
 #include <vector>
-#include <map>
 
 struct NodeData
 {
@@ -14,10 +15,32 @@ struct NodeData
   std::vector<NodeData> children;
 };
 
+// node hierarchy compiled into flat arrays, parents always come before their children
+// so a pose is evaluated in one forward loop
+struct FlatSkeleton
+{
+  std::vector<int> parent; // -1 for the root
+  std::vector<glm::mat4> transformation; // bind pose local transform
+  std::vector<int> bone; // index into the animation bones, -1 when the node has no channel
+  std::vector<int> boneID; // slot in the final bone matrices, -1 when the node is not skinned
+  std::vector<glm::mat4> offset; // mesh to bone space, identity when not skinned
+  std::vector<std::string> name;
+  // longest bind pose chain below each node in its own space, small values are fingers and toes
+  std::vector<float> reach;
+  float maxReach = 0.f;
+};
+
 class SkeletalAnimation
 {
   void ReadMissingBones(const aiAnimation* animation, Model& model);
   void ReadHeirarchyData(NodeData& dest, const aiNode* src);
+  void BuildFlatSkeleton(const NodeData& node, int parent);
+  void BuildBoneTracks();
+
+  // baked bones and hierarchy, keyed by the fnv-1a hash of the source file
+  bool SaveCache(const std::string& path, uint64_t key) const;
+  bool LoadCache(const std::string& path, uint64_t key, Model& model);
+  static uint64_t HashFile(const std::string& path);
 
 public:
   SkeletalAnimation() = default;
@@ -25,12 +48,16 @@ public:
 
   SkeletalAnimation(const std::string& animationPath, Model* model);
 
+  // by name for loading, by bone id once interned
   Bone* FindBone(const std::string& name);
+  Bone* FindBone(int boneID);
 
   float GetTicksPerSecond();
   float GetDuration();
   const NodeData& GetRootNode();
-  std::map<std::string, BoneInfo>& GetBoneIDMap();
+  const FlatSkeleton& GetSkeleton() const;
+  const CompressedClip& GetCompressedClip() const;
+  const BoneTable& GetBoneTable() const;
   std::vector<Bone>& GetBonesData();
 
   // bones' world location (motion along a space curve)
@@ -48,19 +75,20 @@ public:
 
   std::vector<glm::vec3> boneLocalPosition;
   std::vector<glm::vec3> bonePosition;
-  std::vector<std::string> boneName;
+  std::vector<int> boneIDs; // bone id of each drawn bone
   std::vector<unsigned int> boneIndices;
 
-  void SetUpHierarchicalRender(const NodeData& root,
-    std::map<std::string, BoneInfo>& boneIDMap,
-    int index);
+  void SetUpHierarchicalRender(const NodeData& root, int index);
 
 private:
   float m_Duration;
   int m_TicksPerSecond;
   std::vector<Bone> m_Bones;
   NodeData m_RootNode;
-  std::map<std::string, BoneInfo> m_BoneInfoMap;
+  FlatSkeleton m_Skeleton;
+  CompressedClip m_CompressedClip; // built from m_Bones once the skeleton is known
+  const BoneTable* m_BoneTable = nullptr; // owned by the model, shared by all of its clips
+  std::vector<int> m_BoneTracks; // bone id to index in m_Bones, -1 when not animated or interned later
 
   // motion along a space curve
   glm::vec3 boneWorldLocation = { 0.f,0.f,0.f };
@@ -0,0 +1,16 @@
+#pragma once
+#include "LibHeader.h"
+#include <cstddef>
+
+class DualQuaternion;
+
+namespace Skinning
+{
+  // linear blend skinning on the cpu with sse, same rules as MRT.vert: -1 ids are skipped and an id
+  // outside the palette keeps the bind pose. out receives position and normal interleaved per vertex
+  void SkinVertices(const glm::vec3* positions, const glm::vec3* normals, const glm::ivec4* boneIDs,
+    const glm::vec4* weights, size_t count, const glm::mat4* palette, size_t paletteSize, glm::vec3* out);
+  // dual quaternion skinning with the same id rules and output layout, matches the shaders' dual quaternion path
+  void SkinVerticesDualQuaternion(const glm::vec3* positions, const glm::vec3* normals, const glm::ivec4* boneIDs,
+    const glm::vec4* weights, size_t count, const DualQuaternion* palette, size_t paletteSize, glm::vec3* out);
+}
@@ -22,6 +22,8 @@ public:
   void AddCurve(Spline& curve);
   int GetSize();
   void MoveAlongSpaceCurve(Object* player, Spline& currCurve, float t);
+  // world space positions and headings of the player the given seconds ahead on the curve
+  void PredictTrajectory(const float* seconds, int count, glm::vec3* positions, glm::vec3* directions);
   std::vector<Spline>& getSpaceCurves();
 
   // speed control distance-time function (parabolic ease in/out approach)
@@ -29,6 +31,9 @@ public:
   float t2;
   float Vc; // easy for normalizing (s3(1) == 1)
 private:
+  static constexpr float LAP_SECONDS = 10.f; // t runs from 0 to 1 in this time
+  static constexpr float CURVE_SCALE = 500.f; // curve space to world space
+
   float t = 0.f;
   float s = 0.f;
   std::vector<Spline> spaceCurves;
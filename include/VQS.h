@@ -19,8 +19,14 @@ public:
   VQS inverse();
   VQS identity();
 
+  glm::vec3 getTranslation() const;
+  Quaternion getRotation() const;
+  glm::vec3 getScale() const;
+  // translation * rotation * scale, built without multiplying three matrices
+  glm::mat4 toMat4();
+
 private:
-  glm::vec3 v;
+  glm::vec3 v = glm::vec3(0.f);
   Quaternion q;
-  glm::vec3 s;
+  glm::vec3 s = glm::vec3(1.f);
 };
\ No newline at end of file
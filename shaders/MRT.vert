@@ -23,37 +23,119 @@ layout (location = 3) out vec3 tanVec;
 layout (location = 4) out vec3 biTanVec;
 
 // animation data
-const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+layout (std430, binding = 0) readonly buffer BonePalette
+{
+  mat4 finalBonesMatrices[];
+};
+uniform bool preSkinned; // vertex and normal already went through the skinning pass
+
+// crowd draw, the palette and model transform are picked per instance
+layout (std430, binding = 1) readonly buffer InstanceTransforms
+{
+  mat4 instanceTr[];
+};
+uniform bool instanced;
+uniform int paletteStride; // bones per palette, instance i uses palette i + 1
+
+// baked crowd playback, the clip's palettes at a fixed rate, frame f starts at f * paletteStride
+layout (std430, binding = 2) readonly buffer BakedPalettes
+{
+  mat4 bakedMatrices[];
+};
+layout (std430, binding = 3) readonly buffer InstancePlayback
+{
+  vec4 instancePlayback[]; // x phase offset in loops, y playback speed
+};
+uniform bool baked;
+uniform float bakedTime; // seconds
+uniform float bakedRate; // frames per second
+uniform int bakedFrames; // frames per loop, one more palette is stored to close it
+
+int paletteBase;
+bool useBaked;
+int bakedBase;
+float bakedBlend;
+
+// skinning matrix of a bone for this vertex, baked palettes blend the two nearest frames
+mat4 BoneMatrix(int id)
+{
+  if (useBaked)
+  {
+    return bakedMatrices[bakedBase + id] * (1.0 - bakedBlend) + bakedMatrices[bakedBase + paletteStride + id] * bakedBlend;
+  }
+  return finalBonesMatrices[paletteBase + id];
+}
+
+bool ValidBone(int id)
+{
+  if (useBaked)
+  {
+    return bakedBase + paletteStride + id < bakedMatrices.length();
+  }
+  return paletteBase + id < finalBonesMatrices.length();
+}
+
+#include "dualQuaternion.glsl"
 
 void main()
 {
+  paletteBase = instanced ? (gl_InstanceID + 1) * paletteStride : 0;
+  useBaked = instanced && baked;
+  bakedBase = 0;
+  bakedBlend = 0.0;
+  if (useBaked)
+  {
+    vec4 playback = instancePlayback[gl_InstanceID];
+    float frame = mod(bakedTime * playback.y * bakedRate + playback.x * float(bakedFrames), float(bakedFrames));
+    int f0 = min(int(frame), bakedFrames - 1);
+    bakedBase = f0 * paletteStride;
+    bakedBlend = frame - float(f0);
+  }
+  mat4 model = instanced ? instanceTr[gl_InstanceID] : ModelTr;
+
   vec4 totalPosition = vec4(0.0);
   vec3 localNormal;
-  for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+  if (preSkinned)
   {
-    if (boneIds[i] == -1)
-    {
-      continue;
-    }
-    if (boneIds[i] >= MAX_BONES)
+    totalPosition = vec4(vertex,1.0);
+    localNormal = vertexNormal;
+  }
+  else if (dualQuaternion && !useBaked)
+  {
+    mat2x4 dq;
+    bool skinned = BlendDualQuaternion(paletteBase, dq);
+    totalPosition = vec4(skinned ? DualQuaternionPoint(dq, vertex) : vertex, 1.0);
+    localNormal = skinned ? DualQuaternionVector(dq, vertexNormal) : vertexNormal;
+  }
+  else
+  {
+    for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
     {
-      totalPosition = vec4(vertex,1.0);
-      localNormal = vertexNormal;
-      break;
+      if (boneIds[i] == -1)
+      {
+        continue;
+      }
+      if (!ValidBone(boneIds[i]))
+      {
+        totalPosition = vec4(vertex,1.0);
+        localNormal = vertexNormal;
+        break;
+      }
+      mat4 bone = BoneMatrix(boneIds[i]);
+      vec4 localPosition = bone * vec4(vertex,1.0);
+      totalPosition += localPosition * weights[i];
+      localNormal = mat3(bone) * vertexNormal;
     }
-    vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(vertex,1.0);
-    totalPosition += localPosition * weights[i];
-    localNormal = mat3(finalBonesMatrices[boneIds[i]]) * vertexNormal;
   }
 
-  gl_Position = WorldProj*WorldView*ModelTr*totalPosition;
+  gl_Position = WorldProj*WorldView*model*totalPosition;
 
   // save fragment position in view space
-  FragPos = (WorldView*ModelTr*totalPosition).xyz;
+  FragPos = (WorldView*model*totalPosition).xyz;
   texVec = vertexTexture;
-  tanVec = mat3(ModelTr)*vertexTangent;
-  biTanVec = mat3(ModelTr)*vertexBiTangent;
-  normalVec = mat3(NormalTr)*localNormal;
+  tanVec = mat3(model)*vertexTangent;
+  biTanVec = mat3(model)*vertexBiTangent;
+  // crowd transforms have uniform scale
+  normalVec = (instanced ? mat3(model) : mat3(NormalTr))*localNormal;
 }
\ No newline at end of file
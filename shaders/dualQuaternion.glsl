@@ -0,0 +1,50 @@
+// dual quaternion skinning, included after boneIds, weights and MAX_BONE_INFLUENCE are declared
+
+// dual quaternion palette in the layout of finalBonesMatrices, columns are the real and dual parts (x, y, z, w)
+layout (std430, binding = 4) readonly buffer DualQuaternionPalette
+{
+  mat2x4 boneDualQuaternions[];
+};
+uniform bool dualQuaternion;
+
+// weighted sum on the first influence's hemisphere, normalized; false when an id is outside the palette
+bool BlendDualQuaternion(int base, out mat2x4 blended)
+{
+  blended = mat2x4(0.0);
+  vec4 pivot = vec4(0.0);
+  for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+  {
+    if (boneIds[i] == -1)
+    {
+      continue;
+    }
+    if (base + boneIds[i] >= boneDualQuaternions.length())
+    {
+      return false;
+    }
+    mat2x4 dq = boneDualQuaternions[base + boneIds[i]];
+    if (pivot == vec4(0.0))
+    {
+      pivot = dq[0];
+    }
+    blended += dq * (dot(pivot, dq[0]) < 0.0 ? -weights[i] : weights[i]);
+  }
+  float len = length(blended[0]);
+  if (len == 0.0)
+  {
+    return false;
+  }
+  blended /= len;
+  return true;
+}
+
+vec3 DualQuaternionVector(mat2x4 dq, vec3 v)
+{
+  return v + 2.0 * cross(dq[0].xyz, cross(dq[0].xyz, v) + dq[0].w * v);
+}
+
+vec3 DualQuaternionPoint(mat2x4 dq, vec3 p)
+{
+  vec3 translation = 2.0 * (dq[0].w * dq[1].xyz - dq[1].w * dq[0].xyz + cross(dq[0].xyz, dq[1].xyz));
+  return DualQuaternionVector(dq, p) + translation;
+}
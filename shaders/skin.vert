@@ -0,0 +1,53 @@
+#version 460
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 vertexNormal;
+
+// animation data
+layout (location = 5) in ivec4 boneIds;
+layout (location = 6) in vec4 weights;
+
+const int MAX_BONE_INFLUENCE = 4;
+layout (std430, binding = 0) readonly buffer BonePalette
+{
+  mat4 finalBonesMatrices[];
+};
+
+#include "dualQuaternion.glsl"
+
+// captured by transform feedback, position and normal interleaved
+layout (xfb_buffer = 0, xfb_stride = 24) out;
+layout (xfb_offset = 0) out vec3 skinnedPosition;
+layout (xfb_offset = 12) out vec3 skinnedNormal;
+
+void main()
+{
+  vec4 totalPosition = vec4(0.0);
+  vec3 totalNormal = vec3(0.0);
+  if (dualQuaternion)
+  {
+    mat2x4 dq;
+    bool skinned = BlendDualQuaternion(0, dq);
+    skinnedPosition = skinned ? DualQuaternionPoint(dq, vertex) : vertex;
+    skinnedNormal = skinned ? DualQuaternionVector(dq, vertexNormal) : vertexNormal;
+    return;
+  }
+  for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+  {
+    if (boneIds[i] == -1)
+    {
+      continue;
+    }
+    if (boneIds[i] >= finalBonesMatrices.length())
+    {
+      totalPosition = vec4(vertex,1.0);
+      totalNormal = vertexNormal;
+      break;
+    }
+    totalPosition += finalBonesMatrices[boneIds[i]] * vec4(vertex,1.0) * weights[i];
+    totalNormal += mat3(finalBonesMatrices[boneIds[i]]) * vertexNormal * weights[i];
+  }
+
+  skinnedPosition = totalPosition.xyz;
+  skinnedNormal = totalNormal;
+}
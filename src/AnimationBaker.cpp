@@ -0,0 +1,88 @@
+#include "AnimationBaker.h"
+#include "Animator.h"
+#include "SkeletalAnimation.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool BakedAnimation::Empty() const
+{
+  return frameCount == 0;
+}
+
+void BakedAnimation::Sample(float seconds, std::vector<glm::mat4>& palette) const
+{
+  palette.resize(boneCount);
+  if (Empty())
+    return;
+
+  float frame = std::fmod(seconds * sampleRate, static_cast<float>(frameCount));
+  if (frame < 0.f)
+    frame += frameCount;
+  int f0 = std::min(static_cast<int>(frame), frameCount - 1);
+  float t = frame - f0;
+
+  const glm::mat4* a = &matrices[static_cast<size_t>(f0) * boneCount];
+  const glm::mat4* b = a + boneCount;
+  for (int i = 0; i < boneCount; ++i)
+    palette[i] = a[i] * (1.f - t) + b[i] * t;
+}
+
+BakedAnimation AnimationBaker::Bake(SkeletalAnimation& animation, float sampleRate)
+{
+  BakedAnimation baked;
+  float ticksPerSecond = animation.GetTicksPerSecond() > 0.f ? animation.GetTicksPerSecond() : 25.f;
+  float duration = animation.GetDuration() / ticksPerSecond;
+  if (duration <= 0.f || sampleRate <= 0.f)
+    return baked;
+
+  Animator animator(&animation);
+  int boneCount = static_cast<int>(animator.GetFinalBoneMatrices().size());
+  // whole frames per loop, the rate is adjusted so the loop closes exactly
+  int frameCount = std::max(1, static_cast<int>(std::round(duration * sampleRate)));
+
+  baked.frameCount = frameCount;
+  baked.boneCount = boneCount;
+  baked.sampleRate = frameCount / duration;
+  baked.duration = duration;
+  baked.matrices.resize(static_cast<size_t>(frameCount + 1) * boneCount);
+
+  for (int f = 0; f <= frameCount; ++f)
+  {
+    // the animator wraps at the duration, the closing frame is taken just before it
+    float ticks = animation.GetDuration() * f / frameCount;
+    animator.Seek(f < frameCount ? ticks : std::nextafter(animation.GetDuration(), 0.f));
+    animator.CalculateBoneTransforms();
+    auto& palette = animator.GetFinalBoneMatrices();
+    std::copy(palette.begin(), palette.end(), baked.matrices.begin() + static_cast<size_t>(f) * boneCount);
+  }
+  return baked;
+}
+
+float AnimationBaker::Validate(const BakedAnimation& baked, SkeletalAnimation& animation)
+{
+  if (baked.Empty())
+    return 0.f;
+
+  Animator animator(&animation);
+  std::vector<glm::mat4> palette;
+  float error = 0.f;
+  for (int f = 0; f < baked.frameCount; ++f)
+  {
+    float seconds = (f + 0.5f) / baked.sampleRate;
+    animator.Seek(seconds / baked.duration * animation.GetDuration());
+    animator.CalculateBoneTransforms();
+    baked.Sample(seconds, palette);
+
+    auto& reference = animator.GetFinalBoneMatrices();
+    for (int i = 0; i < baked.boneCount; ++i)
+    {
+      for (int c = 0; c < 4; ++c)
+      {
+        glm::vec4 d = glm::abs(reference[i][c] - palette[i][c]);
+        error = std::max(error, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+      }
+    }
+  }
+  return error;
+}
@@ -1,9 +1,16 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <execution>
 #include <iostream>
+#include <random>
 
 #include "Engine.h"
 #include "AnimationManager.h"
 
 #include "Transform.h"
+#include "Bone.h"
+#include "QuaternionBatch.h"
 
 void AnimationManager::Setup()
 {
@@ -17,8 +24,443 @@ void AnimationManager::Update()
     if (animation && animator)
     {
       float dt = Engine::managers_.GetManager<FrameRateManager*>()->delta_time;
+      if (useMotionMatching && motionMatching)
+      {
+        // the matched clips carry the speed, the path only supplies the trajectory
+        animator->speed = 1.f;
+        motionMatching->Update(*animator, DesiredTrajectory(), dt);
+      }
+      else if (blendBySpeed && walkLayer >= 0 && runLayer >= 0)
+        animator->Blend1D(walkLayer, runLayer, (animator->speed - walkSpeed) / std::max(runSpeed - walkSpeed, 0.001f));
       animator->UpdateAnimation(dt);
       animator->UpdateVBO();
+
+      // baked crowds are posed in the vertex shader from the shared clock
+      if (bakedPlayback && !baked.Empty())
+      {
+        bakedTime += dt;
+      }
+      else
+      {
+        SelectLOD();
+
+        // instances only read the clip, poses are independent
+        bool compressed = animator->useCompressedClip;
+        std::for_each(std::execution::par, crowd.begin(), crowd.end(), [dt, compressed](CrowdInstance& instance)
+          {
+            instance.animator->useCompressedClip = compressed;
+            instance.animator->UpdateAnimation(dt);
+          });
+      }
+    }
+  }
+}
+
+void AnimationManager::SelectLOD()
+{
+  lodCounts[0] = lodCounts[1] = lodCounts[2] = 0;
+  if (crowd.empty())
+    return;
+
+  CameraManager* cm = Engine::managers_.GetManager<CameraManager*>();
+  // frustum planes from the rows of proj * view, inside when dot(plane, p) + w >= 0
+  glm::mat4 viewProj = glm::transpose(cm->WorldProj * cm->WorldView);
+  glm::vec4 planes[6];
+  for (int i = 0; i < 3; ++i)
+  {
+    planes[2 * i] = viewProj[3] + viewProj[i];
+    planes[2 * i + 1] = viewProj[3] - viewProj[i];
+  }
+  for (auto& plane : planes)
+    plane /= glm::length(glm::vec3(plane));
+  // the view also carries the pan offset, so take the camera position from it rather than eye
+  glm::vec3 eye = glm::vec3(glm::inverse(cm->WorldView)[3]);
+
+  for (auto& instance : crowd)
+  {
+    Animator::LOD& state = instance.animator->lod;
+    state = Animator::LOD();
+    if (!lod.enabled)
+    {
+      ++lodCounts[0];
+      continue;
+    }
+
+    glm::vec3 center = glm::vec3(instance.modelTr * glm::vec4(boundsCenter, 1.f));
+    float scale = std::max(glm::length(glm::vec3(instance.modelTr[0])),
+      std::max(glm::length(glm::vec3(instance.modelTr[1])), glm::length(glm::vec3(instance.modelTr[2]))));
+    float radius = boundsRadius * scale;
+
+    if (lod.freezeOffscreen)
+    {
+      for (auto& plane : planes)
+      {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+          state.visible = false;
+      }
+      if (!state.visible)
+      {
+        ++lodCounts[2];
+        continue;
+      }
+    }
+
+    float distance = glm::length(center - eye);
+    float range = std::max(lod.farDistance - lod.nearDistance, 1.f);
+    float t = glm::clamp((distance - lod.nearDistance) / range, 0.f, 1.f);
+    state.interval = 1 + static_cast<int>(std::round(t * (std::max(lod.farInterval, 1) - 1)));
+    state.cullFraction = t >= 0.5f ? lod.cullFraction : 0.f;
+    ++lodCounts[state.interval > 1 ? 1 : 0];
+  }
+}
+
+void AnimationManager::SpawnCrowd(int count, float spacing)
+{
+  ClearCrowd();
+  if (!animation || !model || !model->parent)
+    return;
+
+  // bind pose bounds, inflated since limbs swing outside of them
+  glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+  for (auto& mesh : model->meshes)
+  {
+    for (auto& p : mesh.Position)
+    {
+      lo = glm::min(lo, p);
+      hi = glm::max(hi, p);
+    }
+  }
+  boundsCenter = lo.x <= hi.x ? (lo + hi) * 0.5f : glm::vec3(0.f);
+  boundsRadius = lo.x <= hi.x ? glm::length(hi - lo) * 0.5f * 1.5f : 0.f;
+
+  // square grid centered on the animated object, the object itself keeps the middle cell
+  int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count + 1))));
+  const glm::mat4& origin = model->parent->modelTr;
+  crowd.reserve(count);
+  for (int cell = 0; static_cast<int>(crowd.size()) < count; ++cell)
+  {
+    int x = cell % side - side / 2;
+    int z = cell / side - side / 2;
+    if (x == 0 && z == 0)
+      continue;
+
+    CrowdInstance instance;
+    instance.animator = std::make_unique<Animator>(animation.get());
+    // spread phase and speed so the crowd does not move in lockstep
+    float r = static_cast<float>((cell * 7919) % 1000) / 1000.f;
+    instance.animator->speed = 0.8f + 0.4f * r;
+    instance.animator->rotationInterpolation = animator->rotationInterpolation;
+    instance.animator->Seek(r * animation->GetDuration());
+    instance.playbackSpeed = instance.animator->speed;
+    instance.phaseOffset = r;
+    instance.animator->CalculateBoneTransforms();
+    instance.modelTr = Translate(x * spacing, 0.f, z * spacing) * origin;
+    crowd.push_back(std::move(instance));
+  }
+}
+
+void AnimationManager::ClearCrowd()
+{
+  crowd.clear();
+}
+
+void AnimationManager::BakeCrowdClip()
+{
+  if (!animation)
+    return;
+  baked = AnimationBaker::Bake(*animation, bakeRate);
+  bakeError = AnimationBaker::Validate(baked, *animation);
+  bakedTime = 0.f;
+  ++bakeVersion;
+}
+
+void AnimationManager::BenchmarkRotationInterpolation()
+{
+  interpolationBenchmark = InterpolationBenchmark();
+  if (!animation)
+    return;
+
+  // a few points inside every key interval, repeated until the timings are stable
+  const int steps = 8;
+  const size_t minSamples = 1 << 20;
+  std::vector<Quaternion> from, to;
+  std::vector<float> factor;
+  // translation and scale keys of the same intervals for the VQS kernels
+  std::vector<glm::vec3> translationFrom, translationTo, scaleFrom, scaleTo;
+  auto key = [](const std::vector<glm::vec3>& keys, size_t k, const glm::vec3& fallback)
+  {
+    return keys.empty() ? fallback : keys[std::min(k, keys.size() - 1)];
+  };
+  for (const Bone& bone : animation->GetBonesData())
+  {
+    const std::vector<Quaternion>& keys = bone.getRotations();
+    for (size_t k = 0; k + 1 < keys.size(); ++k)
+    {
+      for (int s = 1; s <= steps; ++s)
+      {
+        from.push_back(keys[k]);
+        to.push_back(keys[k + 1]);
+        factor.push_back(static_cast<float>(s) / (steps + 1));
+        translationFrom.push_back(key(bone.getPositions(), k, glm::vec3(0.f)));
+        translationTo.push_back(key(bone.getPositions(), k + 1, glm::vec3(0.f)));
+        scaleFrom.push_back(key(bone.getScales(), k, glm::vec3(1.f)));
+        scaleTo.push_back(key(bone.getScales(), k + 1, glm::vec3(1.f)));
+      }
+    }
+  }
+  if (from.empty())
+    return;
+  size_t keyed = from.size();
+  while (from.size() < minSamples)
+  {
+    from.insert(from.end(), from.begin(), from.begin() + keyed);
+    to.insert(to.end(), to.begin(), to.begin() + keyed);
+    factor.insert(factor.end(), factor.begin(), factor.begin() + keyed);
+    translationFrom.insert(translationFrom.end(), translationFrom.begin(), translationFrom.begin() + keyed);
+    translationTo.insert(translationTo.end(), translationTo.begin(), translationTo.begin() + keyed);
+    scaleFrom.insert(scaleFrom.end(), scaleFrom.begin(), scaleFrom.begin() + keyed);
+    scaleTo.insert(scaleTo.end(), scaleTo.begin(), scaleTo.begin() + keyed);
+  }
+  interpolationBenchmark.samples = static_cast<int>(from.size());
+
+  using Clock = std::chrono::steady_clock;
+  auto elapsed = [](Clock::time_point start)
+  {
+    return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+  };
+
+  std::vector<Quaternion> exact(from.size());
+  std::vector<Quaternion> result(from.size());
+  for (size_t i = 0; i < from.size(); ++i)
+    exact[i] = Interpolation::Slerp(from[i], to[i], factor[i]).normalize();
+
+  for (int m = 0; m < 3; ++m)
+  {
+    RotationInterpolation mode = static_cast<RotationInterpolation>(m);
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < from.size(); ++i)
+      result[i] = Interpolation::Interpolate(from[i], to[i], factor[i], mode);
+    interpolationBenchmark.scalarMilliseconds[m] = elapsed(start);
+
+    start = Clock::now();
+    QuaternionBatch::Interpolate(from.data(), to.data(), factor.data(), result.data(), result.size(), mode);
+    interpolationBenchmark.batchMilliseconds[m] = elapsed(start);
+
+    // rotation angle of exact^-1 * result, asin keeps precision near zero
+    float maxError = 0.f;
+    for (size_t i = 0; i < keyed; ++i)
+    {
+      Quaternion difference = exact[i].conjugate() * result[i];
+      float s = std::min(glm::length(difference._v), 1.f);
+      maxError = std::max(maxError, 2.f * glm::asin(s));
+    }
+    interpolationBenchmark.maxError[m] = maxError;
+  }
+
+  // quaternion product, error is the rotation angle between the scalar and batch results
+  size_t count = from.size();
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < count; ++i)
+    exact[i] = from[i] * to[i];
+  interpolationBenchmark.operationScalarMilliseconds[0] = elapsed(start);
+
+  start = Clock::now();
+  QuaternionBatch::Multiply(from.data(), to.data(), result.data(), count);
+  interpolationBenchmark.operationBatchMilliseconds[0] = elapsed(start);
+
+  for (size_t i = 0; i < keyed; ++i)
+  {
+    Quaternion difference = exact[i].conjugate() * result[i];
+    float s = std::min(glm::length(difference._v), 1.f);
+    interpolationBenchmark.operationMaxError[0] = std::max(interpolationBenchmark.operationMaxError[0], 2.f * glm::asin(s));
+  }
+
+  // VQS compose and inverse, compared through the matrices they produce
+  std::vector<VQS> scalar(count);
+  std::vector<glm::vec3> translation(count), scale(count);
+  auto maxDifference = [&]()
+  {
+    float maxError = 0.f;
+    for (size_t i = 0; i < keyed; ++i)
+    {
+      glm::mat4 difference = scalar[i].toMat4() - VQS(translation[i], result[i], scale[i]).toMat4();
+      for (int c = 0; c < 4; ++c)
+      {
+        for (int r = 0; r < 4; ++r)
+          maxError = std::max(maxError, std::abs(difference[c][r]));
+      }
+    }
+    return maxError;
+  };
+
+  start = Clock::now();
+  for (size_t i = 0; i < count; ++i)
+    scalar[i] = VQS(translationFrom[i], from[i], scaleFrom[i]) * VQS(translationTo[i], to[i], scaleTo[i]);
+  interpolationBenchmark.operationScalarMilliseconds[1] = elapsed(start);
+
+  start = Clock::now();
+  QuaternionBatch::Compose(translationFrom.data(), from.data(), scaleFrom.data(), translationTo.data(), to.data(),
+    scaleTo.data(), translation.data(), result.data(), scale.data(), count);
+  interpolationBenchmark.operationBatchMilliseconds[1] = elapsed(start);
+  interpolationBenchmark.operationMaxError[1] = maxDifference();
+
+  start = Clock::now();
+  for (size_t i = 0; i < count; ++i)
+    scalar[i] = VQS(translationFrom[i], from[i], scaleFrom[i]).inverse();
+  interpolationBenchmark.operationScalarMilliseconds[2] = elapsed(start);
+
+  start = Clock::now();
+  QuaternionBatch::Inverse(translationFrom.data(), from.data(), scaleFrom.data(), translation.data(), result.data(),
+    scale.data(), count);
+  interpolationBenchmark.operationBatchMilliseconds[2] = elapsed(start);
+  interpolationBenchmark.operationMaxError[2] = maxDifference();
+}
+
+void AnimationManager::BenchmarkPoseSearch()
+{
+  const int frames = std::max(poseSearchBenchmark.frames, 1);
+  const int dimension = MotionMatching::FEATURE_COUNT;
+  const int queries = 500;
+  poseSearchBenchmark = PoseSearchBenchmark();
+  poseSearchBenchmark.frames = frames;
+
+  // motion-like features: a phase, a speed and a turn through smooth curves, plus noise,
+  // so the points lie near a low dimensional set as real locomotion does
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  std::normal_distribution<float> noise(0.f, 1.f);
+  std::vector<float> features;
+  features.reserve(static_cast<size_t>(frames) * dimension);
+  for (int f = 0; f < frames; ++f)
+  {
+    float phase = uniform(generator) * glm::two_pi<float>();
+    float speed = uniform(generator) * 3.f;
+    float turn = uniform(generator);
+    for (int d = 0; d < dimension; ++d)
+      features.push_back(std::sin(phase * (d % 5 + 1) + d) * speed + std::cos(turn * d) * 0.5f + noise(generator) * 0.05f);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  KDTree tree;
+  tree.Build(features, dimension);
+  poseSearchBenchmark.buildMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+  // queries near database frames, as the current pose plus a desired path usually are
+  std::vector<float> query(dimension);
+  double treeTime = 0.0;
+  double bruteForceTime = 0.0;
+  for (int q = 0; q < queries; ++q)
+  {
+    size_t base = static_cast<size_t>(generator() % frames) * dimension;
+    for (int d = 0; d < dimension; ++d)
+      query[d] = features[base + d] + noise(generator) * 0.3f;
+
+    float treeDistance = 0.f;
+    float bruteForceDistance = 0.f;
+    start = Clock::now();
+    tree.Nearest(query.data(), treeDistance);
+    Clock::time_point middle = Clock::now();
+    tree.NearestBruteForce(query.data(), bruteForceDistance);
+    treeTime += std::chrono::duration<double, std::micro>(middle - start).count();
+    bruteForceTime += std::chrono::duration<double, std::micro>(Clock::now() - middle).count();
+    if (treeDistance != bruteForceDistance)
+      ++poseSearchBenchmark.mismatches;
+  }
+  poseSearchBenchmark.queries = queries;
+  poseSearchBenchmark.treeMicroseconds = static_cast<float>(treeTime / queries);
+  poseSearchBenchmark.bruteForceMicroseconds = static_cast<float>(bruteForceTime / queries);
+}
+
+bool AnimationManager::StartMotionMatching()
+{
+  if (!animation || !animator)
+    return false;
+
+  if (!motionMatching)
+  {
+    std::vector<SkeletalAnimation*> clips = { animation.get() };
+    for (auto& clip : blendClips)
+      clips.push_back(clip.get());
+
+    motionMatching = std::make_unique<MotionMatching>();
+    if (!motionMatching->Build(clips))
+    {
+      motionMatching.reset();
+      return false;
+    }
+  }
+  motionMatching->Attach(*animator);
+  useMotionMatching = true;
+  return true;
+}
+
+void AnimationManager::StopMotionMatching()
+{
+  useMotionMatching = false;
+  if (animator)
+    animator->CrossFade(0, crossFadeTime);
+}
+
+MotionMatching::Trajectory AnimationManager::DesiredTrajectory()
+{
+  MotionMatching::Trajectory trajectory;
+  auto& models = Engine::managers_.GetManager<ObjectManager*>()->GetModels();
+  auto* sm = Engine::managers_.GetManager<SplineManager*>();
+  if (models.empty() || sm->GetSize() == 0)
+  {
+    for (int k = 0; k < MotionMatching::TRAJECTORY_SAMPLES; ++k)
+    {
+      trajectory.position[k] = glm::vec2(0.f);
+      trajectory.direction[k] = glm::vec2(0.f, 1.f);
+    }
+    return trajectory;
+  }
+
+  float seconds[MotionMatching::TRAJECTORY_SAMPLES];
+  glm::vec3 positions[MotionMatching::TRAJECTORY_SAMPLES];
+  glm::vec3 directions[MotionMatching::TRAJECTORY_SAMPLES];
+  for (int k = 0; k < MotionMatching::TRAJECTORY_SAMPLES; ++k)
+    seconds[k] = (k + 1) * motionMatching->settings.trajectoryStep;
+  sm->PredictTrajectory(seconds, MotionMatching::TRAJECTORY_SAMPLES, positions, directions);
+
+  // into the space the clips were sampled in, scale included
+  glm::mat4 worldToModel = glm::inverse(models[0]->modelTr);
+  for (int k = 0; k < MotionMatching::TRAJECTORY_SAMPLES; ++k)
+  {
+    glm::vec4 position = worldToModel * glm::vec4(positions[k], 1.f);
+    glm::vec4 direction = worldToModel * glm::vec4(directions[k], 0.f);
+    trajectory.position[k] = glm::vec2(position.x, position.z);
+    trajectory.direction[k] = glm::vec2(direction.x, direction.z);
+  }
+  return trajectory;
+}
+
+void AnimationManager::LoadBlendClips(const std::string& playedClip)
+{
+  blendClips.clear();
+  walkLayer = runLayer = -1;
+  motionMatching.reset();
+  useMotionMatching = false;
+  if (!animator || !model)
+    return;
+
+  auto* dm = Engine::managers_.GetManager<DeserializeManager*>();
+  for (size_t section = 0; section < dm->SectionPaths.size() && section < 2; ++section)
+  {
+    for (auto& path : dm->ReadSectionPath(dm->SectionPaths[section]))
+    {
+      int layer = 0;
+      if (path != playedClip)
+      {
+        blendClips.push_back(std::make_unique<SkeletalAnimation>(path, model));
+        layer = animator->AddLayer(blendClips.back().get());
+      }
+      if (section == 0)
+        walkLayer = layer;
+      else
+        runLayer = layer;
     }
   }
 }
@@ -1,70 +1,292 @@
 #include "Animator.h"
 #include "SkeletalAnimation.h"
 #include "Bone.h"
+#include "QuaternionBatch.h"
+#include <algorithm>
+#include <cmath>
 
-void Animator::CalculateBoneTransform(const NodeData* node, glm::mat4 parentTransform)
+void Animator::SampleLayer(Layer& layer, float minReach, PoseBuffer& pose)
 {
-  std::string nodeName = node->name;
-  glm::mat4 nodeTransform = node->transformation;
-  
-  Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
-  
-  if (Bone)
+  const FlatSkeleton& skeleton = m_CurrentAnimation->GetSkeleton();
+  const std::vector<Bone>& bones = layer.clip->GetBonesData();
+  const CompressedClip& clip = layer.clip->GetCompressedClip();
+  bool compressed = useCompressedClip && !clip.Empty();
+  float time = (layer.synced ? m_Phase : layer.phase) * layer.clip->GetDuration();
+
+  pose = m_BindPose;
+  m_RotationFrom.clear();
+  m_RotationTo.clear();
+  m_RotationFactor.clear();
+  m_RotationNode.clear();
+  for (size_t i = 0; i < layer.tracks.size(); ++i)
   {
-    Bone->Update(m_CurrentTime);
-    nodeTransform = Bone->getLocalTransform();
+    int track = layer.tracks[i];
+    // short chains such as fingers stay in bind pose at a distance
+    if (track < 0 || skeleton.reach[i] < minReach)
+      continue;
+
+    // the clip is only read, every animator keeps its own key cursors
+    if (compressed)
+    {
+      pose.Set(i, clip.Sample(track, time, layer.cursors[track], rotationInterpolation));
+      continue;
+    }
+
+    // translation and scale here, rotations are interpolated together below
+    const Bone& bone = bones[track];
+    float factor = 0.f;
+    int key = bone.getKeyPair(time, layer.cursors[track], factor);
+    int next = std::min(key + 1, static_cast<int>(bone.getTimes().size()) - 1);
+    pose.translation[i] = Interpolation::lerp(bone.getPositions()[key], bone.getPositions()[next], factor);
+    pose.scale[i] = Interpolation::Elerp(bone.getScales()[key], bone.getScales()[next], factor);
+    pose.animated[i] = 1;
+    m_RotationFrom.push_back(bone.getRotations()[key]);
+    m_RotationTo.push_back(bone.getRotations()[next]);
+    m_RotationFactor.push_back(factor);
+    m_RotationNode.push_back(static_cast<int>(i));
   }
-  
-  glm::mat4 globalTransformation = parentTransform * nodeTransform;
-  
-  auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-  if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+
+  QuaternionBatch::Interpolate(m_RotationFrom.data(), m_RotationTo.data(), m_RotationFactor.data(),
+    m_RotationFrom.data(), m_RotationFrom.size(), rotationInterpolation);
+  for (size_t k = 0; k < m_RotationNode.size(); ++k)
+    pose.rotation[m_RotationNode[k]] = m_RotationFrom[k];
+}
+
+void Animator::CalculateBoneTransforms()
+{
+  const FlatSkeleton& skeleton = m_CurrentAnimation->GetSkeleton();
+  float minReach = lod.cullFraction * skeleton.maxReach;
+
+  // normalized running blend, each layer moves the pose by its share of the weight so far
+  float accumulated = 0.f;
+  for (auto& layer : m_Layers)
   {
-    // get id of bone from map
-    int index = boneInfoMap[nodeName].id;
+    if (layer.weight <= 0.f)
+      continue;
+    if (accumulated <= 0.f)
+    {
+      accumulated = layer.weight;
+      SampleLayer(layer, minReach, m_Pose);
+      continue;
+    }
+    accumulated += layer.weight;
+    SampleLayer(layer, minReach, m_LayerPose);
+    m_Pose.Blend(m_LayerPose, layer.weight / accumulated);
+  }
+  if (accumulated <= 0.f)
+    SampleLayer(m_Layers[0], minReach, m_Pose);
 
-    // get offset matrix of bone from map
-    glm::mat4 offset = boneInfoMap[nodeName].offset;
+  m_Pose.LocalTransforms(skeleton, m_LocalTransforms);
+  for (size_t i = 0; i < skeleton.parent.size(); ++i)
+  {
+    const glm::mat4& nodeTransform = m_LocalTransforms[i];
+    int parent = skeleton.parent[i];
+    m_GlobalTransforms[i] = parent < 0 ? nodeTransform : m_GlobalTransforms[parent] * nodeTransform;
 
-    // use id to index in the array of final matrices and concatenate offset matrix
-    m_FinalBoneMatrices[index] = globalTransformation * offset;
-    m_PreOffSetMatrices[index] = globalTransformation;
+    int index = skeleton.boneID[i];
+    if (index >= 0)
+    {
+      m_FinalBoneMatrices[index] = m_GlobalTransforms[i] * skeleton.offset[i];
+      m_PreOffSetMatrices[index] = m_GlobalTransforms[i];
+    }
   }
-  
-  for (int i = 0; i < node->childrenCount; i++)
-    CalculateBoneTransform(&node->children[i], globalTransformation);
+  m_DualQuaternionsDirty = true;
 }
 
 Animator::Animator(SkeletalAnimation* currentAnimation)
 {
-  m_CurrentTime = 0.0;
   m_CurrentAnimation = currentAnimation;
+  ResizeBuffers();
+}
+
+void Animator::ResizeBuffers()
+{
+  m_Layers.clear();
+  m_Phase = 0.f;
+  m_LodFrame = 0;
+  m_FadeTarget = -1;
+  if (!m_CurrentAnimation)
+    return;
+
+  int boneCount = m_CurrentAnimation->GetBoneTable().Size();
+
+  m_FinalBoneMatrices.assign(boneCount, glm::mat4(1.0f));
+  m_PreOffSetMatrices.assign(boneCount, glm::mat4(1.0f));
+  m_FinalBoneDualQuaternions.assign(boneCount, DualQuaternion());
+  m_DualQuaternionsDirty = true;
+  m_GlobalTransforms.resize(m_CurrentAnimation->GetSkeleton().parent.size());
+  m_BindPose.SetBind(m_CurrentAnimation->GetSkeleton());
+
+  AddLayer(m_CurrentAnimation);
+  m_Layers[0].weight = 1.f;
+}
+
+int Animator::AddLayer(SkeletalAnimation* clip)
+{
+  const FlatSkeleton& skeleton = m_CurrentAnimation->GetSkeleton();
+  Layer layer;
+  layer.clip = clip;
+  layer.tracks.assign(skeleton.parent.size(), -1);
+  layer.cursors.assign(clip->GetBonesData().size(), 0);
+
+  if (clip == m_CurrentAnimation)
+  {
+    layer.tracks = skeleton.bone;
+  }
+  else
+  {
+    const Bone* first = clip->GetBonesData().data();
+    for (size_t i = 0; i < skeleton.name.size(); ++i)
+    {
+      const Bone* bone = clip->FindBone(skeleton.name[i]);
+      if (bone)
+        layer.tracks[i] = static_cast<int>(bone - first);
+    }
+  }
+
+  m_Layers.push_back(std::move(layer));
+  return static_cast<int>(m_Layers.size()) - 1;
+}
+
+int Animator::GetLayerCount() const
+{
+  return static_cast<int>(m_Layers.size());
+}
 
-  m_FinalBoneMatrices.reserve(100);
-  m_PreOffSetMatrices.reserve(100);
+SkeletalAnimation* Animator::GetLayerClip(int layer) const
+{
+  return m_Layers[layer].clip;
+}
 
-  for (int i = 0; i < 100; i++)
-    m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+float Animator::GetLayerWeight(int layer) const
+{
+  return m_Layers[layer].weight;
+}
 
-  for (int i = 0; i < 100; i++)
-    m_PreOffSetMatrices.push_back(glm::mat4(1.0f));
+void Animator::SetLayerWeight(int layer, float weight)
+{
+  m_FadeTarget = -1;
+  m_Layers[layer].weight = std::max(weight, 0.f);
+}
+
+void Animator::CrossFade(int layer, float duration)
+{
+  for (auto& l : m_Layers)
+    l.fadeFrom = l.weight;
+  m_FadeTarget = layer;
+  m_FadeTime = 0.f;
+  m_FadeDuration = duration;
+}
+
+void Animator::SeekLayer(int layer, float time)
+{
+  Layer& l = m_Layers[layer];
+  float duration = l.clip->GetDuration();
+  l.synced = false;
+  l.phase = duration > 0.f ? std::fmod(std::max(time, 0.f), duration) / duration : 0.f;
+}
+
+float Animator::GetLayerTime(int layer) const
+{
+  const Layer& l = m_Layers[layer];
+  return (l.synced ? m_Phase : l.phase) * l.clip->GetDuration();
+}
+
+void Animator::Blend1D(int a, int b, float parameter)
+{
+  m_FadeTarget = -1;
+  parameter = glm::clamp(parameter, 0.f, 1.f);
+  for (auto& layer : m_Layers)
+    layer.weight = 0.f;
+  m_Layers[a].weight += 1.f - parameter;
+  m_Layers[b].weight += parameter;
+}
+
+float Animator::PhaseRate()
+{
+  float rate = 0.f;
+  float total = 0.f;
+  for (auto& layer : m_Layers)
+  {
+    float duration = layer.clip->GetDuration();
+    if (!layer.synced || layer.weight <= 0.f || duration <= 0.f)
+      continue;
+    rate += layer.weight * layer.clip->GetTicksPerSecond() / duration;
+    total += layer.weight;
+  }
+  if (total > 0.f)
+    return rate / total;
+
+  float duration = m_CurrentAnimation->GetDuration();
+  return duration > 0.f ? m_CurrentAnimation->GetTicksPerSecond() / duration : 0.f;
 }
 
 void Animator::UpdateAnimation(float dt)
 {
   m_DeltaTime = dt;
-  if (m_CurrentAnimation)
+  if (!m_CurrentAnimation)
+    return;
+
+  if (m_FadeTarget >= 0)
   {
-    m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt * speed * SlidingSkiddingControl;
-    m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
-    CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+    m_FadeTime += dt;
+    float t = m_FadeDuration > 0.f ? std::min(m_FadeTime / m_FadeDuration, 1.f) : 1.f;
+    for (size_t i = 0; i < m_Layers.size(); ++i)
+      m_Layers[i].weight = m_Layers[i].fadeFrom * (1.f - t) + (static_cast<int>(i) == m_FadeTarget ? t : 0.f);
+    if (t >= 1.f)
+      m_FadeTarget = -1;
   }
+
+  float step = PhaseRate() * dt * speed * SlidingSkiddingControl;
+  m_Phase = std::fmod(m_Phase + step, 1.f);
+  for (auto& layer : m_Layers)
+  {
+    float duration = layer.clip->GetDuration();
+    if (!layer.synced && duration > 0.f)
+      layer.phase = std::fmod(layer.phase + layer.clip->GetTicksPerSecond() / duration * dt * speed * SlidingSkiddingControl, 1.f);
+  }
+  if (!lod.visible)
+  {
+    m_LodFrame = 0;
+    return;
+  }
+  if (lod.interval <= 1)
+  {
+    m_LodFrame = 0;
+    CalculateBoneTransforms();
+    return;
+  }
+
+  // evaluate the pose at the end of the interval once, then blend the palette toward it
+  if (m_LodFrame == 0)
+  {
+    m_LodFrom = m_FinalBoneMatrices;
+    float phase = m_Phase;
+    m_Phase = std::fmod(m_Phase + step * (lod.interval - 1), 1.f);
+    CalculateBoneTransforms();
+    m_Phase = phase;
+    m_LodTo = m_FinalBoneMatrices;
+  }
+  ++m_LodFrame;
+  float t = static_cast<float>(m_LodFrame) / lod.interval;
+  for (size_t i = 0; i < m_FinalBoneMatrices.size(); ++i)
+    m_FinalBoneMatrices[i] = m_LodFrom[i] + (m_LodTo[i] - m_LodFrom[i]) * t;
+  m_DualQuaternionsDirty = true;
+  if (m_LodFrame >= lod.interval)
+    m_LodFrame = 0;
 }
 
 void Animator::PlayAnimation(SkeletalAnimation* pAnimation)
 {
   m_CurrentAnimation = pAnimation;
-  m_CurrentTime = 0.0f;
+  ResizeBuffers();
+}
+
+void Animator::Seek(float time)
+{
+  float duration = m_CurrentAnimation ? m_CurrentAnimation->GetDuration() : 0.f;
+  if (duration > 0.f)
+    m_Phase = std::fmod(time, duration) / duration;
 }
 
 std::vector<glm::mat4>& Animator::GetFinalBoneMatrices()
@@ -72,7 +294,18 @@ std::vector<glm::mat4>& Animator::GetFinalBoneMatrices()
   return m_FinalBoneMatrices;
 }
 
-std::vector<glm::mat4> Animator::GetPreOffSetMatrices()
+std::vector<DualQuaternion>& Animator::GetFinalBoneDualQuaternions()
+{
+  if (m_DualQuaternionsDirty)
+  {
+    for (size_t i = 0; i < m_FinalBoneMatrices.size(); ++i)
+      m_FinalBoneDualQuaternions[i] = DualQuaternion::FromMatrix(m_FinalBoneMatrices[i]);
+    m_DualQuaternionsDirty = false;
+  }
+  return m_FinalBoneDualQuaternions;
+}
+
+const std::vector<glm::mat4>& Animator::GetPreOffSetMatrices() const
 {
   return m_PreOffSetMatrices;
 }
@@ -81,7 +314,6 @@ void Animator::UpdateVBO()
 {
   // update position of bone when model is animating
   CHECKERROR;
-  auto& boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
 
   // get each bone local position
   // and layout continuously
@@ -89,7 +321,7 @@ void Animator::UpdateVBO()
   {
     // local-space position
     m_CurrentAnimation->bonePosition[i] = 
-      glm::vec3(m_PreOffSetMatrices[boneInfoMap[m_CurrentAnimation->boneName[i]].id] * 
+      glm::vec3(m_PreOffSetMatrices[m_CurrentAnimation->boneIDs[i]] * 
         glm::vec4(m_CurrentAnimation->boneLocalPosition[i], 1.f));
   }
   CHECKERROR;
@@ -1,60 +1,136 @@
 #include "Bone.h"
 
 #include <assimp/scene.h>
+#include <algorithm>
 
-Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel) : m_Name(name), m_ID(ID), m_LocalTransform(1.0f)
+namespace
 {
-  // read in position key frame data
-  m_NumPositions = channel->mNumPositionKeys;
-  for (int positionIndex = 0; positionIndex < m_NumPositions; ++positionIndex)
+  // first key of the interval holding t, keys are sorted by mTime
+  template <typename Key>
+  int KeyInterval(const Key* keys, int count, float t)
+  {
+    const Key* it = std::upper_bound(keys, keys + count, t,
+      [](float time, const Key& key) { return time < static_cast<float>(key.mTime); });
+    return glm::clamp(static_cast<int>(it - keys) - 1, 0, count - 2);
+  }
+
+  template <typename Key>
+  float KeyFactor(const Key* keys, int k, float t)
+  {
+    float t0 = static_cast<float>(keys[k].mTime);
+    float t1 = static_cast<float>(keys[k + 1].mTime);
+    return t1 > t0 ? glm::clamp((t - t0) / (t1 - t0), 0.f, 1.f) : 0.f;
+  }
+
+  glm::vec3 ToVec3(const aiVector3D& v)
+  {
+    return glm::vec3(v.x, v.y, v.z);
+  }
+
+  Quaternion ToQuaternion(const aiQuaternion& q)
+  {
+    return Quaternion(q.w, q.x, q.y, q.z);
+  }
+
+  glm::vec3 SamplePosition(const aiNodeAnim* channel, float t)
   {
-    aiVector3D aiPosition = channel->mPositionKeys[positionIndex].mValue;
-    float timeStamp = channel->mPositionKeys[positionIndex].mTime;
-    KeyPosition data;
-    data.position.x = aiPosition.x;
-    data.position.y = aiPosition.y;
-    data.position.z = aiPosition.z;
-    data.timeStamp = timeStamp;
-    m_Positions.push_back(data);
+    int count = static_cast<int>(channel->mNumPositionKeys);
+    if (count == 0)
+      return glm::vec3(0.f);
+    if (count == 1)
+      return ToVec3(channel->mPositionKeys[0].mValue);
+
+    int k = KeyInterval(channel->mPositionKeys, count, t);
+    return Interpolation::lerp(ToVec3(channel->mPositionKeys[k].mValue),
+      ToVec3(channel->mPositionKeys[k + 1].mValue), KeyFactor(channel->mPositionKeys, k, t));
   }
 
-  // read in orientation key frame data
-  m_NumRotations = channel->mNumRotationKeys;
-  for (int rotationIndex = 0; rotationIndex < m_NumRotations; ++rotationIndex)
+  Quaternion SampleRotation(const aiNodeAnim* channel, float t)
   {
-    //glm::quat a()
-    aiQuaternion aiOrientation = channel->mRotationKeys[rotationIndex].mValue;
-    float timeStamp = channel->mRotationKeys[rotationIndex].mTime;
-    KeyRotation data;
-    data.orientation._s = aiOrientation.w;
-    data.orientation._v.x = aiOrientation.x;
-    data.orientation._v.y = aiOrientation.y;
-    data.orientation._v.z = aiOrientation.z;
-    data.timeStamp = timeStamp;
-    m_Rotations.push_back(data);
+    int count = static_cast<int>(channel->mNumRotationKeys);
+    if (count == 0)
+      return Quaternion();
+    if (count == 1)
+      return ToQuaternion(channel->mRotationKeys[0].mValue).normalize();
+
+    int k = KeyInterval(channel->mRotationKeys, count, t);
+    return Interpolation::Slerp(ToQuaternion(channel->mRotationKeys[k].mValue),
+      ToQuaternion(channel->mRotationKeys[k + 1].mValue), KeyFactor(channel->mRotationKeys, k, t)).normalize();
   }
 
-  // read in scaling key frame data
-  m_NumScalings = channel->mNumScalingKeys;
-  for (int keyIndex = 0; keyIndex < m_NumScalings; ++keyIndex)
+  glm::vec3 SampleScale(const aiNodeAnim* channel, float t)
   {
-    aiVector3D scale = channel->mScalingKeys[keyIndex].mValue;
-    float timeStamp = channel->mScalingKeys[keyIndex].mTime;
-    KeyScale data;
-    data.scale.x = scale.x;
-    data.scale.y = scale.y;
-    data.scale.z = scale.z;
-    data.timeStamp = timeStamp;
-    m_Scales.push_back(data);
+    int count = static_cast<int>(channel->mNumScalingKeys);
+    if (count == 0)
+      return glm::vec3(1.f);
+    if (count == 1)
+      return ToVec3(channel->mScalingKeys[0].mValue);
+
+    int k = KeyInterval(channel->mScalingKeys, count, t);
+    return Interpolation::Elerp(ToVec3(channel->mScalingKeys[k].mValue),
+      ToVec3(channel->mScalingKeys[k + 1].mValue), KeyFactor(channel->mScalingKeys, k, t));
   }
 }
 
+Bone::Bone(const std::string& name, int ID, const aiNodeAnim* channel) : m_Name(name), m_ID(ID), m_LocalTransform(1.0f)
+{
+  // shared time array is the union of the position, rotation and scale timestamps
+  for (unsigned i = 0; i < channel->mNumPositionKeys; ++i)
+    m_Times.push_back(static_cast<float>(channel->mPositionKeys[i].mTime));
+  for (unsigned i = 0; i < channel->mNumRotationKeys; ++i)
+    m_Times.push_back(static_cast<float>(channel->mRotationKeys[i].mTime));
+  for (unsigned i = 0; i < channel->mNumScalingKeys; ++i)
+    m_Times.push_back(static_cast<float>(channel->mScalingKeys[i].mTime));
+  std::sort(m_Times.begin(), m_Times.end());
+  m_Times.erase(std::unique(m_Times.begin(), m_Times.end()), m_Times.end());
+  if (m_Times.empty())
+    m_Times.push_back(0.f);
+
+  // lerp, slerp and exponential scale are exact under resampling, the new keys lie on the
+  // interpolation path between the original ones
+  m_Positions.resize(m_Times.size());
+  m_Rotations.resize(m_Times.size());
+  m_Scales.resize(m_Times.size());
+  for (size_t i = 0; i < m_Times.size(); ++i)
+  {
+    m_Positions[i] = SamplePosition(channel, m_Times[i]);
+    m_Rotations[i] = SampleRotation(channel, m_Times[i]);
+    m_Scales[i] = SampleScale(channel, m_Times[i]);
+  }
+
+  m_LocalPose = VQS(m_Positions[0], m_Rotations[0], m_Scales[0]);
+}
+
+Bone::Bone(const std::string& name, int ID, std::vector<float> times, std::vector<glm::vec3> positions,
+  std::vector<Quaternion> rotations, std::vector<glm::vec3> scales)
+  : m_Times(std::move(times)), m_Positions(std::move(positions)), m_Rotations(std::move(rotations)),
+  m_Scales(std::move(scales)), m_LocalTransform(1.0f), m_Name(name), m_ID(ID)
+{
+  m_LocalPose = VQS(m_Positions[0], m_Rotations[0], m_Scales[0]);
+}
+
 void Bone::Update(float animationTime)
 {
-  glm::mat4 translation = InterpolatePosition(animationTime);
-  glm::mat4 rotation = InterpolateRotation(animationTime);
-  glm::mat4 scale = InterpolateScaling(animationTime);
-  m_LocalTransform = translation * rotation * scale;
+  m_LocalPose = Sample(animationTime);
+  m_LocalTransform = m_LocalPose.toMat4();
+}
+
+VQS Bone::Sample(float animationTime)
+{
+  return Sample(animationTime, m_Cursor);
+}
+
+VQS Bone::Sample(float animationTime, int& cursor, RotationInterpolation mode) const
+{
+  float scaleFactor = 0.f;
+  int p0Index = getKeyPair(animationTime, cursor, scaleFactor);
+  int p1Index = std::min(p0Index + 1, static_cast<int>(m_Times.size()) - 1);
+
+  glm::vec3 finalPosition = Interpolation::lerp(m_Positions[p0Index], m_Positions[p1Index], scaleFactor);
+  Quaternion finalRotation = Interpolation::Interpolate(m_Rotations[p0Index], m_Rotations[p1Index], scaleFactor, mode);
+  glm::vec3 finalScale = Interpolation::Elerp(m_Scales[p0Index], m_Scales[p1Index], scaleFactor);
+
+  return VQS(finalPosition, finalRotation, finalScale);
 }
 
 glm::mat4 Bone::getLocalTransform()
@@ -62,6 +138,11 @@ glm::mat4 Bone::getLocalTransform()
   return m_LocalTransform;
 }
 
+VQS Bone::getLocalPose()
+{
+  return m_LocalPose;
+}
+
 std::string Bone::getBoneName() const
 {
   return m_Name;
@@ -72,104 +153,70 @@ int Bone::getBoneID()
   return m_ID;
 }
 
-int Bone::getPositionIndex(float animationTime)
+const std::vector<float>& Bone::getTimes() const
 {
-  for (int index = 0; index < m_NumPositions - 1; ++index)
-  {
-    if (animationTime < m_Positions[index + 1].timeStamp)
-      return index;
-  }
-  assert(0);
+  return m_Times;
 }
 
-int Bone::getRotationIndex(float animationTime)
+const std::vector<glm::vec3>& Bone::getPositions() const
 {
-  for (int index = 0; index < m_NumRotations - 1; ++index)
-  {
-    if (animationTime < m_Rotations[index + 1].timeStamp)
-      return index;
-  }
-  assert(0);
+  return m_Positions;
 }
 
-int Bone::getScaleIndex(float animationTime)
+const std::vector<Quaternion>& Bone::getRotations() const
 {
-  for (int index = 0; index < m_NumScalings - 1; ++index)
-  {
-    if (animationTime < m_Scales[index + 1].timeStamp)
-      return index;
-  }
-  assert(0);
+  return m_Rotations;
 }
 
-/* Gets normalized value for Lerp & Slerp*/
-float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+const std::vector<glm::vec3>& Bone::getScales() const
 {
-  float scaleFactor = 0.0f;
-  float midWayLength = animationTime - lastTimeStamp;
-  float framesDiff = nextTimeStamp - lastTimeStamp;
-  scaleFactor = midWayLength / framesDiff;
-  return scaleFactor;
+  return m_Scales;
 }
 
-/*figures out which position keys to interpolate b/w and performs the interpolation
-and returns the translation matrix*/
-glm::mat4 Bone::InterpolatePosition(float animationTime)
+int Bone::getKeyIndex(float animationTime)
 {
-  if (1 == m_NumPositions)
-    return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
-
-  int p0Index = getPositionIndex(animationTime);
-  int p1Index = p0Index + 1;
-  float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
-    m_Positions[p1Index].timeStamp, animationTime);
-
-  // lerp
-  glm::vec3 finalPosition = Interpolation::lerp(m_Positions[p0Index].position,
-    m_Positions[p1Index].position, scaleFactor);
-
-  return glm::translate(glm::mat4(1.0f), finalPosition);
+  return getKeyIndex(animationTime, m_Cursor);
 }
 
-/*figures out which rotations keys to interpolate b/w and performs the interpolation
-and returns the rotation matrix*/
-glm::mat4 Bone::InterpolateRotation(float animationTime)
+int Bone::getKeyIndex(float animationTime, int& cursor) const
 {
-  if (1 == m_NumRotations)
+  int last = static_cast<int>(m_Times.size()) - 2;
+  if (last < 0)
+    return 0;
+
+  // forward playback stays in the cached interval or steps into the next one
+  int k = glm::clamp(cursor, 0, last);
+  if (animationTime >= m_Times[k])
   {
-    Quaternion rotation = m_Rotations[0].orientation.normalize();
-    return rotation.toMat4();
+    if (k == last || animationTime < m_Times[k + 1])
+      return cursor = k;
+    if (k + 1 == last || animationTime < m_Times[k + 2])
+      return cursor = k + 1;
   }
 
-  int p0Index = getRotationIndex(animationTime);
-  int p1Index = p0Index + 1;
-  float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
-    m_Rotations[p1Index].timeStamp, animationTime);
-
-  // slerp
-  Quaternion finalRotation = Interpolation::Slerp(
-    m_Rotations[p0Index].orientation,
-    m_Rotations[p1Index].orientation,
-    scaleFactor);
-
-  return finalRotation.normalize().toMat4();
+  // seek or loop wrap, binary search
+  auto it = std::upper_bound(m_Times.begin(), m_Times.end(), animationTime);
+  cursor = glm::clamp(static_cast<int>(it - m_Times.begin()) - 1, 0, last);
+  return cursor;
 }
 
-/*figures out which scaling keys to interpolate b/w and performs the interpolation
-and returns the scale matrix*/
-glm::mat4 Bone::InterpolateScaling(float animationTime)
+int Bone::getKeyPair(float animationTime, int& cursor, float& factor) const
 {
-  if (1 == m_NumScalings)
-    return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
-
-  int p0Index = getScaleIndex(animationTime);
-  int p1Index = p0Index + 1;
-  float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
-    m_Scales[p1Index].timeStamp, animationTime);
+  factor = 0.f;
+  if (m_Times.size() < 2)
+    return 0;
 
-  // lerp
-  glm::vec3 finalScale = Interpolation::Elerp(m_Scales[p0Index].scale, m_Scales[p1Index].scale
-    , scaleFactor);
+  int key = getKeyIndex(animationTime, cursor);
+  factor = glm::clamp(GetScaleFactor(m_Times[key], m_Times[key + 1], animationTime), 0.f, 1.f);
+  return key;
+}
 
-  return glm::scale(glm::mat4(1.0f), finalScale);
-}
\ No newline at end of file
+/* Gets normalized value for Lerp & Slerp*/
+float Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime) const
+{
+  float scaleFactor = 0.0f;
+  float midWayLength = animationTime - lastTimeStamp;
+  float framesDiff = nextTimeStamp - lastTimeStamp;
+  scaleFactor = midWayLength / framesDiff;
+  return scaleFactor;
+}
@@ -2,6 +2,7 @@
 #include "Shape.h"
 #include "AllManagers.h"
 #include "Shader.h"
+#include "OcclusionCuller.h"
 #include <algorithm>
 #include <iostream>
 #include <numeric>
@@ -14,6 +15,7 @@ std::uniform_real_distribution<> myrandom1(0.0, 1.0);
 void BspTree::ClearLeafNodes()
 {
   leaf_nodes_.clear();
+  occluder_nodes_.clear();
 }
 
 
@@ -108,6 +110,25 @@ void BspTree::Draw(ShaderProgram* shaderProgam)
   }
 }
 
+void BspTree::SelectOccluders(int max_leaves)
+{
+  occluder_nodes_ = leaf_nodes_;
+  std::sort(occluder_nodes_.begin(), occluder_nodes_.end(), [](const TreeNode* a, const TreeNode* b)
+    {
+      return a->indices_.size() > b->indices_.size();
+    });
+  if (occluder_nodes_.size() > static_cast<size_t>(std::max(max_leaves, 0)))
+    occluder_nodes_.resize(std::max(max_leaves, 0));
+}
+
+void BspTree::RasterizeOccluders(OcclusionCuller* culler, const glm::mat4& modelTr)
+{
+  for (auto* node : occluder_nodes_)
+  {
+    culler->RasterizeOccluder(node->vertices_, node->indices_, modelTr);
+  }
+}
+
 CLASSIFY_TRIANGLE_PLANE BspTree::ClassifyPolygon(Triangle tri, S_Plane p)
 {
   //float d = glm::dot(p.normal_, p.p_);
@@ -118,21 +118,12 @@ bool CCDSolver::Solve(glm::vec3& worldLocationGoal)
       // want to apply constraint?
       if (applyConstraint)
       {
-        // apply hinge constraint to elbow joint to prevent bending outwardly which is unrealistic
-        if (world.name == "LeftForeArm")
+        // hinge keeps the elbow and finger joints from bending outwardly which is unrealistic,
+        // ball-and-socket limits the shoulder and hand
+        if (world.constraint == IKConstraint::Hinge)
           ApplyHingeConstraint(j, world.worldRotation.getAxis());
-
-        // apply hinge constraint to finger joints to prevent bending outwardly which is unrealistic
-        if (world.name == "LeftHandIndex1" || world.name == "LeftHandIndex2" || world.name == "LeftHandIndex3")
-          ApplyHingeConstraint(j, world.worldRotation.getAxis());
-
-        // apply ball-and-socket constraint to shoulder joint
-        if (world.name == "LeftArm")
-          ApplyBallSocketConstraint(j, 2.617993878f); // 150 degree
-
-        // apply ball-and-socket constraint to hand joint
-        if (world.name == "LeftHand")
-          ApplyBallSocketConstraint(j, 0.5235987756f); // 30 degree
+        else if (world.constraint == IKConstraint::BallSocket)
+          ApplyBallSocketConstraint(j, world.coneLimit);
       }
 
       // apply transformation hierarchically through the IK chain
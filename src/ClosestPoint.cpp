@@ -0,0 +1,258 @@
+#include "ClosestPoint.h"
+#include <xmmintrin.h>
+
+void ClosestPoint::Triangle4::Set(int lane, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+{
+  ax[lane] = A.x; ay[lane] = A.y; az[lane] = A.z;
+  bx[lane] = B.x; by[lane] = B.y; bz[lane] = B.z;
+  cx[lane] = C.x; cy[lane] = C.y; cz[lane] = C.z;
+}
+
+glm::vec3 ClosestPoint::PointSegment(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, float& t)
+{
+  glm::vec3 AB = B - A;
+  float denom = glm::dot(AB, AB);
+  t = denom > 0.f ? glm::clamp(glm::dot(P - A, AB) / denom, 0.f, 1.f) : 0.f;
+  return A + AB * t;
+}
+
+glm::vec3 ClosestPoint::PointTriangle(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+{
+  glm::vec3 weights;
+  return PointTriangle(P, A, B, C, weights);
+}
+
+glm::vec3 ClosestPoint::PointTriangle(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C,
+  glm::vec3& weights)
+{
+  glm::vec3 AB = B - A;
+  glm::vec3 AC = C - A;
+
+  // vertex region A
+  glm::vec3 AP = P - A;
+  float d1 = glm::dot(AB, AP);
+  float d2 = glm::dot(AC, AP);
+  if (d1 <= 0.f && d2 <= 0.f)
+  {
+    weights = { 1.f, 0.f, 0.f };
+    return A;
+  }
+
+  // vertex region B
+  glm::vec3 BP = P - B;
+  float d3 = glm::dot(AB, BP);
+  float d4 = glm::dot(AC, BP);
+  if (d3 >= 0.f && d4 <= d3)
+  {
+    weights = { 0.f, 1.f, 0.f };
+    return B;
+  }
+
+  // edge region AB
+  float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+  {
+    float v = d1 / (d1 - d3);
+    weights = { 1.f - v, v, 0.f };
+    return A + AB * v;
+  }
+
+  // vertex region C
+  glm::vec3 CP = P - C;
+  float d5 = glm::dot(AB, CP);
+  float d6 = glm::dot(AC, CP);
+  if (d6 >= 0.f && d5 <= d6)
+  {
+    weights = { 0.f, 0.f, 1.f };
+    return C;
+  }
+
+  // edge region AC
+  float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+  {
+    float w = d2 / (d2 - d6);
+    weights = { 1.f - w, 0.f, w };
+    return A + AC * w;
+  }
+
+  // edge region BC
+  float va = d3 * d6 - d5 * d4;
+  if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+  {
+    float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    weights = { 0.f, 1.f - w, w };
+    return B + (C - B) * w;
+  }
+
+  // inside face region
+  float denom = 1.f / (va + vb + vc);
+  float v = vb * denom;
+  float w = vc * denom;
+  weights = { 1.f - v - w, v, w };
+  return A + AB * v + AC * w;
+}
+
+namespace
+{
+  inline __m128 Dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+  {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+  }
+
+  inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+}
+
+// same regions as PointTriangle, every lane evaluates all of them and the
+// result is written as A + AB * v + AC * w with (v, w) picked per region
+void ClosestPoint::PointTriangle4(const glm::vec3& P, const Triangle4& tri, float outDistSq[4], glm::vec3 outPoint[4],
+  float outV[4], float outW[4])
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+
+  __m128 px = _mm_set1_ps(P.x), py = _mm_set1_ps(P.y), pz = _mm_set1_ps(P.z);
+  __m128 ax = _mm_load_ps(tri.ax), ay = _mm_load_ps(tri.ay), az = _mm_load_ps(tri.az);
+  __m128 bx = _mm_load_ps(tri.bx), by = _mm_load_ps(tri.by), bz = _mm_load_ps(tri.bz);
+  __m128 cx = _mm_load_ps(tri.cx), cy = _mm_load_ps(tri.cy), cz = _mm_load_ps(tri.cz);
+
+  __m128 abx = _mm_sub_ps(bx, ax), aby = _mm_sub_ps(by, ay), abz = _mm_sub_ps(bz, az);
+  __m128 acx = _mm_sub_ps(cx, ax), acy = _mm_sub_ps(cy, ay), acz = _mm_sub_ps(cz, az);
+
+  __m128 apx = _mm_sub_ps(px, ax), apy = _mm_sub_ps(py, ay), apz = _mm_sub_ps(pz, az);
+  __m128 d1 = Dot3(abx, aby, abz, apx, apy, apz);
+  __m128 d2 = Dot3(acx, acy, acz, apx, apy, apz);
+
+  __m128 bpx = _mm_sub_ps(px, bx), bpy = _mm_sub_ps(py, by), bpz = _mm_sub_ps(pz, bz);
+  __m128 d3 = Dot3(abx, aby, abz, bpx, bpy, bpz);
+  __m128 d4 = Dot3(acx, acy, acz, bpx, bpy, bpz);
+
+  __m128 cpx = _mm_sub_ps(px, cx), cpy = _mm_sub_ps(py, cy), cpz = _mm_sub_ps(pz, cz);
+  __m128 d5 = Dot3(abx, aby, abz, cpx, cpy, cpz);
+  __m128 d6 = Dot3(acx, acy, acz, cpx, cpy, cpz);
+
+  __m128 va = _mm_sub_ps(_mm_mul_ps(d3, d6), _mm_mul_ps(d5, d4));
+  __m128 vb = _mm_sub_ps(_mm_mul_ps(d5, d2), _mm_mul_ps(d1, d6));
+  __m128 vc = _mm_sub_ps(_mm_mul_ps(d1, d4), _mm_mul_ps(d3, d2));
+
+  // face region
+  __m128 denom = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(va, vb), vc));
+  __m128 v = _mm_mul_ps(vb, denom);
+  __m128 w = _mm_mul_ps(vc, denom);
+
+  // apply regions from lowest to highest priority so the first match of the scalar version wins
+  // edge BC
+  __m128 d43 = _mm_sub_ps(d4, d3);
+  __m128 d56 = _mm_sub_ps(d5, d6);
+  __m128 maskBC = _mm_and_ps(_mm_cmple_ps(va, zero), _mm_and_ps(_mm_cmpge_ps(d43, zero), _mm_cmpge_ps(d56, zero)));
+  __m128 tBC = _mm_div_ps(d43, _mm_add_ps(d43, d56));
+  v = Select(maskBC, _mm_sub_ps(one, tBC), v);
+  w = Select(maskBC, tBC, w);
+
+  // edge AC
+  __m128 maskAC = _mm_and_ps(_mm_cmple_ps(vb, zero), _mm_and_ps(_mm_cmpge_ps(d2, zero), _mm_cmple_ps(d6, zero)));
+  v = Select(maskAC, zero, v);
+  w = Select(maskAC, _mm_div_ps(d2, _mm_sub_ps(d2, d6)), w);
+
+  // vertex C
+  __m128 maskC = _mm_and_ps(_mm_cmpge_ps(d6, zero), _mm_cmple_ps(d5, d6));
+  v = Select(maskC, zero, v);
+  w = Select(maskC, one, w);
+
+  // edge AB
+  __m128 maskAB = _mm_and_ps(_mm_cmple_ps(vc, zero), _mm_and_ps(_mm_cmpge_ps(d1, zero), _mm_cmple_ps(d3, zero)));
+  v = Select(maskAB, _mm_div_ps(d1, _mm_sub_ps(d1, d3)), v);
+  w = Select(maskAB, zero, w);
+
+  // vertex B
+  __m128 maskB = _mm_and_ps(_mm_cmpge_ps(d3, zero), _mm_cmple_ps(d4, d3));
+  v = Select(maskB, one, v);
+  w = Select(maskB, zero, w);
+
+  // vertex A
+  __m128 maskA = _mm_and_ps(_mm_cmple_ps(d1, zero), _mm_cmple_ps(d2, zero));
+  v = Select(maskA, zero, v);
+  w = Select(maskA, zero, w);
+
+  __m128 qx = _mm_add_ps(ax, _mm_add_ps(_mm_mul_ps(abx, v), _mm_mul_ps(acx, w)));
+  __m128 qy = _mm_add_ps(ay, _mm_add_ps(_mm_mul_ps(aby, v), _mm_mul_ps(acy, w)));
+  __m128 qz = _mm_add_ps(az, _mm_add_ps(_mm_mul_ps(abz, v), _mm_mul_ps(acz, w)));
+
+  __m128 dx = _mm_sub_ps(px, qx), dy = _mm_sub_ps(py, qy), dz = _mm_sub_ps(pz, qz);
+  _mm_storeu_ps(outDistSq, Dot3(dx, dy, dz, dx, dy, dz));
+
+  alignas(16) float x[4], y[4], z[4];
+  _mm_store_ps(x, qx);
+  _mm_store_ps(y, qy);
+  _mm_store_ps(z, qz);
+  for (int i = 0; i < 4; ++i)
+    outPoint[i] = { x[i], y[i], z[i] };
+
+  if (outV)
+    _mm_storeu_ps(outV, v);
+  if (outW)
+    _mm_storeu_ps(outW, w);
+}
+
+glm::vec3 ClosestPoint::PointTetrahedron(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C,
+  const glm::vec3& D, glm::vec4& weights)
+{
+  // face i leaves out vertex i, ordered so every face has the same winding
+  const glm::vec3 V[4] = { A, B, C, D };
+  const int faces[4][3] = { { 1, 3, 2 }, { 0, 2, 3 }, { 0, 3, 1 }, { 0, 1, 2 } };
+
+  Triangle4 tri;
+  float outside[4];
+  bool anyOutside = false;
+  for (int i = 0; i < 4; ++i)
+  {
+    const glm::vec3& F0 = V[faces[i][0]];
+    tri.Set(i, F0, V[faces[i][1]], V[faces[i][2]]);
+
+    // P and the left out vertex on opposite sides of the face plane
+    glm::vec3 n = glm::cross(V[faces[i][1]] - F0, V[faces[i][2]] - F0);
+    outside[i] = glm::dot(P - F0, n) * glm::dot(V[i] - F0, n);
+    anyOutside |= outside[i] < 0.f;
+  }
+
+  if (!anyOutside)
+  {
+    // inside, barycentric coordinates from signed volumes
+    float volume = glm::dot(B - A, glm::cross(C - A, D - A));
+    if (std::abs(volume) > 0.f)
+    {
+      weights.y = glm::dot(P - A, glm::cross(C - A, D - A)) / volume;
+      weights.z = glm::dot(B - A, glm::cross(P - A, D - A)) / volume;
+      weights.w = glm::dot(B - A, glm::cross(C - A, P - A)) / volume;
+      weights.x = 1.f - weights.y - weights.z - weights.w;
+      return P;
+    }
+  }
+
+  float distSq[4], v[4], w[4];
+  glm::vec3 points[4];
+  PointTriangle4(P, tri, distSq, points, v, w);
+
+  // flat tetrahedron has no outside face, every face is a candidate
+  int best = -1;
+  for (int i = 0; i < 4; ++i)
+  {
+    if ((outside[i] < 0.f || !anyOutside) && (best < 0 || distSq[i] < distSq[best]))
+      best = i;
+  }
+
+  weights = glm::vec4(0.f);
+  weights[faces[best][0]] = 1.f - v[best] - w[best];
+  weights[faces[best][1]] = v[best];
+  weights[faces[best][2]] = w[best];
+  return points[best];
+}
+
+float ClosestPoint::PointAABBDistSq(const glm::vec3& P, const glm::vec3& min, const glm::vec3& max)
+{
+  glm::vec3 d = glm::max(glm::max(min - P, P - max), glm::vec3(0.f));
+  return glm::dot(d, d);
+}
@@ -0,0 +1,283 @@
+#include "CompressedClip.h"
+#include "Bone.h"
+#include "SkeletalAnimation.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+  constexpr float SQRT2 = 1.41421356f;
+  constexpr float ROTATION_STEPS = 32767.f; // 15 bits per smallest-three component
+  constexpr float RANGE_STEPS = 65535.f;
+
+  // atan2 of the relative rotation, acos of the dot product has no precision near zero
+  float AngleBetween(Quaternion a, Quaternion b)
+  {
+    Quaternion d = a.conjugate() * b;
+    return 2.f * std::atan2(glm::length(d._v), std::abs(d._s));
+  }
+
+  // largest component relative error, scale keys are never zero
+  float ScaleError(const glm::vec3& a, const glm::vec3& b)
+  {
+    glm::vec3 e = glm::abs(a - b) / glm::max(glm::abs(b), glm::vec3(1e-6f));
+    return std::max(e.x, std::max(e.y, e.z));
+  }
+}
+
+void CompressedClip::Clear()
+{
+  tracks_.clear();
+  keys_.clear();
+  duration_ = 0.f;
+}
+
+bool CompressedClip::Empty() const
+{
+  return tracks_.empty();
+}
+
+int CompressedClip::GetTrackCount() const
+{
+  return static_cast<int>(tracks_.size());
+}
+
+int CompressedClip::GetKeyCount() const
+{
+  return static_cast<int>(keys_.size());
+}
+
+size_t CompressedClip::GetMemory() const
+{
+  return keys_.size() * sizeof(PackedKey) + tracks_.size() * sizeof(Track);
+}
+
+// 2 bits for the dropped (largest) component, 3 x 15 bits for the others in [-1/sqrt2, 1/sqrt2]
+void CompressedClip::EncodeRotation(Quaternion q, uint16_t* out)
+{
+  q = q.normalize();
+  float c[4] = { q._s, q._v.x, q._v.y, q._v.z };
+  int largest = 0;
+  for (int i = 1; i < 4; ++i)
+  {
+    if (std::abs(c[i]) > std::abs(c[largest]))
+      largest = i;
+  }
+  // q and -q are the same rotation, keep the dropped component positive
+  float sign = c[largest] < 0.f ? -1.f : 1.f;
+
+  uint64_t packed = static_cast<uint64_t>(largest) << 45;
+  int shift = 30;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (i == largest)
+      continue;
+    float v = glm::clamp((c[i] * sign * SQRT2 + 1.f) * 0.5f, 0.f, 1.f);
+    packed |= static_cast<uint64_t>(v * ROTATION_STEPS + 0.5f) << shift;
+    shift -= 15;
+  }
+
+  out[0] = static_cast<uint16_t>(packed & 0xffff);
+  out[1] = static_cast<uint16_t>((packed >> 16) & 0xffff);
+  out[2] = static_cast<uint16_t>((packed >> 32) & 0xffff);
+}
+
+Quaternion CompressedClip::DecodeRotation(const uint16_t* in)
+{
+  uint64_t packed = static_cast<uint64_t>(in[0]) | (static_cast<uint64_t>(in[1]) << 16) |
+    (static_cast<uint64_t>(in[2]) << 32);
+  int largest = static_cast<int>((packed >> 45) & 3);
+
+  float c[4];
+  float sum = 0.f;
+  int shift = 30;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (i == largest)
+      continue;
+    float v = static_cast<float>((packed >> shift) & 0x7fff) / ROTATION_STEPS;
+    c[i] = (v * 2.f - 1.f) / SQRT2;
+    sum += c[i] * c[i];
+    shift -= 15;
+  }
+  c[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+
+  return Quaternion(c[0], c[1], c[2], c[3]);
+}
+
+void CompressedClip::EncodeRange(const glm::vec3& v, const glm::vec3& min, const glm::vec3& extent, uint16_t* out)
+{
+  for (int c = 0; c < 3; ++c)
+  {
+    float n = extent[c] > 0.f ? glm::clamp((v[c] - min[c]) / extent[c], 0.f, 1.f) : 0.f;
+    out[c] = static_cast<uint16_t>(n * RANGE_STEPS + 0.5f);
+  }
+}
+
+glm::vec3 CompressedClip::DecodeRange(const uint16_t* in, const glm::vec3& min, const glm::vec3& extent)
+{
+  return min + glm::vec3(in[0], in[1], in[2]) / RANGE_STEPS * extent;
+}
+
+float CompressedClip::KeyTime(const PackedKey& key) const
+{
+  return static_cast<float>(key.time) / RANGE_STEPS * duration_;
+}
+
+void CompressedClip::Compress(const std::vector<Bone>& bones, const FlatSkeleton& skeleton, float duration,
+  const Settings& settings)
+{
+  Clear();
+  duration_ = duration;
+  for (auto& bone : bones)
+    duration_ = std::max(duration_, bone.getTimes().back());
+
+  // reach of every bone's subtree
+  std::vector<float> reach(bones.size(), 0.f);
+  for (size_t i = 0; i < skeleton.bone.size(); ++i)
+  {
+    if (skeleton.bone[i] >= 0)
+      reach[skeleton.bone[i]] = skeleton.reach[i];
+  }
+
+  std::vector<PackedKey> packed;
+  std::vector<float> times;
+  std::vector<glm::vec3> positions;
+  std::vector<Quaternion> rotations;
+  std::vector<glm::vec3> scales;
+
+  tracks_.resize(bones.size());
+  for (size_t b = 0; b < bones.size(); ++b)
+  {
+    const Bone& bone = bones[b];
+    const auto& P = bone.getPositions();
+    const auto& R = bone.getRotations();
+    const auto& S = bone.getScales();
+    int count = static_cast<int>(bone.getTimes().size());
+
+    // a rotation (or relative scale) error e moves the subtree tip by about e * reach
+    float error = settings.positionError;
+    auto over = settings.boneError.find(bone.getBoneName());
+    if (over != settings.boneError.end())
+      error = over->second;
+    float angleError = reach[b] > 0.f ? std::min(settings.maxAngleError, error / reach[b]) : settings.maxAngleError;
+
+    Track& track = tracks_[b];
+    track.translationMin = track.scaleMin = glm::vec3(FLT_MAX);
+    glm::vec3 translationMax(-FLT_MAX), scaleMax(-FLT_MAX);
+    for (int k = 0; k < count; ++k)
+    {
+      track.translationMin = glm::min(track.translationMin, P[k]);
+      translationMax = glm::max(translationMax, P[k]);
+      track.scaleMin = glm::min(track.scaleMin, S[k]);
+      scaleMax = glm::max(scaleMax, S[k]);
+    }
+    track.translationExtent = translationMax - track.translationMin;
+    track.scaleExtent = scaleMax - track.scaleMin;
+
+    // quantize every key first, reduction measures against what the sampler will decode
+    packed.resize(count);
+    times.resize(count);
+    positions.resize(count);
+    rotations.resize(count);
+    scales.resize(count);
+    for (int k = 0; k < count; ++k)
+    {
+      PackedKey& key = packed[k];
+      float t = duration_ > 0.f ? bone.getTimes()[k] / duration_ : 0.f;
+      key.time = static_cast<uint16_t>(glm::clamp(t, 0.f, 1.f) * RANGE_STEPS + 0.5f);
+      EncodeRotation(R[k], key.rotation);
+      EncodeRange(P[k], track.translationMin, track.translationExtent, key.translation);
+      EncodeRange(S[k], track.scaleMin, track.scaleExtent, key.scale);
+
+      times[k] = KeyTime(key);
+      rotations[k] = DecodeRotation(key.rotation);
+      positions[k] = DecodeRange(key.translation, track.translationMin, track.translationExtent);
+      scales[k] = DecodeRange(key.scale, track.scaleMin, track.scaleExtent);
+    }
+
+    // every dropped key between a and b has to be reproduced by interpolating a and b
+    auto fits = [&](int a, int b)
+    {
+      for (int j = a + 1; j < b; ++j)
+      {
+        float f = times[b] > times[a] ? (times[j] - times[a]) / (times[b] - times[a]) : 0.f;
+        if (glm::length(Interpolation::lerp(positions[a], positions[b], f) - P[j]) > error)
+          return false;
+        if (AngleBetween(Interpolation::Slerp(rotations[a], rotations[b], f).normalize(), R[j]) > angleError)
+          return false;
+        if (ScaleError(Interpolation::Elerp(scales[a], scales[b], f), S[j]) > angleError)
+          return false;
+      }
+      return true;
+    };
+
+    track.firstKey = static_cast<uint32_t>(keys_.size());
+    keys_.push_back(packed[0]);
+    int anchor = 0;
+    for (int k = 2; k < count; ++k)
+    {
+      if (!fits(anchor, k))
+      {
+        anchor = k - 1;
+        keys_.push_back(packed[anchor]);
+      }
+    }
+    if (count > 1)
+      keys_.push_back(packed[count - 1]);
+    track.keyCount = static_cast<uint32_t>(keys_.size()) - track.firstKey;
+  }
+
+  keys_.shrink_to_fit();
+}
+
+int CompressedClip::KeyIndex(const Track& track, float animationTime, int& cursor) const
+{
+  const PackedKey* keys = &keys_[track.firstKey];
+  int last = static_cast<int>(track.keyCount) - 2;
+  int k = glm::clamp(cursor, 0, last);
+
+  // forward playback stays in the cached interval or steps into the next one
+  if (animationTime >= KeyTime(keys[k]))
+  {
+    if (k == last || animationTime < KeyTime(keys[k + 1]))
+      return cursor = k;
+    if (k + 1 == last || animationTime < KeyTime(keys[k + 2]))
+      return cursor = k + 1;
+  }
+
+  const PackedKey* it = std::upper_bound(keys, keys + track.keyCount, animationTime,
+    [this](float time, const PackedKey& key) { return time < KeyTime(key); });
+  cursor = glm::clamp(static_cast<int>(it - keys) - 1, 0, last);
+  return cursor;
+}
+
+VQS CompressedClip::Sample(int track, float animationTime, int& cursor, RotationInterpolation mode) const
+{
+  const Track& tr = tracks_[track];
+  const PackedKey* keys = &keys_[tr.firstKey];
+
+  if (1 == tr.keyCount)
+  {
+    return VQS(DecodeRange(keys[0].translation, tr.translationMin, tr.translationExtent),
+      DecodeRotation(keys[0].rotation),
+      DecodeRange(keys[0].scale, tr.scaleMin, tr.scaleExtent));
+  }
+
+  int k = KeyIndex(tr, animationTime, cursor);
+  const PackedKey& k0 = keys[k];
+  const PackedKey& k1 = keys[k + 1];
+  float t0 = KeyTime(k0);
+  float t1 = KeyTime(k1);
+  float f = t1 > t0 ? glm::clamp((animationTime - t0) / (t1 - t0), 0.f, 1.f) : 0.f;
+
+  glm::vec3 position = Interpolation::lerp(DecodeRange(k0.translation, tr.translationMin, tr.translationExtent),
+    DecodeRange(k1.translation, tr.translationMin, tr.translationExtent), f);
+  Quaternion rotation = Interpolation::Interpolate(DecodeRotation(k0.rotation), DecodeRotation(k1.rotation), f, mode);
+  glm::vec3 scale = Interpolation::Elerp(DecodeRange(k0.scale, tr.scaleMin, tr.scaleExtent),
+    DecodeRange(k1.scale, tr.scaleMin, tr.scaleExtent), f);
+
+  return VQS(position, rotation, scale);
+}
@@ -0,0 +1,409 @@
+#include "ConvexDecomposition.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+  constexpr uint32_t CACHE_MAGIC = 0x43454443; // "CDEC"
+  constexpr uint32_t CACHE_VERSION = 1;
+  constexpr uint32_t CACHE_MAX_PIECES = 4096; // far above any maxPieces, a larger count is corrupt
+
+  enum VoxelState : unsigned char
+  {
+    VOXEL_UNKNOWN,
+    VOXEL_OUTSIDE,
+    VOXEL_SURFACE,
+    VOXEL_INSIDE,
+  };
+
+  float HullVolume(const ConvexHull& hull)
+  {
+    // sum of signed tetrahedra against the origin
+    float volume = 0.f;
+    for (auto& f : hull.faces_)
+      volume += glm::dot(hull.vertices_[f.x], glm::cross(hull.vertices_[f.y], hull.vertices_[f.z]));
+    return volume / 6.f;
+  }
+}
+
+void ConvexDecomposition::Clear()
+{
+  pieces_.clear();
+}
+
+bool ConvexDecomposition::Empty() const
+{
+  return pieces_.empty();
+}
+
+void ConvexDecomposition::Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+  const Parameters& params)
+{
+  Clear();
+  if (indices.size() < 3)
+    return;
+
+  Voxelize(vertices, indices, params.resolution);
+
+  Part root;
+  for (int z = 0; z < dims_.z; ++z)
+  {
+    for (int y = 0; y < dims_.y; ++y)
+    {
+      for (int x = 0; x < dims_.x; ++x)
+      {
+        if (grid_[(z * dims_.y + y) * dims_.x + x] >= VOXEL_SURFACE)
+          root.voxels_.push_back({ x, y, z });
+      }
+    }
+  }
+  grid_.clear();
+  grid_.shrink_to_fit();
+  if (root.voxels_.empty())
+    return;
+
+  meshVolume_ = static_cast<float>(root.voxels_.size()) * voxelSize_ * voxelSize_ * voxelSize_;
+  root.concavity_ = Concavity(root.voxels_);
+
+  // always split the most concave part next so maxPieces keeps the worst ones apart
+  std::vector<Part> parts;
+  std::vector<Part> done;
+  parts.push_back(std::move(root));
+  while (!parts.empty() && static_cast<int>(parts.size() + done.size()) < params.maxPieces)
+  {
+    auto worst = std::max_element(parts.begin(), parts.end(), [](const Part& a, const Part& b)
+      {
+        return a.concavity_ < b.concavity_;
+      });
+    Part part = std::move(*worst);
+    parts.erase(worst);
+
+    Part left, right;
+    if (part.concavity_ <= params.concavity || part.depth_ >= params.maxDepth || !Split(part, params, left, right))
+    {
+      done.push_back(std::move(part));
+      continue;
+    }
+    parts.push_back(std::move(left));
+    parts.push_back(std::move(right));
+  }
+
+  for (auto& part : done)
+    AddPiece(part.voxels_);
+  for (auto& part : parts)
+    AddPiece(part.voxels_);
+}
+
+// mark voxels touched by triangles, flood the outside from the border, the rest is inside
+void ConvexDecomposition::Voxelize(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+  int resolution)
+{
+  glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+  for (auto index : indices)
+  {
+    min = glm::min(min, vertices[index]);
+    max = glm::max(max, vertices[index]);
+  }
+  glm::vec3 extent = max - min;
+  voxelSize_ = std::max(std::max(extent.x, extent.y), std::max(extent.z, FLT_MIN)) / static_cast<float>(resolution);
+
+  // one voxel of padding on each side keeps the flood fill connected around the mesh
+  origin_ = min - glm::vec3(voxelSize_);
+  dims_ = glm::ivec3(glm::ceil(extent / voxelSize_)) + glm::ivec3(3);
+  grid_.assign(static_cast<size_t>(dims_.x) * dims_.y * dims_.z, VOXEL_UNKNOWN);
+
+  auto cell = [this](const glm::vec3& P)
+  {
+    glm::ivec3 c = glm::ivec3(glm::floor((P - origin_) / voxelSize_));
+    return glm::clamp(c, glm::ivec3(0), dims_ - glm::ivec3(1));
+  };
+
+  // sample every triangle at half voxel spacing
+  for (size_t t = 0; t + 2 < indices.size(); t += 3)
+  {
+    const glm::vec3& A = vertices[indices[t]];
+    const glm::vec3& B = vertices[indices[t + 1]];
+    const glm::vec3& C = vertices[indices[t + 2]];
+    float longest = std::max(glm::length(B - A), std::max(glm::length(C - B), glm::length(A - C)));
+    int steps = std::max(1, static_cast<int>(std::ceil(2.f * longest / voxelSize_)));
+    for (int i = 0; i <= steps; ++i)
+    {
+      for (int j = 0; i + j <= steps; ++j)
+      {
+        float u = static_cast<float>(i) / steps;
+        float v = static_cast<float>(j) / steps;
+        glm::ivec3 c = cell(A + u * (B - A) + v * (C - A));
+        grid_[(c.z * dims_.y + c.y) * dims_.x + c.x] = VOXEL_SURFACE;
+      }
+    }
+  }
+
+  std::vector<glm::ivec3> queue;
+  queue.push_back({ 0, 0, 0 });
+  grid_[0] = VOXEL_OUTSIDE;
+  const glm::ivec3 steps[6] = { { 1,0,0 }, { -1,0,0 }, { 0,1,0 }, { 0,-1,0 }, { 0,0,1 }, { 0,0,-1 } };
+  while (!queue.empty())
+  {
+    glm::ivec3 c = queue.back();
+    queue.pop_back();
+    for (auto& step : steps)
+    {
+      glm::ivec3 n = c + step;
+      if (glm::any(glm::lessThan(n, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(n, dims_)))
+        continue;
+      unsigned char& state = grid_[(n.z * dims_.y + n.y) * dims_.x + n.x];
+      if (state != VOXEL_UNKNOWN)
+        continue;
+      state = VOXEL_OUTSIDE;
+      queue.push_back(n);
+    }
+  }
+
+  for (auto& state : grid_)
+  {
+    if (state == VOXEL_UNKNOWN)
+      state = VOXEL_INSIDE;
+  }
+}
+
+// hull of a voxel set only depends on the first and last voxel of every row,
+// their outer faces give 8 corner points per row
+void ConvexDecomposition::HullPoints(const std::vector<glm::ivec3>& voxels, std::vector<glm::vec3>& points) const
+{
+  points.clear();
+  std::vector<glm::ivec2> rows(static_cast<size_t>(dims_.y) * dims_.z, glm::ivec2(INT_MAX, -1));
+  for (auto& v : voxels)
+  {
+    glm::ivec2& row = rows[v.z * dims_.y + v.y];
+    row.x = std::min(row.x, v.x);
+    row.y = std::max(row.y, v.x);
+  }
+
+  for (int z = 0; z < dims_.z; ++z)
+  {
+    for (int y = 0; y < dims_.y; ++y)
+    {
+      const glm::ivec2& row = rows[z * dims_.y + y];
+      if (row.y < 0)
+        continue;
+      for (int corner = 0; corner < 4; ++corner)
+      {
+        float cy = static_cast<float>(y + (corner & 1));
+        float cz = static_cast<float>(z + (corner >> 1));
+        points.push_back(origin_ + voxelSize_ * glm::vec3(static_cast<float>(row.x), cy, cz));
+        points.push_back(origin_ + voxelSize_ * glm::vec3(static_cast<float>(row.y + 1), cy, cz));
+      }
+    }
+  }
+}
+
+float ConvexDecomposition::Concavity(const std::vector<glm::ivec3>& voxels) const
+{
+  std::vector<glm::vec3> points;
+  HullPoints(voxels, points);
+  ConvexHull hull(points);
+  float volume = static_cast<float>(voxels.size()) * voxelSize_ * voxelSize_ * voxelSize_;
+  return std::max(0.f, HullVolume(hull) - volume) / meshVolume_;
+}
+
+// best axis aligned cut, candidate planes are evaluated in parallel
+bool ConvexDecomposition::Split(const Part& part, const Parameters& params, Part& left, Part& right) const
+{
+  glm::ivec3 min(INT_MAX), max(INT_MIN);
+  for (auto& v : part.voxels_)
+  {
+    min = glm::min(min, v);
+    max = glm::max(max, v);
+  }
+
+  struct Candidate
+  {
+    int axis;
+    int position; // voxels with coordinate < position go left
+    float cost = FLT_MAX;
+  };
+  std::vector<Candidate> candidates;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    int span = max[axis] - min[axis];
+    if (span < 1)
+      continue;
+    int count = std::min(params.planesPerAxis, span);
+    for (int i = 1; i <= count; ++i)
+      candidates.push_back({ axis, min[axis] + (span * i + count / 2) / (count + 1) + 1 });
+  }
+  if (candidates.empty())
+    return false;
+
+  std::for_each(std::execution::par, candidates.begin(), candidates.end(), [&](Candidate& c)
+    {
+      std::vector<glm::ivec3> a, b;
+      for (auto& v : part.voxels_)
+        (v[c.axis] < c.position ? a : b).push_back(v);
+      if (a.empty() || b.empty())
+        return;
+      c.cost = Concavity(a) + Concavity(b);
+    });
+
+  auto best = std::min_element(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+      return a.cost < b.cost;
+    });
+  if (best->cost == FLT_MAX)
+    return false;
+
+  for (auto& v : part.voxels_)
+    (v[best->axis] < best->position ? left : right).voxels_.push_back(v);
+  left.depth_ = right.depth_ = part.depth_ + 1;
+  left.concavity_ = Concavity(left.voxels_);
+  right.concavity_ = Concavity(right.voxels_);
+  return true;
+}
+
+void ConvexDecomposition::AddPiece(const std::vector<glm::ivec3>& voxels)
+{
+  std::vector<glm::vec3> points;
+  HullPoints(voxels, points);
+
+  Piece piece;
+  piece.hull_.Build(points);
+  if (piece.hull_.Empty())
+    return;
+  piece.min_ = glm::vec3(FLT_MAX);
+  piece.max_ = glm::vec3(-FLT_MAX);
+  for (auto& v : piece.hull_.vertices_)
+  {
+    piece.min_ = glm::min(piece.min_, v);
+    piece.max_ = glm::max(piece.max_, v);
+  }
+  pieces_.push_back(std::move(piece));
+}
+
+// fnv-1a over the mesh and the parameters
+uint64_t ConvexDecomposition::Hash(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+  const Parameters& params)
+{
+  uint64_t hash = HASH_SEED;
+  auto add = [&hash](const void* data, size_t size)
+  {
+    hash = HashBytes(data, size, hash);
+  };
+  add(vertices.data(), vertices.size() * sizeof(glm::vec3));
+  add(indices.data(), indices.size() * sizeof(unsigned int));
+  add(&params.resolution, sizeof(params.resolution));
+  add(&params.maxPieces, sizeof(params.maxPieces));
+  add(&params.maxDepth, sizeof(params.maxDepth));
+  add(&params.planesPerAxis, sizeof(params.planesPerAxis));
+  add(&params.concavity, sizeof(params.concavity));
+  return hash;
+}
+
+void ConvexDecomposition::BuildCached(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+  const std::string& cacheDir, const Parameters& params)
+{
+  uint64_t key = Hash(vertices, indices, params);
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.hulls", static_cast<unsigned long long>(key));
+  std::string path = cacheDir + "/" + name;
+
+  if (Load(path, key))
+    return;
+
+  Build(vertices, indices, params);
+
+  std::error_code error;
+  std::filesystem::create_directories(cacheDir, error);
+  if (!Save(path, key))
+    std::cout << "ConvexDecomposition: failed to write " << path << std::endl;
+}
+
+// magic, version, key, piece count, then vertex count and vertices of every hull
+bool ConvexDecomposition::Save(const std::string& path, uint64_t key) const
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  uint32_t header[2] = { CACHE_MAGIC, CACHE_VERSION };
+  uint32_t count = static_cast<uint32_t>(pieces_.size());
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+  file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (auto& piece : pieces_)
+  {
+    uint32_t vertexCount = static_cast<uint32_t>(piece.hull_.vertices_.size());
+    file.write(reinterpret_cast<const char*>(&vertexCount), sizeof(vertexCount));
+    file.write(reinterpret_cast<const char*>(piece.hull_.vertices_.data()), vertexCount * sizeof(glm::vec3));
+  }
+  return static_cast<bool>(file);
+}
+
+bool ConvexDecomposition::Load(const std::string& path, uint64_t key)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  uint32_t header[2] = {};
+  uint64_t fileKey = 0;
+  uint32_t count = 0;
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  file.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey));
+  file.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if (!file || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || fileKey != key)
+    return false;
+
+  // counts are checked against the bytes left before anything is allocated
+  std::error_code error;
+  uint64_t size = std::filesystem::file_size(path, error);
+  if (error)
+    return false;
+  auto remaining = [&]() -> uint64_t
+  {
+    uint64_t offset = static_cast<uint64_t>(file.tellg());
+    return offset < size ? size - offset : 0;
+  };
+  if (count > CACHE_MAX_PIECES || count > remaining() / sizeof(uint32_t))
+    return false;
+
+  Clear();
+  std::vector<glm::vec3> points;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint32_t vertexCount = 0;
+    file.read(reinterpret_cast<char*>(&vertexCount), sizeof(vertexCount));
+    if (!file || vertexCount > remaining() / sizeof(glm::vec3))
+    {
+      Clear();
+      return false;
+    }
+    points.resize(vertexCount);
+    file.read(reinterpret_cast<char*>(points.data()), vertexCount * sizeof(glm::vec3));
+    if (!file)
+    {
+      Clear();
+      return false;
+    }
+
+    // cached points are hull vertices already, rebuilding only restores faces and adjacency
+    Piece piece;
+    piece.hull_.Build(points);
+    piece.min_ = glm::vec3(FLT_MAX);
+    piece.max_ = glm::vec3(-FLT_MAX);
+    for (auto& v : points)
+    {
+      piece.min_ = glm::min(piece.min_, v);
+      piece.max_ = glm::max(piece.max_, v);
+    }
+    pieces_.push_back(std::move(piece));
+  }
+  return true;
+}
@@ -0,0 +1,413 @@
+#include "ConvexHull.h"
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+
+ConvexHull::ConvexHull(const std::vector<glm::vec3>& points)
+{
+  Build(points);
+}
+
+ConvexHull::ConvexHull(const std::vector<glm::vec4>& points)
+{
+  std::vector<glm::vec3> P(points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    P[i] = glm::vec3(points[i]);
+  Build(P);
+}
+
+void ConvexHull::Clear()
+{
+  vertices_.clear();
+  faces_.clear();
+  adjacencyOffset_.clear();
+  adjacency_.clear();
+}
+
+bool ConvexHull::Empty() const
+{
+  return vertices_.empty();
+}
+
+int ConvexHull::AddFace(std::vector<Face>& faces, const std::vector<glm::vec3>& points, int a, int b, int c)
+{
+  Face f;
+  f.v[0] = a;
+  f.v[1] = b;
+  f.v[2] = c;
+  f.adj[0] = f.adj[1] = f.adj[2] = -1;
+  f.n = glm::cross(points[b] - points[a], points[c] - points[a]);
+  float len = glm::length(f.n);
+  f.n = len > 0.f ? f.n / len : glm::vec3(0.f);
+  f.d = glm::dot(f.n, points[a]);
+  faces.push_back(std::move(f));
+  return static_cast<int>(faces.size()) - 1;
+}
+
+// depth first walk over visible faces, horizon edges come out in ccw order
+// (a, b, neighbor face) as seen from the eye point
+void ConvexHull::ComputeHorizon(std::vector<Face>& faces, const glm::vec3& eye, int face, int enterEdge,
+  std::vector<int>& visible, std::vector<glm::ivec3>& horizon, float eps)
+{
+  faces[face].visited = true;
+  visible.push_back(face);
+
+  // first face checks all 3 edges, others skip the edge they were entered from
+  int edgeCount = enterEdge < 0 ? 3 : 2;
+  int start = enterEdge < 0 ? 0 : enterEdge + 1;
+  for (int i = 0; i < edgeCount; ++i)
+  {
+    int e = (start + i) % 3;
+    int nb = faces[face].adj[e];
+    if (faces[nb].visited)
+      continue;
+
+    if (glm::dot(faces[nb].n, eye) - faces[nb].d > eps)
+    {
+      // find the shared edge inside the neighbor
+      int back = 0;
+      for (int j = 0; j < 3; ++j)
+      {
+        if (faces[nb].adj[j] == face)
+          back = j;
+      }
+      ComputeHorizon(faces, eye, nb, back, visible, horizon, eps);
+    }
+    else
+    {
+      horizon.push_back({ faces[face].v[e], faces[face].v[(e + 1) % 3], nb });
+    }
+  }
+}
+
+void ConvexHull::Build(const std::vector<glm::vec3>& points)
+{
+  Clear();
+  if (points.size() < 4)
+  {
+    BuildFallback(points);
+    return;
+  }
+
+  // tolerance relative to the extent of the input
+  glm::vec3 maxAbs(0.f);
+  for (auto& p : points)
+    maxAbs = glm::max(maxAbs, glm::abs(p));
+  float eps = 3.f * FLT_EPSILON * (maxAbs.x + maxAbs.y + maxAbs.z);
+
+  // initial simplex from extreme points
+  int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+  for (int i = 0; i < static_cast<int>(points.size()); ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      if (points[i][c] < points[extremes[2 * c]][c]) extremes[2 * c] = i;
+      if (points[i][c] > points[extremes[2 * c + 1]][c]) extremes[2 * c + 1] = i;
+    }
+  }
+
+  int i0 = 0, i1 = 0;
+  float best = -1.f;
+  for (int a = 0; a < 6; ++a)
+  {
+    for (int b = a + 1; b < 6; ++b)
+    {
+      float d = glm::length(points[extremes[a]] - points[extremes[b]]);
+      if (d > best)
+      {
+        best = d;
+        i0 = extremes[a];
+        i1 = extremes[b];
+      }
+    }
+  }
+  if (best <= eps)
+  {
+    BuildFallback(points);
+    return;
+  }
+
+  // furthest from line i0-i1
+  int i2 = -1;
+  best = eps;
+  glm::vec3 lineDir = glm::normalize(points[i1] - points[i0]);
+  for (int i = 0; i < static_cast<int>(points.size()); ++i)
+  {
+    glm::vec3 v = points[i] - points[i0];
+    float d = glm::length(v - lineDir * glm::dot(v, lineDir));
+    if (d > best)
+    {
+      best = d;
+      i2 = i;
+    }
+  }
+  if (i2 < 0)
+  {
+    BuildFallback(points);
+    return;
+  }
+
+  // furthest from plane i0-i1-i2
+  int i3 = -1;
+  best = eps;
+  glm::vec3 planeN = glm::normalize(glm::cross(points[i1] - points[i0], points[i2] - points[i0]));
+  for (int i = 0; i < static_cast<int>(points.size()); ++i)
+  {
+    float d = std::abs(glm::dot(points[i] - points[i0], planeN));
+    if (d > best)
+    {
+      best = d;
+      i3 = i;
+    }
+  }
+  if (i3 < 0)
+  {
+    BuildFallback(points);
+    return;
+  }
+
+  // orient base triangle away from the 4th point
+  if (glm::dot(points[i3] - points[i0], planeN) > 0.f)
+    std::swap(i1, i2);
+
+  std::vector<Face> faces;
+  faces.reserve(64);
+  AddFace(faces, points, i0, i1, i2);
+  AddFace(faces, points, i0, i3, i1);
+  AddFace(faces, points, i1, i3, i2);
+  AddFace(faces, points, i2, i3, i0);
+
+  // link adjacency of the tetrahedron by matching reversed edges
+  for (int f = 0; f < 4; ++f)
+  {
+    for (int e = 0; e < 3; ++e)
+    {
+      int a = faces[f].v[e];
+      int b = faces[f].v[(e + 1) % 3];
+      for (int g = 0; g < 4; ++g)
+      {
+        if (g == f)
+          continue;
+        for (int k = 0; k < 3; ++k)
+        {
+          if (faces[g].v[k] == b && faces[g].v[(k + 1) % 3] == a)
+            faces[f].adj[e] = g;
+        }
+      }
+    }
+  }
+
+  // assign remaining points to the face they are furthest above
+  std::vector<int> pending;
+  for (int i = 0; i < static_cast<int>(points.size()); ++i)
+  {
+    if (i == i0 || i == i1 || i == i2 || i == i3)
+      continue;
+    int bestFace = -1;
+    float bestDist = eps;
+    for (int f = 0; f < 4; ++f)
+    {
+      float d = glm::dot(faces[f].n, points[i]) - faces[f].d;
+      if (d > bestDist)
+      {
+        bestDist = d;
+        bestFace = f;
+      }
+    }
+    if (bestFace >= 0)
+      faces[bestFace].outside.push_back(i);
+  }
+  for (int f = 0; f < 4; ++f)
+  {
+    if (!faces[f].outside.empty())
+      pending.push_back(f);
+  }
+
+  std::vector<int> visible;
+  std::vector<glm::ivec3> horizon;
+  std::vector<int> newFaces;
+  std::vector<int> orphans;
+
+  while (!pending.empty())
+  {
+    int f = pending.back();
+    pending.pop_back();
+    if (!faces[f].alive || faces[f].outside.empty())
+      continue;
+
+    // eye point is the furthest outside point
+    int eyeIndex = faces[f].outside[0];
+    float eyeDist = -FLT_MAX;
+    for (int p : faces[f].outside)
+    {
+      float d = glm::dot(faces[f].n, points[p]) - faces[f].d;
+      if (d > eyeDist)
+      {
+        eyeDist = d;
+        eyeIndex = p;
+      }
+    }
+    const glm::vec3& eye = points[eyeIndex];
+
+    visible.clear();
+    horizon.clear();
+    ComputeHorizon(faces, eye, f, -1, visible, horizon, eps);
+
+    // gather points of removed faces
+    orphans.clear();
+    for (int v : visible)
+    {
+      faces[v].alive = false;
+      for (int p : faces[v].outside)
+      {
+        if (p != eyeIndex)
+          orphans.push_back(p);
+      }
+      faces[v].outside.clear();
+      faces[v].outside.shrink_to_fit();
+    }
+
+    // cone of new faces from the horizon to the eye point
+    newFaces.clear();
+    for (auto& edge : horizon)
+    {
+      int nf = AddFace(faces, points, edge.x, edge.y, eyeIndex);
+      newFaces.push_back(nf);
+      faces[nf].adj[0] = edge.z;
+      for (int j = 0; j < 3; ++j)
+      {
+        if (faces[edge.z].v[j] == edge.y && faces[edge.z].v[(j + 1) % 3] == edge.x)
+          faces[edge.z].adj[j] = nf;
+      }
+    }
+    int count = static_cast<int>(newFaces.size());
+    for (int i = 0; i < count; ++i)
+    {
+      faces[newFaces[i]].adj[1] = newFaces[(i + 1) % count];
+      faces[newFaces[i]].adj[2] = newFaces[(i + count - 1) % count];
+    }
+
+    // reassign orphans, points inside the new hull are dropped
+    for (int p : orphans)
+    {
+      int bestFace = -1;
+      float bestDist = eps;
+      for (int nf : newFaces)
+      {
+        float d = glm::dot(faces[nf].n, points[p]) - faces[nf].d;
+        if (d > bestDist)
+        {
+          bestDist = d;
+          bestFace = nf;
+        }
+      }
+      if (bestFace >= 0)
+        faces[bestFace].outside.push_back(p);
+    }
+    for (int nf : newFaces)
+    {
+      if (!faces[nf].outside.empty())
+        pending.push_back(nf);
+    }
+  }
+
+  BuildFromFaces(faces, points);
+}
+
+// compact hull vertices and build vertex adjacency from face edges
+void ConvexHull::BuildFromFaces(const std::vector<Face>& faces, const std::vector<glm::vec3>& points)
+{
+  std::unordered_map<int, int> remap;
+  for (auto& f : faces)
+  {
+    if (!f.alive)
+      continue;
+    glm::ivec3 tri;
+    for (int c = 0; c < 3; ++c)
+    {
+      auto it = remap.find(f.v[c]);
+      if (it == remap.end())
+      {
+        it = remap.emplace(f.v[c], static_cast<int>(vertices_.size())).first;
+        vertices_.push_back(points[f.v[c]]);
+      }
+      tri[c] = it->second;
+    }
+    faces_.push_back(tri);
+  }
+
+  // every edge appears once per direction, keep the outgoing one
+  std::vector<std::vector<int>> neighbors(vertices_.size());
+  for (auto& tri : faces_)
+  {
+    for (int c = 0; c < 3; ++c)
+      neighbors[tri[c]].push_back(tri[(c + 1) % 3]);
+  }
+
+  adjacencyOffset_.resize(vertices_.size() + 1);
+  adjacencyOffset_[0] = 0;
+  for (size_t i = 0; i < neighbors.size(); ++i)
+  {
+    adjacency_.insert(adjacency_.end(), neighbors[i].begin(), neighbors[i].end());
+    adjacencyOffset_[i + 1] = static_cast<int>(adjacency_.size());
+  }
+}
+
+// degenerate input (flat, line, point), support falls back to a linear scan
+void ConvexHull::BuildFallback(const std::vector<glm::vec3>& points)
+{
+  vertices_ = points;
+}
+
+int ConvexHull::SupportIndex(const glm::vec3& dir, int& hint) const
+{
+  if (vertices_.empty())
+    return -1;
+
+  if (adjacency_.empty())
+  {
+    int best = 0;
+    float bestDot = glm::dot(vertices_[0], dir);
+    for (int i = 1; i < static_cast<int>(vertices_.size()); ++i)
+    {
+      float d = glm::dot(vertices_[i], dir);
+      if (d > bestDot)
+      {
+        bestDot = d;
+        best = i;
+      }
+    }
+    hint = best;
+    return best;
+  }
+
+  int current = (hint >= 0 && hint < static_cast<int>(vertices_.size())) ? hint : 0;
+  float currentDot = glm::dot(vertices_[current], dir);
+
+  // hill climb, on a convex hull the local maximum is the global one
+  bool improved = true;
+  while (improved)
+  {
+    improved = false;
+    for (int i = adjacencyOffset_[current]; i < adjacencyOffset_[current + 1]; ++i)
+    {
+      int n = adjacency_[i];
+      float d = glm::dot(vertices_[n], dir);
+      if (d > currentDot)
+      {
+        currentDot = d;
+        current = n;
+        improved = true;
+        break;
+      }
+    }
+  }
+  hint = current;
+  return current;
+}
+
+glm::vec3 ConvexHull::Support(const glm::vec3& dir, int& hint) const
+{
+  int index = SupportIndex(dir, hint);
+  return index < 0 ? glm::vec3(0.f) : vertices_[index];
+}
@@ -0,0 +1,102 @@
+#include "DualQuaternion.h"
+
+namespace
+{
+  // hamilton product on x, y, z, w vectors
+  glm::vec4 Multiply(const glm::vec4& a, const glm::vec4& b)
+  {
+    glm::vec3 av(a), bv(b);
+    glm::vec3 v = a.w * bv + b.w * av + glm::cross(av, bv);
+    return glm::vec4(v, a.w * b.w - glm::dot(av, bv));
+  }
+
+  glm::vec4 ToVec4(const Quaternion& q)
+  {
+    return glm::vec4(q._v, q._s);
+  }
+}
+
+DualQuaternion::DualQuaternion(Quaternion rotation, glm::vec3 translation)
+  : real(ToVec4(rotation)), dual(Multiply(glm::vec4(translation, 0.f), ToVec4(rotation)) * 0.5f)
+{
+}
+
+DualQuaternion::DualQuaternion(const VQS& vqs) : DualQuaternion(vqs.getRotation(), vqs.getTranslation())
+{
+}
+
+DualQuaternion DualQuaternion::FromMatrix(const glm::mat4& m)
+{
+  glm::mat3 basis(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])), glm::normalize(glm::vec3(m[2])));
+  return DualQuaternion(Utility::ConvertMatrixToQuaternion(basis).normalize(), glm::vec3(m[3]));
+}
+
+DualQuaternion DualQuaternion::operator*(const DualQuaternion& rhs) const
+{
+  DualQuaternion result;
+  result.real = Multiply(real, rhs.real);
+  result.dual = Multiply(real, rhs.dual) + Multiply(dual, rhs.real);
+  return result;
+}
+
+DualQuaternion DualQuaternion::operator*(float s) const
+{
+  DualQuaternion result;
+  result.real = real * s;
+  result.dual = dual * s;
+  return result;
+}
+
+DualQuaternion DualQuaternion::operator+(const DualQuaternion& rhs) const
+{
+  DualQuaternion result;
+  result.real = real + rhs.real;
+  result.dual = dual + rhs.dual;
+  return result;
+}
+
+DualQuaternion DualQuaternion::normalize() const
+{
+  float length = glm::length(real);
+  if (length <= 0.f)
+    return DualQuaternion();
+
+  // scale both parts, then remove the dual component along the real one
+  DualQuaternion result;
+  result.real = real / length;
+  result.dual = dual / length;
+  result.dual -= result.real * glm::dot(result.real, result.dual);
+  return result;
+}
+
+glm::vec3 DualQuaternion::transformPoint(const glm::vec3& p) const
+{
+  glm::vec3 r(real), d(dual);
+  glm::vec3 translation = 2.f * (real.w * d - dual.w * r + glm::cross(r, d));
+  return transformVector(p) + translation;
+}
+
+glm::vec3 DualQuaternion::transformVector(const glm::vec3& v) const
+{
+  glm::vec3 r(real);
+  return v + 2.f * glm::cross(r, glm::cross(r, v) + real.w * v);
+}
+
+Quaternion DualQuaternion::getRotation() const
+{
+  return Quaternion(real.w, glm::vec3(real));
+}
+
+glm::vec3 DualQuaternion::getTranslation() const
+{
+  // t = 2 * dual * conjugate(real)
+  glm::vec4 conjugate(-glm::vec3(real), real.w);
+  return glm::vec3(Multiply(dual, conjugate)) * 2.f;
+}
+
+glm::mat4 DualQuaternion::toMat4() const
+{
+  glm::mat4 m = getRotation().toMat4();
+  m[3] = glm::vec4(getTranslation(), 1.f);
+  return m;
+}
@@ -2,361 +2,997 @@
 #include "Octree.h"
 #include "Engine.h"
 #include "Shader.h"
+#include "ClosestPoint.h"
+#include "MeshBVH.h"
+#include "ConvexDecomposition.h"
+#include <algorithm>
+#include <execution>
 
 static const glm::vec3 ORIGIN = { 0.f,0.f,0.f };
+constexpr int GJK_MAX_ITERATIONS = 64;
+constexpr int STACK_SIZE = 256;
+constexpr float DISTANCE_TOLERANCE = 0.000001f; // relative, squared distance
 
-bool GJK::DetectCollision_BroadPhase(Object* S, Octree::TreeNode* node)
+constexpr int SWEEP_MAX_STEPS = 64;
+constexpr int SWEEP_REFINE_STEPS = 8;
+
+// leaf box in model space, the piece and triangle tests only look inside it
+static void leafRegion(const Octree::TreeNode* node, const glm::mat4& worldToModel, glm::vec3& regionMin, glm::vec3& regionMax)
 {
-  // aabb-aabb intersection
-  if (!S->bv->intersect(node->bv_))
-    return false;
+  glm::vec3 corner = glm::vec3(worldToModel * glm::vec4(node->bv_->min_, 1.f));
+  regionMin = corner;
+  regionMax = corner;
+  for (int i = 1; i < 8; ++i)
+  {
+    glm::vec3 P((i & 1) ? node->bv_->max_.x : node->bv_->min_.x,
+      (i & 2) ? node->bv_->max_.y : node->bv_->min_.y,
+      (i & 4) ? node->bv_->max_.z : node->bv_->min_.z);
+    corner = glm::vec3(worldToModel * glm::vec4(P, 1.f));
+    regionMin = glm::min(regionMin, corner);
+    regionMax = glm::max(regionMax, corner);
+  }
+}
 
-  // intersection check with internal nodes
-  for (int i = 0; i < MAX_CHILDREN; ++i)
+// first time in [t, limit] at which the object's triangles touch the model's inside the leaf,
+// marched in steps of half the object's smallest extent so thin walls are not stepped over
+static bool sweepTriangles(const GJK::CollisionPair& pair, const glm::mat4& worldToModel, const glm::vec3& motion,
+  float limit, float& t)
+{
+  auto touching = [&](float time)
+    {
+      glm::mat4 objectToModel = worldToModel * glm::translate(glm::mat4(1.f), time * motion) * pair.object->modelTr;
+      return pair.modelMesh->Intersect(*pair.objectMesh, objectToModel, pair.regionMin, pair.regionMax);
+    };
+  if (touching(t))
+    return true;
+
+  glm::vec3 extent = pair.object->bv->max_ - pair.object->bv->min_;
+  float length = glm::length(motion);
+  float step = length > EPSILON ? 0.5f * std::min(extent.x, std::min(extent.y, extent.z)) / length : 1.f;
+  step = std::max(step, (limit - t) / SWEEP_MAX_STEPS);
+
+  float miss = t;
+  while (miss < limit)
   {
-    // validate children
-    if (node->children_[i])
+    float time = std::min(miss + step, limit);
+    if (touching(time))
     {
-      if (DetectCollision_MidPhase(S, node->children_[i]))
+      // contact lies between the last miss and this step
+      for (int i = 0; i < SWEEP_REFINE_STEPS; ++i)
       {
-        return true;
+        float middle = 0.5f * (miss + time);
+        if (touching(middle))
+          time = middle;
+        else
+          miss = middle;
       }
+      t = time;
+      return true;
     }
+    miss = time;
   }
-
-  // no intersection at all
   return false;
 }
 
-bool GJK::DetectCollision_MidPhase(Object* S, Octree::TreeNode* node)
+bool GJK::DetectCollision_BroadPhase(const std::vector<Object*>& objects, Octree::TreeNode* node)
 {
-  if (node->type_ == Octree::TreeNodeType::TNT_LEAF_NODE)
+  auto* om = Engine::managers_.GetManager<ObjectManager*>();
+  auto& pairs = om->gjkController.pairs;
+
+  // gather every overlapping leaf of every object with a bounding volume first, no early out
+  pairs.clear();
+  for (Object* S : objects)
   {
-    if (DetectCollision_NarrowPhase(S, node))
+    if (S && S->bv && S->shape)
+      CollectPairs(S, node, pairs);
+  }
+  if (pairs.empty())
+    return false;
+
+  // map lookups and lazy hull builds stay on this thread, workers only touch their own pair
+  for (auto& pair : pairs)
+  {
+    Object* objectBV = pair.object->bv->bv_object;
+    Object* modelBV = pair.node->bv_->bv_object;
+    pair.cache = &om->gjkController.simplexCache[{ pair.object, pair.node }];
+    pair.objectCollider = Collider(objectBV->shape->GetHull(), objectBV->GetPosition(), objectBV->GetOrientation(), objectBV->GetScale());
+    pair.modelCollider = Collider(modelBV->shape->GetHull(), modelBV->GetPosition(), modelBV->GetOrientation(), modelBV->GetScale());
+
+    if (om->GetModels().empty())
+      continue;
+    Object* model = om->GetModels()[0];
+
+    // leaf region in model space for the piece and triangle tests
+    bool usePieces = om->gjkController.convexPieces && om->gjkController.decomposition &&
+      !om->gjkController.decomposition->Empty();
+    bool useTriangles = om->gjkController.exact && om->closestPointController.bvh;
+    if (usePieces || useTriangles)
     {
-      // render polygons of tree node & sphere in RED color
-      auto* om = Engine::managers_.GetManager<ObjectManager*>();
-      om->AddBoundingVolumeGJK(node->bv_);
-      return true;
+      glm::mat4 worldToModel = glm::inverse(model->modelTr);
+      pair.objectToModel = worldToModel * pair.object->modelTr;
+      leafRegion(pair.node, worldToModel, pair.regionMin, pair.regionMax);
+    }
+    if (usePieces)
+    {
+      pair.pieces = om->gjkController.decomposition;
+      pair.shapeCollider = Collider(pair.object->shape->GetHull(), pair.object->GetPosition(), pair.object->GetOrientation(), pair.object->GetScale());
+      pair.pieceCollider = Collider(nullptr, model->GetPosition(), model->GetOrientation(), model->GetScale());
+    }
+    if (useTriangles)
+    {
+      pair.objectMesh = pair.object->shape->GetBVH();
+      pair.modelMesh = om->closestPointController.bvh;
     }
-    return false;
   }
 
-  // aabb-aabb intersection
-  if (!S->bv->intersect(node->bv_))
-    return false;
+  int hits = DetectCollision_NarrowPhase(pairs);
 
-  // recursively through children node
-  for (int i = 0; i < MAX_CHILDREN; ++i)
+  // results are merged in pair order so the output does not depend on scheduling
+  for (auto& pair : pairs)
   {
-    // validate children
-    if (node->children_[i])
+    if (!pair.result.hit)
+      continue;
+
+    Object* objectBV = pair.object->bv->bv_object;
+    Object* modelBV = pair.node->bv_->bv_object;
+    auto& cached = om->gjkController.manifolds[{ pair.object, pair.node }];
+    cached.objectA = objectBV;
+    cached.objectB = modelBV;
+    cached.manifold.Add(pair.result.contact, objectBV->modelTr, modelBV->modelTr);
+
+    // render polygons of tree node & sphere in RED color
+    om->AddBoundingVolumeGJK(pair.node->bv_);
+
+    // deepest contact and its simplex for display
+    if (pair.result.contact.depth >= om->gjkController.contact.depth)
     {
-      if (DetectCollision_MidPhase(S, node->children_[i]))
-        return true;
+      om->gjkController.contact = pair.result.contact;
+      om->gjkController.simplex->vertices_.clear();
+      om->gjkController.simplex->indices_.clear();
+      for (int i = pair.result.count - 1; i >= 0; --i)
+        om->gjkController.simplex->Add(pair.result.simplex[i].p);
     }
   }
-
-  // no intersection at all
-  return false;
+  return hits > 0;
 }
 
-// perform GJK algorithm
-bool GJK::DetectCollision_NarrowPhase(Object* S, Octree::TreeNode* node)
+void GJK::CollectPairs(Object* S, Octree::TreeNode* root, std::vector<CollisionPair>& pairs)
 {
-  // hit the leaf node
-  if (S->bv->intersect(node->bv_))
+  if (!root)
+    return;
+
+  // explicit stack, grows past the usual depth instead of dropping subtrees
+  std::vector<Octree::TreeNode*> stack;
+  stack.reserve(STACK_SIZE);
+  stack.push_back(root);
+
+  while (!stack.empty())
   {
-    std::vector<glm::vec4> S_Pnt;
-    S_Pnt.resize(S->bv->bv_object->shape->Pnt.size());
-    std::vector<glm::vec4> node_Pnt;
-    node_Pnt.resize(node->bv_->bv_object->shape->Pnt.size());
+    Octree::TreeNode* node = stack.back();
+    stack.pop_back();
+
+    // aabb-aabb intersection
+    if (!S->bv->intersect(node->bv_))
+      continue;
 
-    // transform vertices to world space coordinates
-    for (int i = 0; i < S->bv->bv_object->shape->Pnt.size(); ++i)
+    if (node->type_ == Octree::TreeNodeType::TNT_LEAF_NODE)
     {
-      S_Pnt[i] = S->bv->bv_object->modelTr * S->bv->bv_object->shape->Pnt[i];
+      CollisionPair pair;
+      pair.object = S;
+      pair.node = node;
+      pairs.push_back(pair);
+      continue;
     }
-    for (int i = 0; i < node->bv_->bv_object->shape->Pnt.size(); ++i)
+
+    for (int i = 0; i < MAX_CHILDREN; ++i)
     {
-      node_Pnt[i] = node->bv_->bv_object->modelTr * node->bv_->bv_object->shape->Pnt[i];
+      // validate children
+      if (node->children_[i])
+        stack.push_back(node->children_[i]);
     }
-
-
-    // perform GJK algorithm
-    return Run(
-      S_Pnt,
-      S->bv->bv_object->shape->Tri,
-      S->bv->center_,
-      node_Pnt,
-      node->bv_->bv_object->shape->Tri,
-      node->bv_->center_
-    );
   }
-    
-  return false;
 }
 
-// closet point to X is P
-glm::vec3 GJK::ClosestPointOnPoint(const glm::vec3& X, const glm::vec3& P)
+// perform GJK algorithm on every pair, each pair owns its colliders, cache and result
+int GJK::DetectCollision_NarrowPhase(std::vector<CollisionPair>& pairs)
 {
-  return P;
-}
+  std::for_each(std::execution::par, pairs.begin(), pairs.end(), [](CollisionPair& pair)
+    {
+      Run(pair.objectCollider, pair.modelCollider, pair.result, pair.cache);
 
-glm::vec3 GJK::ClosestPointOnLineSegment(const glm::vec3& X, const glm::vec3& P0, const glm::vec3& P1)
-{
-  if (glm::dot(X - P0, P1 - P0) <= 0)
-    return ClosestPointOnPoint(X, P0); //return P0
+      // leaf box hit, the deepest convex piece inside the leaf gives the real contact
+      if (pair.result.hit && pair.pieces)
+      {
+        pair.result.hit = false;
+        Result pieceResult;
+        for (auto& piece : pair.pieces->pieces_)
+        {
+          if (glm::any(glm::lessThan(piece.max_, pair.regionMin)) || glm::any(glm::greaterThan(piece.min_, pair.regionMax)))
+            continue;
+          pair.pieceCollider.hull_ = &piece.hull_;
+          pair.pieceCollider.hint_ = 0;
+          if (Run(pair.shapeCollider, pair.pieceCollider, pieceResult) &&
+            (!pair.result.hit || pieceResult.contact.depth > pair.result.contact.depth))
+            pair.result = pieceResult;
+        }
+      }
 
-  if (glm::dot(X - P1, P0 - P1) <= 0)
-    return ClosestPointOnPoint(X, P1); //return P1;
+      // boxes overlap, confirm with the actual triangles inside the leaf
+      if (pair.result.hit && pair.objectMesh && pair.modelMesh)
+        pair.result.hit = pair.modelMesh->Intersect(*pair.objectMesh, pair.objectToModel, pair.regionMin, pair.regionMax);
+    });
 
-  glm::vec3 a = P1 - P0;
-  glm::vec3 b = X - P0;
-  float L = glm::length(a);
-  float dotProduct = glm::dot(a, b) / (L*L);
+  int hits = 0;
+  for (auto& pair : pairs)
+  {
+    if (pair.result.hit)
+      ++hits;
+  }
+  return hits;
+}
 
-  return P0 + a * dotProduct;
+// entry time of box [min, max] moving by motion into another box, slab test on the
+// minkowski sum so the moving box shrinks to its center point
+static bool sweptBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& motion,
+  const BoundingVolume* other, float& enter)
+{
+  glm::vec3 halfSize = 0.5f * (max - min);
+  glm::vec3 otherMin = other->min_ - halfSize;
+  glm::vec3 otherMax = other->max_ + halfSize;
+  Ray ray(0.5f * (min + max), motion);
+
+  Interval interval(0.f, glm::vec3(0.f), 1.f, glm::vec3(0.f));
+  const glm::vec3 axes[3] = { { 1.f,0.f,0.f }, { 0.f,1.f,0.f }, { 0.f,0.f,1.f } };
+  for (int i = 0; i < 3; ++i)
+  {
+    interval.intersect(Interval().intersect(ray, Slab(axes[i], -otherMin[i], -otherMax[i])));
+    if (interval.isEmpty())
+      return false;
+  }
+  enter = interval.t0;
+  return true;
 }
 
-glm::vec3 GJK::ClosestPointOnTriangle(const glm::vec3& X, const glm::vec3& P0, const glm::vec3& P1, const glm::vec3& P2)
+void GJK::CollectPairsSwept(Object* S, const glm::vec3& motion, Octree::TreeNode* root, std::vector<CollisionPair>& pairs)
 {
-  // 1. test for region of P0
-  if (glm::dot(X - P0, P1 - P0) <= 0 && glm::dot(X - P0, P2 - P0) <= 0)
-    return ClosestPointOnPoint(X, P0);
+  pairs.clear();
+  if (!root)
+    return;
 
-  // 2. test for region of P1
-  if (glm::dot(X - P1, P0 - P1) <= 0 && glm::dot(X - P1, P2 - P1) <= 0)
-    return ClosestPointOnPoint(X, P1);
+  std::vector<Octree::TreeNode*> stack;
+  stack.reserve(STACK_SIZE);
+  stack.push_back(root);
 
-  // 3. test for edge P0-P1
-  glm::vec3 N = glm::cross(P1 - P0, P2 - P0);
-  glm::vec3 A = glm::cross(P1 - P0, N);
-  if (glm::dot(X - P0, P1 - P0) >= 0 && glm::dot(X - P0, A) >= 0 && glm::dot(X - P1, P0 - P1))
+  while (!stack.empty())
   {
-    return ClosestPointOnLineSegment(X, P0, P1);
+    Octree::TreeNode* node = stack.back();
+    stack.pop_back();
+
+    float enter = 0.f;
+    if (!sweptBox(S->bv->min_, S->bv->max_, motion, node->bv_, enter))
+      continue;
+
+    if (node->type_ == Octree::TreeNodeType::TNT_LEAF_NODE)
+    {
+      CollisionPair pair;
+      pair.object = S;
+      pair.node = node;
+      pair.enter = enter;
+      pairs.push_back(pair);
+      continue;
+    }
+
+    for (int i = 0; i < MAX_CHILDREN; ++i)
+    {
+      if (node->children_[i])
+        stack.push_back(node->children_[i]);
+    }
   }
 
-  // 4. test for region of P2
-  if (glm::dot(X - P2, P0 - P2) <= 0 && glm::dot(X - P2, P1 - P2) <= 0)
-    return ClosestPointOnPoint(X, P2);
+  std::sort(pairs.begin(), pairs.end(), [](const CollisionPair& a, const CollisionPair& b)
+    {
+      return a.enter < b.enter;
+    });
+}
 
-  // 5. test for edge P1-P2
-  N = glm::cross(P2 - P1, P0 - P1);
-  A = glm::cross(P2 - P1, N);
-  if (glm::dot(X - P1, P2 - P1) >= 0 && glm::dot(X - P1, A) >= 0 && glm::dot(X - P2, P1 - P2))
+bool GJK::DetectCollision_Continuous(Object* S, const glm::vec3& motion, Octree::TreeNode* node, float& toi)
+{
+  auto* om = Engine::managers_.GetManager<ObjectManager*>();
+  auto& pairs = om->gjkController.pairs;
+  CollectPairsSwept(S, motion, node, pairs);
+
+  Object* objectBV = S->bv->bv_object;
+  Collider object(objectBV->shape->GetHull(), objectBV->GetPosition(), objectBV->GetOrientation(), objectBV->GetScale());
+
+  Object* model = om->GetModels().empty() ? nullptr : om->GetModels()[0];
+  const ConvexDecomposition* decomposition = om->gjkController.decomposition;
+  bool usePieces = model && om->gjkController.convexPieces && decomposition && !decomposition->Empty();
+  bool useTriangles = model && om->gjkController.exact && om->closestPointController.bvh && S->shape->GetBVH();
+  glm::mat4 worldToModel = model ? glm::inverse(model->modelTr) : glm::mat4(1.f);
+  Collider shape;
+  Collider piece;
+  if (usePieces)
   {
-    return ClosestPointOnLineSegment(X, P1, P2);
+    shape = Collider(S->shape->GetHull(), S->GetPosition(), S->GetOrientation(), S->GetScale());
+    piece = Collider(nullptr, model->GetPosition(), model->GetOrientation(), model->GetScale());
   }
 
-  // 6. test for edge P2-P0
-  N = glm::cross(P1 - P0, P2 - P0);
-  A = glm::cross(N, P2 - P0);
-  if (glm::dot(X - P0, P2 - P0) >= 0 && glm::dot(X - P0, A) >= 0 && glm::dot(X - P2, P0 - P2))
+  // leaves are sorted by entry time, none entered after the best impact can beat it
+  ImpactResult best;
+  CollisionPair* hitPair = nullptr;
+  toi = 1.f;
+  for (auto& pair : pairs)
   {
-    return ClosestPointOnLineSegment(X, P2, P0);
+    if (pair.enter > toi)
+      break;
+
+    Object* modelBV = pair.node->bv_->bv_object;
+    Collider leaf(modelBV->shape->GetHull(), modelBV->GetPosition(), modelBV->GetOrientation(), modelBV->GetScale());
+    ImpactResult impact;
+    if (!TimeOfImpact(object, motion, leaf, glm::vec3(0.f), impact) || impact.t > toi)
+      continue;
+
+    if (usePieces || useTriangles)
+      leafRegion(pair.node, worldToModel, pair.regionMin, pair.regionMax);
+
+    // leaf box hit, the earliest convex piece inside the leaf replaces it
+    if (usePieces)
+    {
+      bool pieceHit = false;
+      ImpactResult pieceImpact;
+      for (auto& convex : decomposition->pieces_)
+      {
+        if (glm::any(glm::lessThan(convex.max_, pair.regionMin)) || glm::any(glm::greaterThan(convex.min_, pair.regionMax)))
+          continue;
+        piece.hull_ = &convex.hull_;
+        piece.hint_ = 0;
+        if (TimeOfImpact(shape, motion, piece, glm::vec3(0.f), pieceImpact) && pieceImpact.t <= toi &&
+          (!pieceHit || pieceImpact.t < impact.t))
+        {
+          impact = pieceImpact;
+          pieceHit = true;
+        }
+      }
+      if (!pieceHit)
+        continue;
+    }
+
+    // the impact is only a candidate, advance until the triangles inside the leaf touch
+    float t = impact.t;
+    if (useTriangles)
+    {
+      pair.objectMesh = S->shape->GetBVH();
+      pair.modelMesh = om->closestPointController.bvh;
+      if (!sweepTriangles(pair, worldToModel, motion, toi, t))
+        continue;
+    }
+    toi = t;
+    best = impact;
+    hitPair = &pair;
   }
+  if (!hitPair)
+    return false;
+
+  hitPair->result.hit = true;
+  om->AddBoundingVolumeGJK(hitPair->node->bv_);
+
+  // touching contact at the time of impact, witness points are those of the hull or piece impact
+  om->gjkController.contact.normal = -best.normal;
+  om->gjkController.contact.depth = 0.f;
+  om->gjkController.contact.pointA = best.pointA;
+  om->gjkController.contact.pointB = best.pointB;
+  om->gjkController.simplex->vertices_.clear();
+  om->gjkController.simplex->indices_.clear();
+  for (int i = best.count - 1; i >= 0; --i)
+    om->gjkController.simplex->Add(best.simplex[i].p);
+  return true;
+}
 
-  // 7. test for triangle
-  // X is inside triangle
-  Triangle tri = { P0, P1, P2 };
-  // calculate barycentric coordinates
-  glm::vec3 E1 = tri.v2_ - tri.v1_;
-  glm::vec3 E2 = tri.v3_ - tri.v1_;
+GJK::Collider::Collider(const ConvexHull* hull, const glm::vec3& position, const Quaternion& orientation,
+  const glm::vec3& scale, int hint)
+  : hull_(hull), position_(position), orientation_(orientation), scale_(scale), hint_(hint)
+{
+  inverse_ = orientation_.conjugate();
+}
 
-  float S = tri.AreaTriangle(E1, E2);
-  float S1 = tri.AreaTriangle(X - tri.v1_, X - tri.v2_);
-  float S2 = tri.AreaTriangle(X - tri.v2_, X - tri.v3_);
-  float S3 = tri.AreaTriangle(X - tri.v3_, X - tri.v1_);
+glm::vec3 GJK::Collider::Support(const glm::vec3& dir)
+{
+  // max dot(R * S * v, d) = max dot(v, S * R^-1 * d)
+  glm::vec3 localDir = scale_ * (inverse_ * dir);
+  glm::vec3 localP = hull_->Support(localDir, hint_);
+  return position_ + orientation_ * (scale_ * localP);
+}
 
-  // barycentric coordinates
-  float u = S1 / S;
-  float v = S2 / S;
-  float w = S3 / S;
+// grow a touching (flat) simplex into a tetrahedron so EPA starts from a volume
+static bool completeSimplex(GJK::SupportPoint* simplex, int& count, GJK::Collider& object, GJK::Collider& model)
+{
+  static const glm::vec3 axes[6] = {
+    { 1.f,0.f,0.f }, { -1.f,0.f,0.f }, { 0.f,1.f,0.f }, { 0.f,-1.f,0.f }, { 0.f,0.f,1.f }, { 0.f,0.f,-1.f }
+  };
+  const float tolerance = 0.0001f;
 
-  if (v == 1.0f)
+  if (count == 1)
   {
-    return ClosestPointOnPoint(X, P0);
+    for (auto& axis : axes)
+    {
+      GJK::SupportPoint P = GJK::supportFunction(axis, object, model);
+      if (glm::length(P.p - simplex[0].p) > tolerance)
+      {
+        simplex[count++] = P;
+        break;
+      }
+    }
+  }
+  if (count == 2)
+  {
+    glm::vec3 line = glm::normalize(simplex[1].p - simplex[0].p);
+    for (int i = 0; i < 6 && count == 2; ++i)
+    {
+      glm::vec3 dir = glm::cross(line, axes[i]);
+      if (glm::dot(dir, dir) < tolerance)
+        continue;
+      GJK::SupportPoint P = GJK::supportFunction(dir, object, model);
+      glm::vec3 toP = P.p - simplex[0].p;
+      if (glm::length(toP - line * glm::dot(toP, line)) > tolerance)
+        simplex[count++] = P;
+    }
+  }
+  if (count == 3)
+  {
+    glm::vec3 n = glm::cross(simplex[1].p - simplex[0].p, simplex[2].p - simplex[0].p);
+    float len = glm::length(n);
+    if (len < EPSILON)
+      return false;
+    n /= len;
+    GJK::SupportPoint P = GJK::supportFunction(n, object, model);
+    if (std::abs(glm::dot(P.p - simplex[0].p, n)) <= tolerance)
+      P = GJK::supportFunction(-n, object, model);
+    if (std::abs(glm::dot(P.p - simplex[0].p, n)) <= tolerance)
+      return false;
+    simplex[count++] = P;
   }
-  if (w == 1.0f)
+  return count == 4;
+}
+
+// closest point of the simplex to the origin, the simplex is reduced to the
+// vertices supporting it and weights receives their barycentric coordinates
+static glm::vec3 closestOnSimplex(GJK::SupportPoint* simplex, int& count, float weights[4])
+{
+  glm::vec4 w(1.f, 0.f, 0.f, 0.f);
+  glm::vec3 closest = simplex[0].p;
+  if (count == 2)
   {
-    return ClosestPointOnPoint(X, P1);
+    float t;
+    closest = ClosestPoint::PointSegment(ORIGIN, simplex[0].p, simplex[1].p, t);
+    w = { 1.f - t, t, 0.f, 0.f };
   }
-  if (u == 1.0f)
+  else if (count == 3)
   {
-    return ClosestPointOnPoint(X, P2);
+    glm::vec3 b;
+    closest = ClosestPoint::PointTriangle(ORIGIN, simplex[0].p, simplex[1].p, simplex[2].p, b);
+    w = { b, 0.f };
   }
-  if (v == 0.0f || v == std::min(std::min(u,v),w))
+  else if (count == 4)
   {
-    return ClosestPointOnLineSegment(X, P1, P2);
+    closest = ClosestPoint::PointTetrahedron(ORIGIN, simplex[0].p, simplex[1].p, simplex[2].p, simplex[3].p, w);
   }
-  if (w == 0.0f || w == std::min(std::min(u, v), w))
+
+  // regions outside the closest feature have exactly zero weight
+  int kept = 0;
+  for (int i = 0; i < count; ++i)
   {
-    return ClosestPointOnLineSegment(X, P2, P0);
+    if (w[i] > 0.f)
+    {
+      simplex[kept] = simplex[i];
+      weights[kept] = w[i];
+      ++kept;
+    }
   }
-  if (u == 0.0f || u == std::min(std::min(u, v), w))
+  if (kept == 0)
   {
-    return ClosestPointOnLineSegment(X, P0, P1);
+    weights[0] = 1.f;
+    kept = 1;
   }
+  count = kept;
+  return closest;
 }
 
-glm::vec3 GJK::ClosestPointOnTetraHedron(const glm::vec3& X, const glm::vec3& P0, const glm::vec3& P1,
-  const glm::vec3& P2, const glm::vec3& P3)
+bool GJK::Run(Collider& object, Collider& model, Result& result,
+  SimplexCache* cache, bool computeContact)
 {
-  // assume X is the closest point
-  glm::vec3 closestPoint = X;
+  // newest point is always simplex[0]
+  SupportPoint* simplex = result.simplex;
+  int& count = result.count;
+  count = 0;
+  result.hit = false;
+  result.iterations = 0;
+
+  // warm start from last frame's direction and support vertices
+  glm::vec3 dir = object.position_ - model.position_;
+  if (cache && cache->count > 0)
+  {
+    dir = cache->dir;
+    object.hint_ = cache->hintA;
+    model.hint_ = cache->hintB;
+  }
+  if (glm::dot(dir, dir) < EPSILON)
+    dir = { 1.f,0.f,0.f };
+
+  simplex[0] = supportFunction(dir, object, model);
+  count = 1;
+
+  // nothing reaches past the origin along dir, a warm started separating axis ends here
+  if (glm::dot(simplex[0].p, dir) < 0.f)
+  {
+    if (cache)
+    {
+      cache->dir = dir;
+      cache->hintA = object.hint_;
+      cache->hintB = model.hint_;
+      cache->count = count;
+    }
+    return false;
+  }
+
+  // v is the closest point of the simplex to the origin, the next search goes against it
+  glm::vec3 v = simplex[0].p;
+  float weights[4];
 
-  // test for region of triangles
-  // P0, P1, P2
-  if (S_Plane(glm::cross(P1 - P0, P2 - P0), P0).PlanePoint(X) == S_Plane::CLASSIFY_POINT_PLANE::FRONT)
-    closestPoint = ClosestPointOnTriangle(X, P0, P1, P2);
+  for (; result.iterations < GJK_MAX_ITERATIONS; ++result.iterations)
+  {
+    // origin lies on or inside the current simplex
+    float vv = glm::dot(v, v);
+    if (vv < EPSILON)
+    {
+      result.hit = true;
+      break;
+    }
 
-  // P0, P2, P3
-  if (S_Plane(glm::cross(P2 - P0, P3 - P0), P0).PlanePoint(X) == S_Plane::CLASSIFY_POINT_PLANE::FRONT)
-    closestPoint = ClosestPointOnTriangle(X, P0, P2, P3);
+    // get new support point
+    dir = -v;
+    SupportPoint newSupportPoint = supportFunction(dir, object, model);
+
+    // two shapes dont intersect
+    if (glm::dot(newSupportPoint.p, dir) < 0.f)
+      break;
+
+    for (int i = count; i > 0; --i)
+      simplex[i] = simplex[i - 1];
+    simplex[0] = newSupportPoint;
+    ++count;
+
+    // same voronoi region kernels as the distance query, no progress means no crossing
+    v = closestOnSimplex(simplex, count, weights);
+    if (glm::dot(v, v) >= vv)
+      break;
+  }
+  dir = -v;
+
+  if (cache)
+  {
+    cache->dir = dir;
+    cache->hintA = object.hint_;
+    cache->hintB = model.hint_;
+    cache->count = count;
+  }
 
-  // P0, P3, P1
-  if (S_Plane(glm::cross(P3 - P0, P1 - P0), P0).PlanePoint(X) == S_Plane::CLASSIFY_POINT_PLANE::FRONT)
-    closestPoint = ClosestPointOnTriangle(X, P0, P3, P1);
+  if (result.hit && computeContact)
+  {
+    if (completeSimplex(simplex, count, object, model) && EPA(object, model, simplex, result.contact))
+      return true;
 
-  // P1, P2, P3
-  if (S_Plane(glm::cross(P2 - P1, P3 - P1), P1).PlanePoint(X) == S_Plane::CLASSIFY_POINT_PLANE::FRONT)
-    closestPoint = ClosestPointOnTriangle(X, P1, P2, P3);
+    // touching or degenerate simplex, report a zero depth contact
+    glm::vec3 centerDir = model.position_ - object.position_;
+    result.contact.normal = glm::dot(centerDir, centerDir) > EPSILON ? glm::normalize(centerDir) : glm::vec3(0.f, 1.f, 0.f);
+    result.contact.depth = 0.f;
+    result.contact.pointA = simplex[0].a;
+    result.contact.pointB = simplex[0].b;
+  }
+  return result.hit;
+}
 
-  return closestPoint;
+GJK::SupportPoint GJK::supportFunction(glm::vec3 dir, Collider& object, Collider& model)
+{
+  SupportPoint result;
+  result.a = object.Support(dir);
+  result.b = model.Support(-dir);
+  result.p = result.a - result.b;
+  return result;
 }
 
-bool GJK::Run(
-  const std::vector<glm::vec4>& objectVertices,
-  const std::vector<glm::ivec3>& objectIndices,
-  const glm::vec3& objectCenter,
-  const std::vector<glm::vec4>& modelVertices,
-  const std::vector<glm::ivec3>& modelIndices,
-  const glm::vec3& modelCenter)
+namespace
 {
-  auto* om = Engine::managers_.GetManager<ObjectManager*>();
+  constexpr int EPA_MAX_VERTICES = 64;
+  constexpr int EPA_MAX_FACES = 128;
+  constexpr int EPA_MAX_EDGES = 96;
+  constexpr float EPA_TOLERANCE = 0.0001f;
+
+  struct EPAFace
+  {
+    int v[3];
+    glm::vec3 n;
+    float d; // distance from origin
+  };
+
+  // barycentric coordinates of P in triangle ABC
+  glm::vec3 Barycentric(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+  {
+    glm::vec3 v0 = B - A, v1 = C - A, v2 = P - A;
+    float d00 = glm::dot(v0, v0);
+    float d01 = glm::dot(v0, v1);
+    float d11 = glm::dot(v1, v1);
+    float d20 = glm::dot(v2, v0);
+    float d21 = glm::dot(v2, v1);
+    float denom = d00 * d11 - d01 * d01;
+    if (std::abs(denom) < EPSILON)
+      return { 1.f, 0.f, 0.f };
+    float v = (d11 * d20 - d01 * d21) / denom;
+    float w = (d00 * d21 - d01 * d20) / denom;
+    return { 1.f - v - w, v, w };
+  }
+}
 
-  // first choose a direction
-  om->gjkController.simplex->dir_ = glm::normalize(objectCenter - modelCenter);
+bool GJK::EPA(Collider& object, Collider& model, const SupportPoint* simplex, Contact& contact)
+{
+  SupportPoint vertices[EPA_MAX_VERTICES];
+  EPAFace faces[EPA_MAX_FACES];
+  int edges[EPA_MAX_EDGES][2];
+  int vertexCount = 4;
+  int faceCount = 0;
 
-  glm::vec3 simplexPoint = supportFunction(om->gjkController.simplex->dir_,
-    objectVertices, objectIndices, modelVertices, modelIndices);
+  for (int i = 0; i < 4; ++i)
+    vertices[i] = simplex[i];
 
-  om->gjkController.simplex->Add(simplexPoint);
+  auto makeFace = [&](int a, int b, int c, EPAFace& face) -> bool
+  {
+    glm::vec3 n = glm::cross(vertices[b].p - vertices[a].p, vertices[c].p - vertices[a].p);
+    float len = glm::length(n);
+    if (len < EPSILON)
+      return false;
+    face.v[0] = a;
+    face.v[1] = b;
+    face.v[2] = c;
+    face.n = n / len;
+    face.d = glm::dot(face.n, vertices[a].p);
+    return true;
+  };
 
-  // next direction is toward the origin
-  om->gjkController.simplex->dir_ = glm::normalize(ORIGIN - om->gjkController.simplex->Get(0));
+  // initial tetrahedron, flip faces so normals point away from the opposite vertex
+  const int tetra[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+  for (auto& t : tetra)
+  {
+    EPAFace& face = faces[faceCount];
+    if (!makeFace(t[0], t[1], t[2], face))
+      return false;
+    if (glm::dot(face.n, vertices[t[3]].p - vertices[t[0]].p) > 0.f)
+    {
+      std::swap(face.v[1], face.v[2]);
+      face.n = -face.n;
+      face.d = -face.d;
+    }
+    ++faceCount;
+  }
 
+  int closest = 0;
   while (true)
   {
-    // get new support point
-    glm::vec3 newSupportPoint = supportFunction(om->gjkController.simplex->dir_,
-      objectVertices, objectIndices, modelVertices, modelIndices);
+    // face closest to the origin
+    closest = 0;
+    for (int i = 1; i < faceCount; ++i)
+    {
+      if (faces[i].d < faces[closest].d)
+        closest = i;
+    }
 
-    float dotProduct = glm::dot(newSupportPoint, om->gjkController.simplex->dir_);
+    glm::vec3 n = faces[closest].n;
+    SupportPoint support = supportFunction(n, object, model);
+    float distance = glm::dot(support.p, n);
 
-    // two shapes dont intersect
-    if (dotProduct < 0)
+    // polytope can not grow further along the normal
+    if (distance - faces[closest].d < EPA_TOLERANCE * std::max(1.f, faces[closest].d))
+      break;
+    if (vertexCount == EPA_MAX_VERTICES)
+      break;
+
+    int newIndex = vertexCount;
+    vertices[vertexCount++] = support;
+
+    // remove faces seen from the new point and keep their silhouette
+    int edgeCount = 0;
+    bool overflow = false;
+    for (int i = 0; i < faceCount;)
     {
-      om->gjkController.simplex->vertices_.clear();
-      om->gjkController.simplex->indices_.clear();
+      if (glm::dot(faces[i].n, support.p - vertices[faces[i].v[0]].p) > 0.f)
+      {
+        for (int e = 0; e < 3; ++e)
+        {
+          int a = faces[i].v[e];
+          int b = faces[i].v[(e + 1) % 3];
+
+          // shared edge between two removed faces is not on the silhouette
+          bool shared = false;
+          for (int k = 0; k < edgeCount; ++k)
+          {
+            if (edges[k][0] == b && edges[k][1] == a)
+            {
+              edges[k][0] = edges[edgeCount - 1][0];
+              edges[k][1] = edges[edgeCount - 1][1];
+              --edgeCount;
+              shared = true;
+              break;
+            }
+          }
+          if (!shared)
+          {
+            if (edgeCount == EPA_MAX_EDGES)
+            {
+              overflow = true;
+              break;
+            }
+            edges[edgeCount][0] = a;
+            edges[edgeCount][1] = b;
+            ++edgeCount;
+          }
+        }
+        faces[i] = faces[--faceCount];
+      }
+      else
+      {
+        ++i;
+      }
+    }
+    if (overflow || faceCount + edgeCount > EPA_MAX_FACES)
       return false;
+
+    // fan of new faces from the silhouette to the new point
+    for (int k = 0; k < edgeCount; ++k)
+    {
+      if (makeFace(edges[k][0], edges[k][1], newIndex, faces[faceCount]))
+        ++faceCount;
     }
+    if (faceCount == 0)
+      return false;
+  }
 
-    om->gjkController.simplex->Add(newSupportPoint);
+  const EPAFace& face = faces[closest];
+  const SupportPoint& A = vertices[face.v[0]];
+  const SupportPoint& B = vertices[face.v[1]];
+  const SupportPoint& C = vertices[face.v[2]];
+
+  // projection of the origin on the closest face gives the witness points
+  glm::vec3 bary = Barycentric(face.n * face.d, A.p, B.p, C.p);
+  contact.normal = face.n;
+  contact.depth = face.d;
+  contact.pointA = A.a * bary.x + B.a * bary.y + C.a * bary.z;
+  contact.pointB = A.b * bary.x + B.b * bary.y + C.b * bary.z;
+  return true;
+}
 
-    if (handleSimplex(om->gjkController.simplex, om->gjkController.simplex->dir_))
-      return true;
-  }
+void GJK::ContactManifold::Clear()
+{
+  count = 0;
 }
 
-glm::vec3 GJK::supportFunction(glm::vec3 dir, 
-  const std::vector<glm::vec4>& objectVertices,
-  const std::vector<glm::ivec3>& objectIndices,
-  const std::vector<glm::vec4>& modelVertices,
-  const std::vector<glm::ivec3>& modelIndices)
+void GJK::ContactManifold::Refresh(const glm::mat4& transformA, const glm::mat4& transformB)
 {
-  return getFurthestPoint(dir, objectVertices, objectIndices) - getFurthestPoint(-dir, modelVertices, modelIndices);
+  for (int i = 0; i < count;)
+  {
+    Contact& c = points[i];
+    c.pointA = glm::vec3(transformA * glm::vec4(localA[i], 1.f));
+    c.pointB = glm::vec3(transformB * glm::vec4(localB[i], 1.f));
+    c.depth = glm::dot(c.pointA - c.pointB, c.normal);
+
+    // separated along the normal or slid apart tangentially
+    glm::vec3 tangent = (c.pointA - c.pointB) - c.normal * c.depth;
+    if (c.depth < -breakingThreshold || glm::dot(tangent, tangent) > breakingThreshold * breakingThreshold)
+    {
+      --count;
+      points[i] = points[count];
+      localA[i] = localA[count];
+      localB[i] = localB[count];
+    }
+    else
+    {
+      ++i;
+    }
+  }
 }
 
-glm::vec3 GJK::getFurthestPoint(glm::vec3 dir, 
-                                const std::vector<glm::vec4>& vertices,
-                                const std::vector<glm::ivec3>& indices)
+void GJK::ContactManifold::Add(const Contact& contact, const glm::mat4& transformA, const glm::mat4& transformB)
 {
-  unsigned saved_index;
-  unsigned saved_comp;
-  float max = -100000.f;
+  glm::vec3 lA = glm::vec3(glm::inverse(transformA) * glm::vec4(contact.pointA, 1.f));
+  glm::vec3 lB = glm::vec3(glm::inverse(transformB) * glm::vec4(contact.pointB, 1.f));
 
-  for (unsigned i = 0; i < indices.size(); ++i)
+  // same contact as a cached one, update it
+  for (int i = 0; i < count; ++i)
   {
-    for (unsigned c = 0; c < 3; ++c)
+    glm::vec3 diff = points[i].pointA - contact.pointA;
+    if (glm::dot(diff, diff) < breakingThreshold * breakingThreshold)
     {
-      glm::vec3 vertex = glm::vec3(vertices[indices[i][c]]);
-      float dotProduct = glm::dot(vertex, dir);
-      if (max < dotProduct)
-      {
-        max = dotProduct;
-        saved_index = i;
-        saved_comp = c;
-      }
+      points[i] = contact;
+      localA[i] = lA;
+      localB[i] = lB;
+      return;
     }
   }
 
-  return glm::vec3(vertices[indices[saved_index][saved_comp]]);
-}
+  if (count < MAX_POINTS)
+  {
+    points[count] = contact;
+    localA[count] = lA;
+    localB[count] = lB;
+    ++count;
+    return;
+  }
 
-bool GJK::handleSimplex(Simplex* simplex, glm::vec3& dir)
-{
-  // line case
-  if (simplex->vertices_.size() == 2)
+  // full, keep the deepest point and the set spanning the largest area
+  int deepest = 0;
+  for (int i = 1; i < MAX_POINTS; ++i)
   {
-    glm::vec3 B = simplex->Get(0);
-    glm::vec3 A = simplex->Get(1);
-    glm::vec3 resultP = ClosestPointOnLineSegment(ORIGIN, B, A);
+    if (points[i].depth > points[deepest].depth)
+      deepest = i;
+  }
+  if (contact.depth > points[deepest].depth)
+    deepest = -1; // new point is deepest, any old point may go
 
-    // line segment contains origin
-    if (resultP == ORIGIN)
-      return true;
+  int replace = -1;
+  float bestArea = -1.f;
+  for (int skip = 0; skip < MAX_POINTS; ++skip)
+  {
+    if (skip == deepest)
+      continue;
 
-    // update new direction
-    dir = glm::normalize(ORIGIN - resultP);
+    // area of the quad formed by the remaining 3 old points and the new one
+    glm::vec3 P[MAX_POINTS];
+    int n = 0;
+    for (int i = 0; i < MAX_POINTS; ++i)
+    {
+      if (i != skip)
+        P[n++] = points[i].pointA;
+    }
+    P[n] = contact.pointA;
+    float area = glm::length(glm::cross(P[2] - P[0], P[3] - P[1]));
+    if (area > bestArea)
+    {
+      bestArea = area;
+      replace = skip;
+    }
+  }
+  points[replace] = contact;
+  localA[replace] = lA;
+  localB[replace] = lB;
+}
 
-    return false;
+bool GJK::Distance(Collider& object, Collider& model, DistanceResult& result, SimplexCache* cache)
+{
+  SupportPoint* simplex = result.simplex;
+  int& count = result.count;
+  float weights[4] = { 1.f, 0.f, 0.f, 0.f };
+  result.overlap = false;
+  result.iterations = 0;
+
+  glm::vec3 dir = model.position_ - object.position_;
+  if (cache && cache->count > 0)
+  {
+    // cached dir points toward the origin, the closest point lies against it
+    dir = cache->dir;
+    object.hint_ = cache->hintA;
+    model.hint_ = cache->hintB;
   }
+  if (glm::dot(dir, dir) < EPSILON)
+    dir = { 1.f,0.f,0.f };
 
-  // triangle case
-  if (simplex->vertices_.size() == 3)
+  simplex[0] = supportFunction(-dir, object, model);
+  count = 1;
+  glm::vec3 v = simplex[0].p;
+
+  for (; result.iterations < GJK_MAX_ITERATIONS; ++result.iterations)
   {
-    glm::vec3 C = simplex->Get(0);
-    glm::vec3 B = simplex->Get(1);
-    glm::vec3 A = simplex->Get(2);
-    glm::vec3 resultP = ClosestPointOnTriangle(ORIGIN, C, B, A);
+    float vv = glm::dot(v, v);
+    if (vv < EPSILON)
+    {
+      result.overlap = true;
+      break;
+    }
 
-    if (resultP == ORIGIN)
-      return true;
+    // no support point gets meaningfully closer than v
+    SupportPoint w = supportFunction(-v, object, model);
+    if (vv - glm::dot(v, w.p) <= DISTANCE_TOLERANCE * vv)
+      break;
 
-    // update new direction
-    dir = glm::normalize(ORIGIN - resultP);
+    // same vertex again, numerically converged
+    bool duplicate = false;
+    for (int i = 0; i < count; ++i)
+    {
+      if (glm::dot(simplex[i].p - w.p, simplex[i].p - w.p) < EPSILON)
+        duplicate = true;
+    }
+    if (duplicate)
+      break;
 
-    return false;
+    for (int i = count; i > 0; --i)
+      simplex[i] = simplex[i - 1];
+    simplex[0] = w;
+    ++count;
+
+    v = closestOnSimplex(simplex, count, weights);
+    if (count == 4 || glm::dot(v, v) >= vv)
+    {
+      result.overlap = count == 4;
+      break;
+    }
+  }
+
+  if (cache)
+  {
+    cache->dir = -v;
+    cache->hintA = object.hint_;
+    cache->hintB = model.hint_;
+    cache->count = count;
   }
 
-  // tetrahedron case
-  if (simplex->vertices_.size() == 4)
+  // witness points from the barycentric weights of the final feature
+  result.pointA = ORIGIN;
+  result.pointB = ORIGIN;
+  for (int i = 0; i < count && !result.overlap; ++i)
   {
-    glm::vec3 D = simplex->Get(0);
-    glm::vec3 C = simplex->Get(1);
-    glm::vec3 B = simplex->Get(2);
-    glm::vec3 A = simplex->Get(3);
-    glm::vec3 resultP = ClosestPointOnTetraHedron(ORIGIN, D, C, B, A);
+    result.pointA += weights[i] * simplex[i].a;
+    result.pointB += weights[i] * simplex[i].b;
+  }
+  result.distance = result.overlap ? 0.f : glm::length(v);
+  result.normal = result.distance > EPSILON ? v / result.distance : glm::vec3(0.f);
+  return !result.overlap;
+}
 
-    if (resultP == ORIGIN)
-      return true;
+// conservative advancement, the separating plane of the closest points bounds
+// how far the pair can move before touching, pure translation only
+bool GJK::TimeOfImpact(Collider& object, const glm::vec3& motionA, Collider& model, const glm::vec3& motionB,
+  ImpactResult& result, float tolerance)
+{
+  glm::vec3 startA = object.position_;
+  glm::vec3 startB = model.position_;
+  glm::vec3 motion = motionA - motionB;
+  SimplexCache cache;
+  DistanceResult distance;
+
+  result.hit = false;
+  result.t = 0.f;
+  result.iterations = 0;
+
+  float t = 0.f;
+  for (; result.iterations < GJK_MAX_ITERATIONS; ++result.iterations)
+  {
+    object.position_ = startA + t * motionA;
+    model.position_ = startB + t * motionB;
+    Distance(object, model, distance, &cache);
 
-    return true;
+    if (distance.overlap || distance.distance <= tolerance)
+    {
+      result.hit = true;
+      result.t = t;
+      result.normal = distance.normal;
+      result.pointA = distance.pointA;
+      result.pointB = distance.pointB;
+      result.count = distance.count;
+      for (int i = 0; i < distance.count; ++i)
+        result.simplex[i] = distance.simplex[i];
+      break;
+    }
+
+    // normal points from model to object, approaching means moving against it
+    float closing = -glm::dot(motion, distance.normal);
+    if (closing <= EPSILON)
+      break;
+
+    // stop half a tolerance short so the next step lands inside the tolerance
+    t += (distance.distance - 0.5f * tolerance) / closing;
+    if (t > 1.f)
+      break;
   }
 
-  return false;
+  object.position_ = startA;
+  model.position_ = startB;
+  return result.hit;
 }
 
 void Simplex::Add(glm::vec3 P)
@@ -1,6 +1,8 @@
 #include "ImGuiUIManager.h"
 #include "Engine.h"
 #include "Texture.h"
+#include "OcclusionCuller.h"
+#include "ConvexDecomposition.h"
 #include <iostream>
 
 // Our state (make them static = more or less global) as a convenience to keep the example terse.
@@ -433,6 +435,127 @@ void ImGuiUIManager::Update()
 
     ImGui::Checkbox("Path Draw", &rm->splineDraw);
 
+    if (am->animation && am->animator)
+    {
+      ImGui::Checkbox("Compressed Clip", &am->animator->useCompressedClip);
+      static const char* interpolationModes[] = { "Slerp", "Corrected Nlerp", "Nlerp" };
+      int interpolation = static_cast<int>(am->animator->rotationInterpolation);
+      if (ImGui::Combo("Rotation Interpolation", &interpolation, interpolationModes, IM_ARRAYSIZE(interpolationModes)))
+      {
+        am->animator->rotationInterpolation = static_cast<RotationInterpolation>(interpolation);
+        for (auto& instance : am->crowd)
+          instance.animator->rotationInterpolation = am->animator->rotationInterpolation;
+      }
+      if (ImGui::Button("Benchmark Interpolation"))
+        am->BenchmarkRotationInterpolation();
+      if (am->interpolationBenchmark.samples > 0)
+      {
+        for (int m = 0; m < IM_ARRAYSIZE(interpolationModes); ++m)
+          ImGui::Text("%-15s scalar %6.2f ms, batch %6.2f ms, max error %.2e rad", interpolationModes[m],
+            am->interpolationBenchmark.scalarMilliseconds[m], am->interpolationBenchmark.batchMilliseconds[m],
+            am->interpolationBenchmark.maxError[m]);
+        static const char* operations[] = { "Multiply", "VQS Compose", "VQS Inverse" };
+        for (int o = 0; o < IM_ARRAYSIZE(operations); ++o)
+          ImGui::Text("%-15s scalar %6.2f ms, batch %6.2f ms, max error %.2e", operations[o],
+            am->interpolationBenchmark.operationScalarMilliseconds[o], am->interpolationBenchmark.operationBatchMilliseconds[o],
+            am->interpolationBenchmark.operationMaxError[o]);
+        ImGui::Text("%d samples", am->interpolationBenchmark.samples);
+      }
+      ImGui::Checkbox("Pre-Skinning", &rm->preSkinning);
+      if (rm->preSkinning)
+        ImGui::Checkbox("CPU Skinning", &rm->cpuSkinning);
+      ImGui::Checkbox("Dual Quaternion Skinning", &rm->dualQuaternionSkinning);
+
+      if (am->walkLayer >= 0 && am->runLayer >= 0)
+      {
+        ImGui::Text("Locomotion Blend");
+        ImGui::Checkbox("Blend By Path Speed", &am->blendBySpeed);
+        if (am->blendBySpeed)
+        {
+          ImGui::InputFloat("Walk Speed", &am->walkSpeed);
+          ImGui::InputFloat("Run Speed", &am->runSpeed);
+        }
+        else
+        {
+          ImGui::SliderFloat("Crossfade Time", &am->crossFadeTime, 0.f, 2.f);
+          if (ImGui::Button("Walk"))
+            am->animator->CrossFade(am->walkLayer, am->crossFadeTime);
+          ImGui::SameLine();
+          if (ImGui::Button("Run"))
+            am->animator->CrossFade(am->runLayer, am->crossFadeTime);
+        }
+        ImGui::Text("Walk: %.2f Run: %.2f", am->animator->GetLayerWeight(am->walkLayer),
+          am->animator->GetLayerWeight(am->runLayer));
+      }
+
+      ImGui::Text("Motion Matching");
+      static bool motionMatchingFailed = false;
+      bool useMotionMatching = am->useMotionMatching;
+      if (ImGui::Checkbox("Match Path", &useMotionMatching))
+      {
+        if (useMotionMatching)
+          motionMatchingFailed = !am->StartMotionMatching();
+        else
+          am->StopMotionMatching();
+      }
+      if (motionMatchingFailed)
+        ImGui::TextColored(ImVec4(1.f, 0.f, 0.f, 1.f), "No feet or hips found in the rig");
+      if (am->motionMatching)
+      {
+        MotionMatching& mm = *am->motionMatching;
+        ImGui::Checkbox("KD-Tree Search", &mm.useKDTree);
+        ImGui::SliderFloat("Search Interval", &mm.settings.searchInterval, 0.f, 0.5f);
+        ImGui::SliderFloat("Match Blend Time", &mm.settings.blendTime, 0.f, 1.f);
+        ImGui::Text("%d frames, search %.1f us, cost %.3f, frame %d, %d transitions", mm.GetFrameCount(),
+          mm.searchMicroseconds, mm.matchCost, mm.matchedFrame, mm.transitions);
+      }
+      ImGui::InputInt("Benchmark Frames", &am->poseSearchBenchmark.frames, 10000);
+      if (ImGui::Button("Benchmark Pose Search"))
+        am->BenchmarkPoseSearch();
+      if (am->poseSearchBenchmark.queries > 0)
+      {
+        ImGui::Text("kd-tree %.1f us, full scan %.1f us per query, build %.1f ms",
+          am->poseSearchBenchmark.treeMicroseconds, am->poseSearchBenchmark.bruteForceMicroseconds,
+          am->poseSearchBenchmark.buildMilliseconds);
+        ImGui::Text("%d queries, %d mismatches", am->poseSearchBenchmark.queries, am->poseSearchBenchmark.mismatches);
+      }
+
+      ImGui::Text("Crowd");
+      ImGui::SliderInt("Instances", &am->crowdSize, 1, 1024);
+      ImGui::InputFloat("Spacing", &am->crowdSpacing);
+      if (ImGui::Button("Spawn Crowd"))
+        am->SpawnCrowd(am->crowdSize, am->crowdSpacing);
+      ImGui::SameLine();
+      if (ImGui::Button("Clear Crowd"))
+        am->ClearCrowd();
+      ImGui::Text("Animated Instances: %d", static_cast<int>(am->crowd.size()));
+
+      ImGui::Checkbox("Baked Crowd Playback", &am->bakedPlayback);
+      ImGui::SliderFloat("Bake Rate", &am->bakeRate, 5.f, 120.f);
+      if (ImGui::Button("Bake Clip"))
+        am->BakeCrowdClip();
+      if (!am->baked.Empty())
+        ImGui::Text("Baked: %d frames, %.1f KB, max error %g", am->baked.frameCount,
+          am->baked.matrices.size() * sizeof(glm::mat4) / 1024.f, am->bakeError);
+
+      ImGui::Checkbox("Animation LOD", &am->lod.enabled);
+      if (am->lod.enabled)
+      {
+        ImGui::InputFloat("LOD Near", &am->lod.nearDistance);
+        ImGui::InputFloat("LOD Far", &am->lod.farDistance);
+        ImGui::SliderInt("Far Update Interval", &am->lod.farInterval, 1, 8);
+        ImGui::SliderFloat("Far Bone Cull", &am->lod.cullFraction, 0.f, 0.5f);
+        ImGui::Checkbox("Freeze Off-Screen", &am->lod.freezeOffscreen);
+        ImGui::Text("Full: %d Reduced: %d Frozen: %d", am->lodCounts[0], am->lodCounts[1], am->lodCounts[2]);
+      }
+
+      size_t rawMemory = 0;
+      for (auto& bone : am->animation->GetBonesData())
+        rawMemory += bone.getTimes().size() * (sizeof(float) + 2 * sizeof(glm::vec3) + sizeof(Quaternion));
+      const CompressedClip& clip = am->animation->GetCompressedClip();
+      ImGui::Text("Clip Memory: %zu KB -> %zu KB, %d keys", rawMemory / 1024, clip.GetMemory() / 1024, clip.GetKeyCount());
+    }
+
     if (am->PlayAnimation)
     {
       ImGui::Text("Sliding & Skidding Control");
@@ -757,6 +880,16 @@ void ImGuiUIManager::Update()
     {
       ImGui::Checkbox("Delete Tree", &om->bsptreeConroller.deleteFlag);
       ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "TREE READY!\nMAKE SURE TO TURN ON DEBUG DRAW TO SEE");
+
+      ImGui::Separator();
+      ImGui::Checkbox("Occlusion Culling", &om->occlusionController.enableFlag);
+      if (ImGui::DragInt("Occluders", &om->occlusionController.max_occluders, 1.f, 1, 1024))
+        om->occlusionController.occluderDirty = true;
+      if (om->occlusionController.enableFlag)
+      {
+        ImGui::Text("Rasterized triangles: %u", om->occlusionController.culler->rasterizedTriangles);
+        ImGui::Text("Octree nodes visible: %d culled: %d", om->occlusionController.visibleNodes, om->occlusionController.culledNodes);
+      }
     }
 
     // enable glfw input
@@ -789,6 +922,11 @@ void ImGuiUIManager::Update()
     if (!om->gjkController.startFlag)
     {
       ImGui::Checkbox("Start", &om->gjkController.startFlag);
+      ImGui::Checkbox("Continuous Collision", &om->gjkController.continuous);
+      ImGui::Checkbox("Exact Triangle Test", &om->gjkController.exact);
+      ImGui::Checkbox("Convex Pieces", &om->gjkController.convexPieces);
+      if (om->gjkController.decomposition)
+        ImGui::Text("Model pieces: %d", static_cast<int>(om->gjkController.decomposition->pieces_.size()));
       ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), 
         "MAKE SURE TO BUILD OCTREE FIRST!!!\nCLICK START TO BEGIN GJK-ALGORITHM\nTO TEST COLLISION:\nCLICK START TO SHOOT SPHERE AT MODEL");
     }
@@ -798,6 +936,32 @@ void ImGuiUIManager::Update()
       ImGui::Checkbox("Reset", &om->gjkController.resetFlag);
       ImGui::Checkbox("Draw Simplex", &rm->simplexDraw);
       ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "COLLISION DETECTED");
+
+      auto& contact = om->gjkController.contact;
+      ImGui::Text("Penetration depth: %.3f", contact.depth);
+      ImGui::Text("Normal: (%.2f, %.2f, %.2f)", contact.normal.x, contact.normal.y, contact.normal.z);
+      int contactPoints = 0;
+      for (auto& m : om->gjkController.manifolds)
+        contactPoints += m.second.manifold.count;
+      int hits = 0;
+      for (auto& pair : om->gjkController.pairs)
+        hits += pair.result.hit ? 1 : 0;
+      ImGui::Text("Overlapping leaves: %d colliding: %d", static_cast<int>(om->gjkController.pairs.size()), hits);
+      ImGui::Text("Cached pairs: %d contact points: %d", static_cast<int>(om->gjkController.manifolds.size()), contactPoints);
+    }
+
+    ImGui::Separator();
+    ImGui::Checkbox("Closest Point Query", &om->closestPointController.enableFlag);
+    if (om->closestPointController.enableFlag)
+    {
+      auto& cp = om->closestPointController;
+      ImGui::Text("Distance to model: %.3f", cp.distance);
+      ImGui::Text("Closest point: (%.2f, %.2f, %.2f)", cp.point.x, cp.point.y, cp.point.z);
+      ImGui::Text("Closest triangle: %u", cp.triangle);
+      int k = static_cast<int>(cp.k);
+      if (ImGui::DragInt("K Nearest", &k, 1.f, 1, 64))
+        cp.k = static_cast<unsigned>(k);
+      ImGui::Text("Nearest triangles: %d", static_cast<int>(cp.nearestTriangles.size()));
     }
 
     // enable glfw input
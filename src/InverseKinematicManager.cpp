@@ -105,9 +105,8 @@ void InverseKinematicManager::UpdateVBO()
   // update position of bone when model is animating
   CHECKERROR;
   auto* am = Engine::managers_.GetManager<AnimationManager*>();
-  auto& boneInfoMap = am->animation->GetBoneIDMap();
   auto& ikChain = m_CCDSolver.getChain();
-  auto offsetMatrices = am->animator->GetPreOffSetMatrices();
+  const auto& offsetMatrices = am->animator->GetPreOffSetMatrices();
 
   // get each bone local position
   // and layout continuously
@@ -115,7 +114,7 @@ void InverseKinematicManager::UpdateVBO()
   {
     // m_PreOffSetMatrices get update every frame as player is animated
     // hierarchically calculate the world position of each joints inside IK chain
-    glm::mat4 transformation = offsetMatrices[boneInfoMap[ikChain[i].name].id];
+    glm::mat4 transformation = offsetMatrices[ikChain[i].boneID];
 
     // update bone position inside IK chain for drawing purpose
     IKChainPosition[i] = glm::vec3(transformation * glm::vec4(ikChain[i].localPosition, 1.f));
@@ -250,6 +249,7 @@ void InverseKinematicManager::CCDSolver()
 
   // clear buffer before going to the next solving iteration
   m_CCDSolver.getIntermediateValue().clear();
+  BuildChainIndex(Engine::managers_.GetManager<AnimationManager*>()->animation->GetBoneTable().Size());
 
   auto& ikChain = m_CCDSolver.getChain();
   for (int i = 0; i < ikChain.size(); ++i)
@@ -268,24 +268,21 @@ void InverseKinematicManager::AnimateIK()
 {
   auto& intermediateValue = m_CCDSolver.getIntermediateValue();
   auto* am = Engine::managers_.GetManager<AnimationManager*>();
-  auto& boneInfoMap = am->animation->GetBoneIDMap();
   auto offsetMatrices = am->animator->GetPreOffSetMatrices();
   auto& ikChain = m_CCDSolver.getChain();
 
   // apply new transformation matrix hierarchically to the entire bone tree
-  glm::mat4 identity = glm::mat4(1.0f);
-  ApplyTransformationHierarchy(&am->animation->GetRootNode(),
+  ApplyTransformationHierarchy(am->animation->GetSkeleton(),
     intermediateValue,
     keyFrame,
-    step,
-    offsetMatrices, identity, false);
+    offsetMatrices);
 
   // IK Chain joints
   for (int i = 0; i < ikChain.size(); ++i)
   {
     // get next pose
     glm::vec3 nextPos = glm::vec3(
-      offsetMatrices[boneInfoMap[ikChain[i].name].id] *
+      offsetMatrices[ikChain[i].boneID] *
       glm::vec4(ikChain[i].localPosition, 1.f));
 
     // linear interpolation between two poses
@@ -307,7 +304,7 @@ void InverseKinematicManager::AnimateIK()
   {
     // get next pose
     glm::vec3 nextPos = glm::vec3(
-      offsetMatrices[boneInfoMap[am->animation->boneName[i]].id] *
+      offsetMatrices[am->animation->boneIDs[i]] *
       glm::vec4(am->animation->boneLocalPosition[i], 1.f));
 
     // linear interpolation between two poses
@@ -338,88 +335,70 @@ void InverseKinematicManager::AnimateIK()
 }
 
 // apply new transformation matrix hierarchically to the entire bone tree
-void InverseKinematicManager::ApplyTransformationHierarchy(const NodeData* node,
+void InverseKinematicManager::ApplyTransformationHierarchy(const FlatSkeleton& skeleton,
   std::vector<std::vector<IKData>>& intermediateValue,
   unsigned keyFrame,
-  float step,
-  std::vector<glm::mat4>& preOffSetMatrices,
-  glm::mat4 parentTransform,
-  bool enterIKChain)
+  std::vector<glm::mat4>& preOffSetMatrices)
 {
-  std::string nodeName = node->name; // get name of current bone
   auto* am = Engine::managers_.GetManager<AnimationManager*>(); // get animation handle
-  auto& boneInfoMap = am->animation->GetBoneIDMap(); // get bone info map
   auto& finalMatrices = am->animator->GetFinalBoneMatrices();
 
-  // get correct bone
-  Bone* Bone = am->animation->FindBone(nodeName);
-
-  int IKindex = -1; // IK index
+  size_t nodeCount = skeleton.parent.size();
+  m_ParentTransform.resize(nodeCount);
+  m_BelowChain.resize(nodeCount);
 
-  // validate bone
-  if (Bone)
+  // parents come before their children, so what a node passes down is ready when its
+  // children are reached
+  for (size_t i = 0; i < nodeCount; ++i)
   {
-    // if bone are inside IK chain
-    if (isInsideIKChain(nodeName, IKindex))
+    int parent = skeleton.parent[i];
+    glm::mat4 parentTransform = parent >= 0 ? m_ParentTransform[parent] : glm::mat4(1.f);
+    bool belowChain = parent >= 0 && m_BelowChain[parent];
+    int id = skeleton.boneID[i];
+
+    // validate bone
+    if (skeleton.bone[i] >= 0 && id >= 0)
     {
-      // concatenate to get final matrix for each joint hierarchically
-      preOffSetMatrices[boneInfoMap[nodeName].id] =
-        intermediateValue[keyFrame][IKindex].Transformation * preOffSetMatrices[boneInfoMap[nodeName].id];
-        //ikChain[IKindex].Transformation * preOffSetMatrices[boneInfoMap[nodeName].id];
+      int IKindex = m_ChainIndex[id];
+
+      // if bone are inside IK chain
+      if (IKindex >= 0)
+      {
+        // concatenate to get final matrix for each joint hierarchically
+        preOffSetMatrices[id] = intermediateValue[keyFrame][IKindex].Transformation * preOffSetMatrices[id];
 
-      // mesh skinning but need to adjust vertex weights otherwise arm will be squished
-      finalMatrices[boneInfoMap[nodeName].id] = preOffSetMatrices[boneInfoMap[nodeName].id] * boneInfoMap[nodeName].offset;
+        // mesh skinning but need to adjust vertex weights otherwise arm will be squished
+        finalMatrices[id] = preOffSetMatrices[id] * skeleton.offset[i];
 
-      // pass down update parent transform
-      parentTransform = intermediateValue[keyFrame][IKindex].Transformation;
-      //parentTransform = ikChain[IKindex].Transformation;
+        // pass down update parent transform
+        parentTransform = intermediateValue[keyFrame][IKindex].Transformation;
 
-      // turn on flag to update children that has parent inside IK chain
-      enterIKChain = true;
-    }
-    else // not in IK chain
-    {
-      // if IK chain is a parent of other bones
-      if (enterIKChain)
+        // turn on flag to update children that has parent inside IK chain
+        belowChain = true;
+      }
+      else if (belowChain) // IK chain is a parent of this bone
       {
         // apply hierarchically to all children that has parent inside IK chain
-        preOffSetMatrices[boneInfoMap[nodeName].id] =
-          parentTransform *
-          preOffSetMatrices[boneInfoMap[nodeName].id];
+        preOffSetMatrices[id] = parentTransform * preOffSetMatrices[id];
 
         // mesh skinning but need to adjust vertex weights otherwise arm will be squished
-        finalMatrices[boneInfoMap[nodeName].id] = preOffSetMatrices[boneInfoMap[nodeName].id] * boneInfoMap[nodeName].offset;
+        finalMatrices[id] = preOffSetMatrices[id] * skeleton.offset[i];
       }
     }
-  }
 
-  // go down the tree (DFS)
-  for (int i = 0; i < node->childrenCount; ++i)
-  {
-    ApplyTransformationHierarchy(&node->children[i],
-      intermediateValue,
-      keyFrame,
-      step,
-      preOffSetMatrices, parentTransform, enterIKChain);
+    m_ParentTransform[i] = parentTransform;
+    m_BelowChain[i] = belowChain;
   }
 }
 
-// get joints that are inside IK chain and its index
-bool InverseKinematicManager::isInsideIKChain(const std::string& name, int& index)
+void InverseKinematicManager::BuildChainIndex(int boneCount)
 {
   auto& ikChain = m_CCDSolver.getChain();
 
+  m_ChainIndex.assign(boneCount, -1);
   for (int i = 0; i < ikChain.size(); ++i)
   {
-    // if bone inside IK chain
-    if (ikChain[i].name == name)
-    {
-      // return index of bone inside IK chain
-      index = i;
-      return true;
-    }
+    if (ikChain[i].boneID >= 0 && ikChain[i].boneID < boneCount)
+      m_ChainIndex[ikChain[i].boneID] = i;
   }
-
-  return false;
 }
-
@@ -0,0 +1,204 @@
+#include "KDTree.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+  constexpr unsigned MAX_DIMENSION = 64; // queries are padded on the stack
+
+  struct SearchState
+  {
+    const float* query;
+    float offsets[MAX_DIMENSION]; // query to cell distance per split axis so far
+    float best;
+    int bestRow;
+  };
+}
+
+void KDTree::Clear()
+{
+  nodes_.clear();
+  rows_.clear();
+  index_.clear();
+  dimension_ = stride_ = 0;
+}
+
+bool KDTree::Empty() const
+{
+  return index_.empty();
+}
+
+unsigned KDTree::GetDimension() const
+{
+  return dimension_;
+}
+
+unsigned KDTree::GetCount() const
+{
+  return static_cast<unsigned>(index_.size());
+}
+
+void KDTree::Build(const std::vector<float>& points, unsigned dimension)
+{
+  Clear();
+  assert(dimension > 0 && dimension <= MAX_DIMENSION);
+  unsigned count = static_cast<unsigned>(points.size() / dimension);
+  if (count == 0)
+    return;
+
+  dimension_ = dimension;
+  stride_ = (dimension + 3) & ~3u;
+
+  std::vector<unsigned> order(count);
+  for (unsigned i = 0; i < count; ++i)
+    order[i] = i;
+
+  unsigned leafCount = (count + KDTREE_LEAF_SIZE - 1) / KDTREE_LEAF_SIZE;
+  nodes_.reserve(4 * leafCount);
+  nodes_.emplace_back();
+  BuildRec(0, 0, count, points, order);
+
+  // rows in leaf order, a leaf is one contiguous block
+  rows_.assign(static_cast<size_t>(count) * stride_, 0.f);
+  index_ = order;
+  for (unsigned i = 0; i < count; ++i)
+    std::copy_n(&points[static_cast<size_t>(order[i]) * dimension], dimension, &rows_[static_cast<size_t>(i) * stride_]);
+}
+
+// median split along the axis of widest spread
+void KDTree::BuildRec(unsigned nodeIndex, unsigned begin, unsigned end, const std::vector<float>& points,
+  std::vector<unsigned>& order)
+{
+  if (end - begin <= KDTREE_LEAF_SIZE)
+  {
+    nodes_[nodeIndex].first_ = begin;
+    nodes_[nodeIndex].count_ = end - begin;
+    return;
+  }
+
+  int axis = 0;
+  float widest = -1.f;
+  for (unsigned a = 0; a < dimension_; ++a)
+  {
+    float lo = std::numeric_limits<float>::max();
+    float hi = -std::numeric_limits<float>::max();
+    for (unsigned i = begin; i < end; ++i)
+    {
+      float v = points[static_cast<size_t>(order[i]) * dimension_ + a];
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+    }
+    if (hi - lo > widest)
+    {
+      widest = hi - lo;
+      axis = static_cast<int>(a);
+    }
+  }
+
+  unsigned mid = begin + (end - begin) / 2;
+  auto coordinate = [&](unsigned i) { return points[static_cast<size_t>(i) * dimension_ + axis]; };
+  std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+    [&](unsigned a, unsigned b) { return coordinate(a) < coordinate(b); });
+
+  unsigned left = static_cast<unsigned>(nodes_.size());
+  nodes_[nodeIndex].axis_ = axis;
+  nodes_[nodeIndex].split_ = coordinate(order[mid]);
+  nodes_[nodeIndex].first_ = left;
+  nodes_.emplace_back();
+  nodes_.emplace_back();
+  BuildRec(left, begin, mid, points, order);
+  BuildRec(left + 1, mid, end, points, order);
+}
+
+float KDTree::DistanceSq(const float* query, unsigned row) const
+{
+  const float* p = &rows_[static_cast<size_t>(row) * stride_];
+  __m128 sum = _mm_setzero_ps();
+  for (unsigned c = 0; c < stride_; c += 4)
+  {
+    __m128 d = _mm_sub_ps(_mm_loadu_ps(query + c), _mm_loadu_ps(p + c));
+    sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, sum);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+int KDTree::Nearest(const float* query, float& distSq) const
+{
+  distSq = std::numeric_limits<float>::max();
+  if (index_.empty())
+    return -1;
+
+  float padded[MAX_DIMENSION] = {};
+  std::copy_n(query, dimension_, padded);
+
+  SearchState search;
+  search.query = padded;
+  std::fill_n(search.offsets, dimension_, 0.f);
+  search.best = std::numeric_limits<float>::max();
+  search.bestRow = -1;
+
+  // depth first, the far child is only entered when its cell can still beat the best;
+  // the cell distance is updated one axis at a time (arya and mount)
+  auto visit = [&](auto& self, unsigned nodeIndex, float cellSq) -> void
+  {
+    const Node& node = nodes_[nodeIndex];
+    if (node.axis_ < 0)
+    {
+      for (unsigned i = node.first_; i < node.first_ + node.count_; ++i)
+      {
+        float d = DistanceSq(search.query, i);
+        if (d < search.best)
+        {
+          search.best = d;
+          search.bestRow = static_cast<int>(i);
+        }
+      }
+      return;
+    }
+
+    float diff = search.query[node.axis_] - node.split_;
+    unsigned nearChild = diff < 0.f ? node.first_ : node.first_ + 1;
+    self(self, nearChild, cellSq);
+
+    float old = search.offsets[node.axis_];
+    float farSq = cellSq - old * old + diff * diff;
+    if (farSq < search.best)
+    {
+      search.offsets[node.axis_] = diff;
+      self(self, nearChild == node.first_ ? node.first_ + 1 : node.first_, farSq);
+      search.offsets[node.axis_] = old;
+    }
+  };
+  visit(visit, 0, 0.f);
+
+  distSq = search.best;
+  // a nan in the query fails every comparison
+  if (search.bestRow < 0)
+    return -1;
+  return static_cast<int>(index_[search.bestRow]);
+}
+
+int KDTree::NearestBruteForce(const float* query, float& distSq) const
+{
+  distSq = std::numeric_limits<float>::max();
+  if (index_.empty())
+    return -1;
+
+  float padded[MAX_DIMENSION] = {};
+  std::copy_n(query, dimension_, padded);
+
+  int bestRow = -1;
+  for (unsigned i = 0; i < GetCount(); ++i)
+  {
+    float d = DistanceSq(padded, i);
+    if (d < distSq)
+    {
+      distSq = d;
+      bestRow = static_cast<int>(i);
+    }
+  }
+  return bestRow < 0 ? -1 : static_cast<int>(index_[bestRow]);
+}
@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+  uint64_t hash = seed;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+MappedFile::MappedFile(const std::string& path)
+{
+  Open(path);
+}
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+  Close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  file_ = file;
+  mapping_ = mapping;
+  data_ = static_cast<const unsigned char*>(view);
+  size_ = static_cast<size_t>(size.QuadPart);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file alive
+  if (view == MAP_FAILED)
+    return false;
+
+  mapping_ = view;
+  data_ = static_cast<const unsigned char*>(view);
+  size_ = static_cast<size_t>(info.st_size);
+#endif
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (!data_)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(static_cast<HANDLE>(mapping_));
+  CloseHandle(static_cast<HANDLE>(file_));
+#else
+  munmap(mapping_, size_);
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+  file_ = nullptr;
+  mapping_ = nullptr;
+}
+
+bool MappedFile::IsOpen() const
+{
+  return data_ != nullptr;
+}
+
+const unsigned char* MappedFile::Data() const
+{
+  return data_;
+}
+
+size_t MappedFile::Size() const
+{
+  return size_;
+}
@@ -31,7 +31,55 @@ Mesh::Mesh(std::vector<glm::vec3> position,
   setupFaceNormalDebug();
 }
 
+void Mesh::Release()
+{
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  if (skinnedVAO)
+  {
+    glDeleteVertexArrays(1, &skinnedVAO);
+    glDeleteBuffers(1, &skinnedVBO);
+    skinnedVAO = skinnedVBO = 0;
+    preSkinned = false;
+  }
+  glDeleteVertexArrays(1, &vertexNormalVAO);
+  glDeleteBuffers(1, &vertexNormalVBO);
+  glDeleteBuffers(1, &vertexNormalEBO);
+  glDeleteVertexArrays(1, &faceNormalVAO);
+  glDeleteBuffers(1, &faceNormalVBO);
+  glDeleteBuffers(1, &faceNormalEBO);
+}
+
 void Mesh::Draw(ShaderProgram* shader)
+{
+  BindTextures(shader);
+
+  glUniform1i(glGetUniformLocation(shader->programID, "preSkinned"), preSkinned);
+
+  // draw mesh
+  glBindVertexArray(preSkinned ? skinnedVAO : VAO);
+  glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+  glBindVertexArray(0);
+
+  // always good practice to set everything back to defaults once configured.
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawInstanced(ShaderProgram* shader, int instanceCount)
+{
+  BindTextures(shader);
+
+  glUniform1i(glGetUniformLocation(shader->programID, "preSkinned"), 0);
+
+  glBindVertexArray(VAO);
+  glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+  glBindVertexArray(0);
+
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::BindTextures(ShaderProgram* shader)
 {
   // bind appropriate textures
   unsigned int diffuseNr = 1;
@@ -58,14 +106,6 @@ void Mesh::Draw(ShaderProgram* shader)
     // and finally bind the texture
     glBindTexture(GL_TEXTURE_2D, textures[i].id);
   }
-
-  // draw mesh
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
-
-  // always good practice to set everything back to defaults once configured.
-  glActiveTexture(GL_TEXTURE0);
 }
 
 void Mesh::DrawVertexNormals()
@@ -237,6 +277,50 @@ void Mesh::setupMesh()
   //glBindVertexArray(0);
 }
 
+void Mesh::SetupSkinnedBuffer()
+{
+  if (skinnedVAO)
+    return;
+
+  size_t vertexCount = Position.size();
+  glCreateBuffers(1, &skinnedVBO);
+  glNamedBufferStorage(skinnedVBO, 2 * vertexCount * sizeof(glm::vec3), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+  glCreateVertexArrays(1, &skinnedVAO);
+
+  // position and normal from the skinned buffer
+  glEnableVertexArrayAttrib(skinnedVAO, 0);
+  glVertexArrayVertexBuffer(skinnedVAO, 0, skinnedVBO, 0, 2 * sizeof(glm::vec3));
+  glVertexArrayAttribFormat(skinnedVAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(skinnedVAO, 0, 0);
+
+  glEnableVertexArrayAttrib(skinnedVAO, 1);
+  glVertexArrayVertexBuffer(skinnedVAO, 1, skinnedVBO, sizeof(glm::vec3), 2 * sizeof(glm::vec3));
+  glVertexArrayAttribFormat(skinnedVAO, 1, 3, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(skinnedVAO, 1, 1);
+
+  // texture, tangent and bi-tangent from the bind pose buffer
+  size_t offset = Position.size() * sizeof(glm::vec3) + Normal.size() * sizeof(glm::vec3);
+  glEnableVertexArrayAttrib(skinnedVAO, 2);
+  glVertexArrayVertexBuffer(skinnedVAO, 2, VBO, offset, sizeof(glm::vec2));
+  glVertexArrayAttribFormat(skinnedVAO, 2, 2, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(skinnedVAO, 2, 2);
+
+  offset += TexCoords.size() * sizeof(glm::vec2);
+  glEnableVertexArrayAttrib(skinnedVAO, 3);
+  glVertexArrayVertexBuffer(skinnedVAO, 3, VBO, offset, sizeof(glm::vec3));
+  glVertexArrayAttribFormat(skinnedVAO, 3, 3, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(skinnedVAO, 3, 3);
+
+  offset += Tangent.size() * sizeof(glm::vec3);
+  glEnableVertexArrayAttrib(skinnedVAO, 4);
+  glVertexArrayVertexBuffer(skinnedVAO, 4, VBO, offset, sizeof(glm::vec3));
+  glVertexArrayAttribFormat(skinnedVAO, 4, 3, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(skinnedVAO, 4, 4);
+
+  glVertexArrayElementBuffer(skinnedVAO, EBO);
+}
+
 void Mesh::setupVertexNormalDebug()
 {
   for (int i = 0; i < static_cast<int>(Position.size()); ++i)
@@ -0,0 +1,568 @@
+#include "MeshBVH.h"
+#include <algorithm>
+#include <xmmintrin.h>
+
+namespace
+{
+  constexpr int STACK_SIZE = 64;
+  constexpr int BVTT_STACK_SIZE = 128;
+}
+
+MeshBVH::MeshBVH(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+  Build(vertices, indices);
+}
+
+void MeshBVH::Clear()
+{
+  nodes_.clear();
+  packets_.clear();
+  packetTriangles_.clear();
+}
+
+bool MeshBVH::Empty() const
+{
+  return nodes_.empty();
+}
+
+const std::vector<MeshBVH::Node>& MeshBVH::GetNodes() const
+{
+  return nodes_;
+}
+
+void MeshBVH::Build(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+{
+  Clear();
+
+  unsigned triangleCount = static_cast<unsigned>(indices.size() / 3);
+  if (triangleCount == 0)
+    return;
+
+  std::vector<glm::vec3> centroids(triangleCount);
+  std::vector<unsigned> triangles(triangleCount);
+  for (unsigned i = 0; i < triangleCount; ++i)
+  {
+    centroids[i] = (vertices[indices[3 * i]] + vertices[indices[3 * i + 1]] + vertices[indices[3 * i + 2]]) / 3.f;
+    triangles[i] = i;
+  }
+
+  // a full binary tree over n leaves has at most 2n - 1 nodes
+  unsigned leafCount = (triangleCount + BVH_LEAF_SIZE - 1) / BVH_LEAF_SIZE;
+  nodes_.reserve(2 * leafCount);
+  packets_.reserve(leafCount);
+  packetTriangles_.reserve(leafCount * BVH_LEAF_SIZE);
+
+  nodes_.emplace_back();
+  BuildRec(0, 0, triangleCount, vertices, indices, centroids, triangles);
+}
+
+// median split along longest axis of the centroid bounds
+void MeshBVH::BuildRec(unsigned nodeIndex, unsigned begin, unsigned end,
+  const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices,
+  const std::vector<glm::vec3>& centroids, std::vector<unsigned>& triangles)
+{
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(-std::numeric_limits<float>::max());
+  glm::vec3 cmin = min;
+  glm::vec3 cmax = max;
+  for (unsigned i = begin; i < end; ++i)
+  {
+    unsigned t = triangles[i];
+    for (unsigned c = 0; c < 3; ++c)
+    {
+      min = glm::min(min, vertices[indices[3 * t + c]]);
+      max = glm::max(max, vertices[indices[3 * t + c]]);
+    }
+    cmin = glm::min(cmin, centroids[t]);
+    cmax = glm::max(cmax, centroids[t]);
+  }
+  nodes_[nodeIndex].min_ = min;
+  nodes_[nodeIndex].max_ = max;
+
+  // leaf node, pack triangles into one simd packet
+  if (end - begin <= BVH_LEAF_SIZE)
+  {
+    nodes_[nodeIndex].first_ = static_cast<unsigned>(packets_.size());
+    nodes_[nodeIndex].count_ = end - begin;
+
+    ClosestPoint::Triangle4 packet;
+    for (unsigned lane = 0; lane < BVH_LEAF_SIZE; ++lane)
+    {
+      // unused lanes repeat the last triangle
+      unsigned t = triangles[std::min(begin + lane, end - 1)];
+      packet.Set(lane, vertices[indices[3 * t]], vertices[indices[3 * t + 1]], vertices[indices[3 * t + 2]]);
+      packetTriangles_.push_back(t);
+    }
+    packets_.push_back(packet);
+    return;
+  }
+
+  glm::vec3 extent = cmax - cmin;
+  int axis = 0;
+  if (extent.y > extent[axis])
+    axis = 1;
+  if (extent.z > extent[axis])
+    axis = 2;
+
+  unsigned mid = begin + (end - begin) / 2;
+  std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+    [&centroids, axis](unsigned a, unsigned b)
+    {
+      return centroids[a][axis] < centroids[b][axis];
+    });
+
+  unsigned left = static_cast<unsigned>(nodes_.size());
+  nodes_.emplace_back();
+  nodes_.emplace_back();
+  nodes_[nodeIndex].first_ = left;
+  nodes_[nodeIndex].count_ = 0;
+
+  BuildRec(left, begin, mid, vertices, indices, centroids, triangles);
+  BuildRec(left + 1, mid, end, vertices, indices, centroids, triangles);
+}
+
+bool MeshBVH::ClosestPoint(const glm::vec3& P, Hit& out, float maxDist) const
+{
+  if (nodes_.empty())
+    return false;
+
+  float best = maxDist == std::numeric_limits<float>::max() ? maxDist : maxDist * maxDist;
+  bool found = false;
+
+  unsigned stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const Node& node = nodes_[stack[--top]];
+    if (ClosestPoint::PointAABBDistSq(P, node.min_, node.max_) > best)
+      continue;
+
+    if (node.count_)
+    {
+      float distSq[4];
+      glm::vec3 points[4];
+      ClosestPoint::PointTriangle4(P, packets_[node.first_], distSq, points);
+      for (unsigned lane = 0; lane < node.count_; ++lane)
+      {
+        if (distSq[lane] < best)
+        {
+          best = distSq[lane];
+          out.point_ = points[lane];
+          out.distSq_ = distSq[lane];
+          out.triangle_ = packetTriangles_[node.first_ * BVH_LEAF_SIZE + lane];
+          found = true;
+        }
+      }
+      continue;
+    }
+
+    // push farther child first so the nearer one is visited next
+    const Node& left = nodes_[node.first_];
+    const Node& right = nodes_[node.first_ + 1];
+    float dl = ClosestPoint::PointAABBDistSq(P, left.min_, left.max_);
+    float dr = ClosestPoint::PointAABBDistSq(P, right.min_, right.max_);
+    if (dl <= dr)
+    {
+      if (dr <= best) stack[top++] = node.first_ + 1;
+      if (dl <= best) stack[top++] = node.first_;
+    }
+    else
+    {
+      if (dl <= best) stack[top++] = node.first_;
+      if (dr <= best) stack[top++] = node.first_ + 1;
+    }
+  }
+  return found;
+}
+
+void MeshBVH::KNearest(const glm::vec3& P, unsigned k, std::vector<Hit>& out) const
+{
+  out.clear();
+  if (nodes_.empty() || k == 0)
+    return;
+
+  // max-heap on distance, top is the current k-th nearest
+  auto farther = [](const Hit& a, const Hit& b) { return a.distSq_ < b.distSq_; };
+  out.reserve(k);
+  float bound = std::numeric_limits<float>::max();
+
+  unsigned stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const Node& node = nodes_[stack[--top]];
+    if (ClosestPoint::PointAABBDistSq(P, node.min_, node.max_) > bound)
+      continue;
+
+    if (node.count_)
+    {
+      float distSq[4];
+      glm::vec3 points[4];
+      ClosestPoint::PointTriangle4(P, packets_[node.first_], distSq, points);
+      for (unsigned lane = 0; lane < node.count_; ++lane)
+      {
+        if (out.size() == k && distSq[lane] >= bound)
+          continue;
+        if (out.size() == k)
+        {
+          std::pop_heap(out.begin(), out.end(), farther);
+          out.pop_back();
+        }
+        out.push_back({ points[lane], distSq[lane], packetTriangles_[node.first_ * BVH_LEAF_SIZE + lane] });
+        std::push_heap(out.begin(), out.end(), farther);
+        if (out.size() == k)
+          bound = out.front().distSq_;
+      }
+      continue;
+    }
+
+    const Node& left = nodes_[node.first_];
+    const Node& right = nodes_[node.first_ + 1];
+    float dl = ClosestPoint::PointAABBDistSq(P, left.min_, left.max_);
+    float dr = ClosestPoint::PointAABBDistSq(P, right.min_, right.max_);
+    if (dl <= dr)
+    {
+      if (dr <= bound) stack[top++] = node.first_ + 1;
+      if (dl <= bound) stack[top++] = node.first_;
+    }
+    else
+    {
+      if (dl <= bound) stack[top++] = node.first_;
+      if (dr <= bound) stack[top++] = node.first_ + 1;
+    }
+  }
+  std::sort_heap(out.begin(), out.end(), farther);
+}
+
+void MeshBVH::WithinRadius(const glm::vec3& P, float radius, std::vector<Hit>& out) const
+{
+  out.clear();
+  if (nodes_.empty())
+    return;
+
+  float radiusSq = radius * radius;
+
+  unsigned stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const Node& node = nodes_[stack[--top]];
+    if (ClosestPoint::PointAABBDistSq(P, node.min_, node.max_) > radiusSq)
+      continue;
+
+    if (node.count_)
+    {
+      float distSq[4];
+      glm::vec3 points[4];
+      ClosestPoint::PointTriangle4(P, packets_[node.first_], distSq, points);
+      for (unsigned lane = 0; lane < node.count_; ++lane)
+      {
+        if (distSq[lane] <= radiusSq)
+          out.push_back({ points[lane], distSq[lane], packetTriangles_[node.first_ * BVH_LEAF_SIZE + lane] });
+      }
+      continue;
+    }
+    stack[top++] = node.first_;
+    stack[top++] = node.first_ + 1;
+  }
+}
+
+namespace
+{
+  // interval of a triangle on the intersection line of both planes, false if coplanar
+  bool ComputeInterval(float vv0, float vv1, float vv2, float d0, float d1, float d2, float d0d1, float d0d2,
+    float& a, float& b, float& c, float& x0, float& x1)
+  {
+    if (d0d1 > 0.f)
+    {
+      // d0, d1 on the same side, d2 on the other or on the plane
+      a = vv2; b = (vv0 - vv2) * d2; c = (vv1 - vv2) * d2; x0 = d2 - d0; x1 = d2 - d1;
+    }
+    else if (d0d2 > 0.f)
+    {
+      a = vv1; b = (vv0 - vv1) * d1; c = (vv2 - vv1) * d1; x0 = d1 - d0; x1 = d1 - d2;
+    }
+    else if (d1 * d2 > 0.f || d0 != 0.f)
+    {
+      a = vv0; b = (vv1 - vv0) * d0; c = (vv2 - vv0) * d0; x0 = d0 - d1; x1 = d0 - d2;
+    }
+    else if (d1 != 0.f)
+    {
+      a = vv1; b = (vv0 - vv1) * d1; c = (vv2 - vv1) * d1; x0 = d1 - d0; x1 = d1 - d2;
+    }
+    else if (d2 != 0.f)
+    {
+      a = vv2; b = (vv0 - vv2) * d2; c = (vv1 - vv2) * d2; x0 = d2 - d0; x1 = d2 - d1;
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+
+  // 2d segment test of edge V0-V1 (as ax, ay) against edge U0-U1 in projection (i0, i1)
+  bool EdgeEdge(const glm::vec3& V0, const glm::vec3& U0, const glm::vec3& U1, float ax, float ay, int i0, int i1)
+  {
+    float bx = U0[i0] - U1[i0];
+    float by = U0[i1] - U1[i1];
+    float cx = V0[i0] - U0[i0];
+    float cy = V0[i1] - U0[i1];
+    float f = ay * bx - ax * by;
+    float d = by * cx - bx * cy;
+    if ((f > 0.f && d >= 0.f && d <= f) || (f < 0.f && d <= 0.f && d >= f))
+    {
+      float e = ax * cy - ay * cx;
+      if (f > 0.f)
+        return e >= 0.f && e <= f;
+      return e <= 0.f && e >= f;
+    }
+    return false;
+  }
+
+  bool EdgeTriangle(const glm::vec3& V0, const glm::vec3& V1, const glm::vec3& U0, const glm::vec3& U1,
+    const glm::vec3& U2, int i0, int i1)
+  {
+    float ax = V1[i0] - V0[i0];
+    float ay = V1[i1] - V0[i1];
+    return EdgeEdge(V0, U0, U1, ax, ay, i0, i1) || EdgeEdge(V0, U1, U2, ax, ay, i0, i1) ||
+      EdgeEdge(V0, U2, U0, ax, ay, i0, i1);
+  }
+
+  bool PointInTriangle(const glm::vec3& V0, const glm::vec3& U0, const glm::vec3& U1, const glm::vec3& U2, int i0, int i1)
+  {
+    const glm::vec3* U[3] = { &U0, &U1, &U2 };
+    float d[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      const glm::vec3& A = *U[i];
+      const glm::vec3& B = *U[(i + 1) % 3];
+      float a = B[i1] - A[i1];
+      float b = -(B[i0] - A[i0]);
+      float c = -a * A[i0] - b * A[i1];
+      d[i] = a * V0[i0] + b * V0[i1] + c;
+    }
+    return d[0] * d[1] > 0.f && d[0] * d[2] > 0.f;
+  }
+
+  // both triangles on one plane, project onto the axis aligned plane where they are largest
+  bool CoplanarTriangles(const glm::vec3& N, const glm::vec3& V0, const glm::vec3& V1, const glm::vec3& V2,
+    const glm::vec3& U0, const glm::vec3& U1, const glm::vec3& U2)
+  {
+    glm::vec3 A = glm::abs(N);
+    int i0, i1;
+    if (A.x > A.y)
+    {
+      if (A.x > A.z) { i0 = 1; i1 = 2; }
+      else { i0 = 0; i1 = 1; }
+    }
+    else
+    {
+      if (A.z > A.y) { i0 = 0; i1 = 1; }
+      else { i0 = 0; i1 = 2; }
+    }
+
+    if (EdgeTriangle(V0, V1, U0, U1, U2, i0, i1) || EdgeTriangle(V1, V2, U0, U1, U2, i0, i1) ||
+      EdgeTriangle(V2, V0, U0, U1, U2, i0, i1))
+      return true;
+
+    // one triangle fully inside the other
+    return PointInTriangle(V0, U0, U1, U2, i0, i1) || PointInTriangle(U0, V0, V1, V2, i0, i1);
+  }
+
+  // moller's interval overlap test, distances close to a plane snap to it
+  bool TriangleTriangle(const glm::vec3& V0, const glm::vec3& V1, const glm::vec3& V2,
+    const glm::vec3& U0, const glm::vec3& U1, const glm::vec3& U2)
+  {
+    const float tolerance = 0.000001f;
+
+    // plane of V, reject if U is fully on one side
+    glm::vec3 N1 = glm::cross(V1 - V0, V2 - V0);
+    float d1 = -glm::dot(N1, V0);
+    float eps1 = tolerance * glm::length(N1) * glm::max(glm::length(V1 - V0), glm::length(V2 - V0));
+    float du0 = glm::dot(N1, U0) + d1;
+    float du1 = glm::dot(N1, U1) + d1;
+    float du2 = glm::dot(N1, U2) + d1;
+    if (std::abs(du0) < eps1) du0 = 0.f;
+    if (std::abs(du1) < eps1) du1 = 0.f;
+    if (std::abs(du2) < eps1) du2 = 0.f;
+    float du0du1 = du0 * du1;
+    float du0du2 = du0 * du2;
+    if (du0du1 > 0.f && du0du2 > 0.f)
+      return false;
+
+    // plane of U, reject if V is fully on one side
+    glm::vec3 N2 = glm::cross(U1 - U0, U2 - U0);
+    float d2 = -glm::dot(N2, U0);
+    float eps2 = tolerance * glm::length(N2) * glm::max(glm::length(U1 - U0), glm::length(U2 - U0));
+    float dv0 = glm::dot(N2, V0) + d2;
+    float dv1 = glm::dot(N2, V1) + d2;
+    float dv2 = glm::dot(N2, V2) + d2;
+    if (std::abs(dv0) < eps2) dv0 = 0.f;
+    if (std::abs(dv1) < eps2) dv1 = 0.f;
+    if (std::abs(dv2) < eps2) dv2 = 0.f;
+    float dv0dv1 = dv0 * dv1;
+    float dv0dv2 = dv0 * dv2;
+    if (dv0dv1 > 0.f && dv0dv2 > 0.f)
+      return false;
+
+    // project onto the largest axis of the intersection line direction
+    glm::vec3 D = glm::abs(glm::cross(N1, N2));
+    int index = 0;
+    if (D.y > D[index]) index = 1;
+    if (D.z > D[index]) index = 2;
+
+    float a, b, c, x0, x1;
+    if (!ComputeInterval(V0[index], V1[index], V2[index], dv0, dv1, dv2, dv0dv1, dv0dv2, a, b, c, x0, x1))
+      return CoplanarTriangles(N1, V0, V1, V2, U0, U1, U2);
+    float d, e, f, y0, y1;
+    if (!ComputeInterval(U0[index], U1[index], U2[index], du0, du1, du2, du0du1, du0du2, d, e, f, y0, y1))
+      return CoplanarTriangles(N1, V0, V1, V2, U0, U1, U2);
+
+    float xx = x0 * x1;
+    float yy = y0 * y1;
+    float xxyy = xx * yy;
+
+    float tmp = a * xxyy;
+    float isect1[2] = { tmp + b * x1 * yy, tmp + c * x0 * yy };
+    tmp = d * xxyy;
+    float isect2[2] = { tmp + e * xx * y1, tmp + f * xx * y0 };
+    if (isect1[0] > isect1[1]) std::swap(isect1[0], isect1[1]);
+    if (isect2[0] > isect2[1]) std::swap(isect2[0], isect2[1]);
+
+    return !(isect1[1] < isect2[0] || isect2[1] < isect1[0]);
+  }
+
+  // world aabb of a box under an affine transform
+  void TransformBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4& M, glm::vec3& outMin, glm::vec3& outMax)
+  {
+    glm::vec3 center = glm::vec3(M * glm::vec4(0.5f * (min + max), 1.f));
+    glm::vec3 half = 0.5f * (max - min);
+    glm::vec3 extent;
+    for (int i = 0; i < 3; ++i)
+      extent[i] = std::abs(M[0][i]) * half.x + std::abs(M[1][i]) * half.y + std::abs(M[2][i]) * half.z;
+    outMin = center - extent;
+    outMax = center + extent;
+  }
+
+  bool Overlap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+  {
+    return minA.x <= maxB.x && minB.x <= maxA.x &&
+      minA.y <= maxB.y && minB.y <= maxA.y &&
+      minA.z <= maxB.z && minB.z <= maxA.z;
+  }
+
+  // lanes of the packet not fully on one side of plane (n, d)
+  int StraddlingLanes(const ClosestPoint::Triangle4& tri, const glm::vec3& n, float d)
+  {
+    const __m128 zero = _mm_setzero_ps();
+    __m128 nx = _mm_set1_ps(n.x), ny = _mm_set1_ps(n.y), nz = _mm_set1_ps(n.z), nd = _mm_set1_ps(d);
+    auto side = [&](const float* x, const float* y, const float* z)
+    {
+      return _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(x)), _mm_mul_ps(ny, _mm_load_ps(y))),
+        _mm_add_ps(_mm_mul_ps(nz, _mm_load_ps(z)), nd));
+    };
+    __m128 da = side(tri.ax, tri.ay, tri.az);
+    __m128 db = side(tri.bx, tri.by, tri.bz);
+    __m128 dc = side(tri.cx, tri.cy, tri.cz);
+    __m128 above = _mm_and_ps(_mm_cmpgt_ps(da, zero), _mm_and_ps(_mm_cmpgt_ps(db, zero), _mm_cmpgt_ps(dc, zero)));
+    __m128 below = _mm_and_ps(_mm_cmplt_ps(da, zero), _mm_and_ps(_mm_cmplt_ps(db, zero), _mm_cmplt_ps(dc, zero)));
+    return ~_mm_movemask_ps(_mm_or_ps(above, below)) & 0xF;
+  }
+
+  glm::vec3 Lane(const float* x, const float* y, const float* z, unsigned lane)
+  {
+    return { x[lane], y[lane], z[lane] };
+  }
+}
+
+bool MeshBVH::Intersect(const MeshBVH& other, const glm::mat4& otherToThis, const glm::vec3& regionMin,
+  const glm::vec3& regionMax, std::vector<TrianglePair>* pairs) const
+{
+  if (nodes_.empty() || other.nodes_.empty())
+    return false;
+
+  bool found = false;
+  unsigned stack[BVTT_STACK_SIZE][2];
+  int top = 0;
+  stack[top][0] = 0;
+  stack[top][1] = 0;
+  ++top;
+
+  while (top > 0)
+  {
+    --top;
+    const Node& A = nodes_[stack[top][0]];
+    const Node& B = other.nodes_[stack[top][1]];
+    unsigned a = stack[top][0];
+    unsigned b = stack[top][1];
+
+    if (!Overlap(A.min_, A.max_, regionMin, regionMax))
+      continue;
+    glm::vec3 bMin, bMax;
+    TransformBox(B.min_, B.max_, otherToThis, bMin, bMax);
+    if (!Overlap(A.min_, A.max_, bMin, bMax))
+      continue;
+
+    if (A.count_ && B.count_)
+    {
+      const ClosestPoint::Triangle4& packetA = packets_[A.first_];
+      const ClosestPoint::Triangle4& packetB = other.packets_[B.first_];
+      for (unsigned j = 0; j < B.count_; ++j)
+      {
+        glm::vec3 U0 = glm::vec3(otherToThis * glm::vec4(Lane(packetB.ax, packetB.ay, packetB.az, j), 1.f));
+        glm::vec3 U1 = glm::vec3(otherToThis * glm::vec4(Lane(packetB.bx, packetB.by, packetB.bz, j), 1.f));
+        glm::vec3 U2 = glm::vec3(otherToThis * glm::vec4(Lane(packetB.cx, packetB.cy, packetB.cz, j), 1.f));
+
+        // 4 triangles of this leaf against the plane of U in one go
+        glm::vec3 n = glm::cross(U1 - U0, U2 - U0);
+        int lanes = StraddlingLanes(packetA, n, -glm::dot(n, U0)) & ((1 << A.count_) - 1);
+        for (unsigned i = 0; lanes; ++i, lanes >>= 1)
+        {
+          if (!(lanes & 1))
+            continue;
+          glm::vec3 V0 = Lane(packetA.ax, packetA.ay, packetA.az, i);
+          glm::vec3 V1 = Lane(packetA.bx, packetA.by, packetA.bz, i);
+          glm::vec3 V2 = Lane(packetA.cx, packetA.cy, packetA.cz, i);
+          if (!Overlap(glm::min(V0, glm::min(V1, V2)), glm::max(V0, glm::max(V1, V2)), regionMin, regionMax))
+            continue;
+          if (!TriangleTriangle(V0, V1, V2, U0, U1, U2))
+            continue;
+
+          found = true;
+          if (!pairs)
+            return true;
+          pairs->push_back({ packetTriangles_[A.first_ * BVH_LEAF_SIZE + i],
+            other.packetTriangles_[B.first_ * BVH_LEAF_SIZE + j] });
+        }
+      }
+      continue;
+    }
+
+    if (top + 2 > BVTT_STACK_SIZE)
+      continue;
+
+    // descend the larger internal node
+    glm::vec3 extentA = A.max_ - A.min_;
+    glm::vec3 extentB = bMax - bMin;
+    bool descendA = !A.count_ && (B.count_ ||
+      extentA.x * extentA.y * extentA.z >= extentB.x * extentB.y * extentB.z);
+    if (descendA)
+    {
+      stack[top][0] = A.first_; stack[top][1] = b; ++top;
+      stack[top][0] = A.first_ + 1; stack[top][1] = b; ++top;
+    }
+    else
+    {
+      stack[top][0] = a; stack[top][1] = B.first_; ++top;
+      stack[top][0] = a; stack[top][1] = B.first_ + 1; ++top;
+    }
+  }
+  return found;
+}
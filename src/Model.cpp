@@ -23,12 +23,24 @@ Model::Model(std::string const& path, bool gamma) : gammaCorrection(gamma)
   loadModel(path);
 }
 
+Model::~Model()
+{
+  for (auto& mesh : meshes)
+    mesh.Release();
+}
+
 void Model::Draw(ShaderProgram* shader)
 {
   for (unsigned int i = 0; i < meshes.size(); i++)
     meshes[i].Draw(shader);
 }
 
+void Model::DrawInstanced(ShaderProgram* shader, int instanceCount)
+{
+  for (unsigned int i = 0; i < meshes.size(); i++)
+    meshes[i].DrawInstanced(shader, instanceCount);
+}
+
 void Model::DrawVertexNormals()
 {
   for (unsigned int i = 0; i < meshes.size(); i++)
@@ -230,15 +242,44 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType
   return textures;
 }
 
-// animation
-std::map<std::string, BoneInfo>& Model::getBoneInfoMap()
+int BoneTable::Intern(const std::string& name, const glm::mat4& offset)
+{
+  auto it = m_IDs.find(name);
+  if (it != m_IDs.end())
+    return it->second;
+
+  int id = static_cast<int>(m_Names.size());
+  m_IDs.emplace(name, id);
+  m_Names.push_back(name);
+  m_Offsets.push_back(offset);
+  return id;
+}
+
+int BoneTable::Find(const std::string& name) const
+{
+  auto it = m_IDs.find(name);
+  return it != m_IDs.end() ? it->second : -1;
+}
+
+int BoneTable::Size() const
+{
+  return static_cast<int>(m_Names.size());
+}
+
+const std::string& BoneTable::Name(int id) const
 {
-  return m_BoneInfoMap;
+  return m_Names[id];
 }
 
-int& Model::getBoneCount()
+const glm::mat4& BoneTable::Offset(int id) const
 {
-  return m_BoneCounter;
+  return m_Offsets[id];
+}
+
+// animation
+BoneTable& Model::getBoneTable()
+{
+  return m_BoneTable;
 }
 
 void Model::SetVertexBoneDataToDefault(glm::ivec4& m_BoneIDs, glm::vec4& m_Weights)
@@ -267,21 +308,8 @@ void Model::ExtractBoneWeightForVertices(std::vector<glm::ivec4>& m_BoneIDs, std
 {
   for (int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
   {
-    int boneID = -1;
-    std::string boneName = mesh->mBones[boneIndex]->mName.C_Str();
-    if (m_BoneInfoMap.find(boneName) == m_BoneInfoMap.end())
-    {
-      BoneInfo newBoneInfo;
-      newBoneInfo.id = m_BoneCounter;
-      newBoneInfo.offset = AssimpHelper::ConvertRowMajorToColumnMajor(mesh->mBones[boneIndex]->mOffsetMatrix);
-      m_BoneInfoMap[boneName] = newBoneInfo;
-      boneID = m_BoneCounter;
-      m_BoneCounter++;
-    }
-    else
-    {
-      boneID = m_BoneInfoMap[boneName].id;
-    }
+    int boneID = m_BoneTable.Intern(mesh->mBones[boneIndex]->mName.C_Str(),
+      AssimpHelper::ConvertRowMajorToColumnMajor(mesh->mBones[boneIndex]->mOffsetMatrix));
     assert(boneID != -1);
     auto weights = mesh->mBones[boneIndex]->mWeights;
     int numWeights = mesh->mBones[boneIndex]->mNumWeights;
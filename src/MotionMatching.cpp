@@ -0,0 +1,327 @@
+#include "MotionMatching.h"
+#include "Animator.h"
+#include "SkeletalAnimation.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+  // feature groups share one deviation so a group is not dominated by its noisiest axis
+  struct FeatureGroup
+  {
+    int first;
+    int count;
+  };
+  constexpr int LEFT_FOOT = 0;
+  constexpr int RIGHT_FOOT = 3;
+  constexpr int HIP_VELOCITY = 6;
+  constexpr int TRAJECTORY_POSITION = 9;
+  constexpr int TRAJECTORY_DIRECTION = TRAJECTORY_POSITION + 2 * MotionMatching::TRAJECTORY_SAMPLES;
+  constexpr FeatureGroup FEATURE_GROUPS[] =
+  {
+    { LEFT_FOOT, 3 },
+    { RIGHT_FOOT, 3 },
+    { HIP_VELOCITY, 3 },
+    { TRAJECTORY_POSITION, 2 * MotionMatching::TRAJECTORY_SAMPLES },
+    { TRAJECTORY_DIRECTION, 2 * MotionMatching::TRAJECTORY_SAMPLES },
+  };
+
+  float TicksPerSecond(SkeletalAnimation* clip)
+  {
+    float ticks = clip->GetTicksPerSecond();
+    return ticks > 0.f ? ticks : 25.f; // assimp leaves it 0 for some formats
+  }
+
+  // palette slot of the shortest bone name containing key, -1 when none does
+  int FindBone(SkeletalAnimation* clip, const std::string& key)
+  {
+    auto lower = [](std::string s)
+    {
+      std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+      return s;
+    };
+    std::string wanted = lower(key);
+    int id = -1;
+    size_t length = 0;
+    const BoneTable& bones = clip->GetBoneTable();
+    for (int i = 0; i < bones.Size(); ++i)
+    {
+      const std::string& name = bones.Name(i);
+      if (lower(name).find(wanted) == std::string::npos)
+        continue;
+      if (id < 0 || name.size() < length)
+      {
+        id = i;
+        length = name.size();
+      }
+    }
+    return id;
+  }
+
+  glm::vec2 Heading(const glm::vec2& v)
+  {
+    float length = glm::length(v);
+    return length > 1e-4f ? v / length : glm::vec2(0.f, 1.f);
+  }
+}
+
+void MotionMatching::Clear()
+{
+  m_Clips.clear();
+  m_ClipFirstFrame.clear();
+  m_Frames.clear();
+  m_Features.clear();
+  m_Tree.Clear();
+  m_HipBone = -1;
+  m_Layers.clear();
+  m_ActiveLayer = -1;
+  m_SearchTimer = 0.f;
+  matchedFrame = -1;
+  transitions = 0;
+}
+
+bool MotionMatching::Empty() const
+{
+  return m_Frames.empty();
+}
+
+int MotionMatching::GetFrameCount() const
+{
+  return static_cast<int>(m_Frames.size());
+}
+
+bool MotionMatching::Build(const std::vector<SkeletalAnimation*>& clips, const Settings& s)
+{
+  Clear();
+  settings = s;
+  float rate = settings.sampleRate;
+
+  std::vector<float> raw;
+  for (size_t c = 0; c < clips.size(); ++c)
+  {
+    SkeletalAnimation* clip = clips[c];
+    int leftFoot = FindBone(clip, settings.leftFoot);
+    int rightFoot = FindBone(clip, settings.rightFoot);
+    int hips = FindBone(clip, settings.hips);
+    if (leftFoot < 0 || rightFoot < 0 || hips < 0)
+    {
+      Clear();
+      return false;
+    }
+    if (c == 0)
+      m_HipBone = hips;
+
+    float ticks = TicksPerSecond(clip);
+    int count = std::max(1, static_cast<int>(clip->GetDuration() / ticks * rate));
+    m_Clips.push_back(clip);
+    m_ClipFirstFrame.push_back(static_cast<int>(m_Frames.size()));
+
+    // model space joint positions of every frame
+    std::vector<glm::vec3> hip(count), left(count), right(count);
+    Animator sampler(clip);
+    for (int f = 0; f < count; ++f)
+    {
+      float time = f / rate * ticks;
+      sampler.Seek(time);
+      sampler.CalculateBoneTransforms();
+      const std::vector<glm::mat4>& globals = sampler.GetPreOffSetMatrices();
+      hip[f] = glm::vec3(globals[hips][3]);
+      left[f] = glm::vec3(globals[leftFoot][3]);
+      right[f] = glm::vec3(globals[rightFoot][3]);
+      m_Frames.push_back({ static_cast<int>(c), time });
+    }
+
+    // root velocity is the hip moving relative to the lower, planted foot; the same formula
+    // holds for in place clips (the foot slides back) and root motion (the hip moves)
+    auto clamped = [count](int f) { return std::min(std::max(f, 0), count - 1); };
+    auto wrapped = [count](int f) { return (f % count + count) % count; };
+    std::vector<glm::vec3> hipVelocity(count);
+    std::vector<glm::vec2> rootVelocity(count);
+    for (int f = 0; f < count; ++f)
+    {
+      int prev = clamped(f - 1);
+      int next = clamped(f + 1);
+      float span = std::max(next - prev, 1) / rate;
+      const std::vector<glm::vec3>& planted = left[f].y < right[f].y ? left : right;
+      hipVelocity[f] = (hip[next] - hip[prev]) / span;
+      glm::vec3 v = hipVelocity[f] - (planted[next] - planted[prev]) / span;
+      rootVelocity[f] = glm::vec2(v.x, v.z);
+    }
+    // the planted foot switches every step, average it out over a few frames
+    std::vector<glm::vec2> smoothed(count);
+    const int window = 2;
+    for (int f = 0; f < count; ++f)
+    {
+      glm::vec2 sum(0.f);
+      for (int k = -window; k <= window; ++k)
+        sum += rootVelocity[clamped(f + k)];
+      smoothed[f] = sum / static_cast<float>(2 * window + 1);
+    }
+
+    int stepFrames = std::max(1, static_cast<int>(std::round(settings.trajectoryStep * rate)));
+    for (int f = 0; f < count; ++f)
+    {
+      float features[FEATURE_COUNT];
+      glm::vec3 root(hip[f].x, 0.f, hip[f].z);
+      glm::vec3 l = left[f] - root;
+      glm::vec3 r = right[f] - root;
+      std::copy_n(&l.x, 3, features + LEFT_FOOT);
+      std::copy_n(&r.x, 3, features + RIGHT_FOOT);
+      features[HIP_VELOCITY] = smoothed[f].x;
+      features[HIP_VELOCITY + 1] = hipVelocity[f].y;
+      features[HIP_VELOCITY + 2] = smoothed[f].y;
+
+      // clips loop, the trajectory carries on from the start
+      glm::vec2 position(0.f);
+      int ahead = f;
+      for (int k = 0; k < TRAJECTORY_SAMPLES; ++k)
+      {
+        for (int j = 0; j < stepFrames; ++j)
+          position += smoothed[wrapped(++ahead)] / rate;
+        glm::vec2 heading = Heading(smoothed[wrapped(ahead)]);
+        features[TRAJECTORY_POSITION + 2 * k] = position.x;
+        features[TRAJECTORY_POSITION + 2 * k + 1] = position.y;
+        features[TRAJECTORY_DIRECTION + 2 * k] = heading.x;
+        features[TRAJECTORY_DIRECTION + 2 * k + 1] = heading.y;
+      }
+      raw.insert(raw.end(), features, features + FEATURE_COUNT);
+    }
+  }
+  m_ClipFirstFrame.push_back(static_cast<int>(m_Frames.size()));
+  if (m_Frames.empty())
+    return false;
+
+  // zero mean, unit deviation per group, then weighted
+  size_t frameCount = m_Frames.size();
+  for (int i = 0; i < FEATURE_COUNT; ++i)
+  {
+    double sum = 0.0;
+    for (size_t f = 0; f < frameCount; ++f)
+      sum += raw[f * FEATURE_COUNT + i];
+    m_Offset[i] = static_cast<float>(sum / frameCount);
+  }
+  const float weights[] = { settings.footWeight, settings.footWeight, settings.hipVelocityWeight,
+    settings.trajectoryPositionWeight, settings.trajectoryDirectionWeight };
+  for (int g = 0; g < 5; ++g)
+  {
+    const FeatureGroup& group = FEATURE_GROUPS[g];
+    double variance = 0.0;
+    for (size_t f = 0; f < frameCount; ++f)
+    {
+      for (int i = group.first; i < group.first + group.count; ++i)
+      {
+        double d = raw[f * FEATURE_COUNT + i] - m_Offset[i];
+        variance += d * d;
+      }
+    }
+    float deviation = static_cast<float>(std::sqrt(variance / (frameCount * group.count)));
+    // a group that never changes cannot tell frames apart, leave it out of the cost
+    float scale = deviation > 1e-4f ? weights[g] / deviation : 0.f;
+    for (int i = group.first; i < group.first + group.count; ++i)
+      m_Scale[i] = scale;
+  }
+
+  m_Features.resize(raw.size());
+  for (size_t f = 0; f < frameCount; ++f)
+    Normalize(&raw[f * FEATURE_COUNT], &m_Features[f * FEATURE_COUNT]);
+  m_Tree.Build(m_Features, FEATURE_COUNT);
+  return true;
+}
+
+void MotionMatching::Normalize(const float* raw, float* normalized) const
+{
+  for (int i = 0; i < FEATURE_COUNT; ++i)
+    normalized[i] = (raw[i] - m_Offset[i]) * m_Scale[i];
+}
+
+void MotionMatching::Attach(Animator& animator)
+{
+  if (Empty())
+    return;
+
+  // restarting on the same animator reuses the layers of the last attach, they are only
+  // added again when the animator has been reset since
+  bool attached = !m_Layers.empty();
+  for (size_t i = 0; attached && i < m_Layers.size(); ++i)
+    attached = m_Layers[i] < animator.GetLayerCount() && animator.GetLayerClip(m_Layers[i]) == m_Clips[i / 2];
+  if (!attached)
+  {
+    m_Layers.clear();
+    for (SkeletalAnimation* clip : m_Clips)
+    {
+      m_Layers.push_back(animator.AddLayer(clip));
+      m_Layers.push_back(animator.AddLayer(clip));
+    }
+  }
+
+  // take over from the first clip where the animator is now
+  m_ActiveLayer = 0;
+  animator.SeekLayer(m_Layers[0], animator.GetLayerTime(0));
+  animator.CrossFade(m_Layers[0], settings.blendTime);
+  m_SearchTimer = 0.f;
+}
+
+int MotionMatching::CurrentFrame(const Animator& animator) const
+{
+  int clip = m_ActiveLayer / 2;
+  int first = m_ClipFirstFrame[clip];
+  int count = m_ClipFirstFrame[clip + 1] - first;
+  float seconds = animator.GetLayerTime(m_Layers[m_ActiveLayer]) / TicksPerSecond(m_Clips[clip]);
+  return first + static_cast<int>(std::round(seconds * settings.sampleRate)) % count;
+}
+
+void MotionMatching::Update(Animator& animator, const Trajectory& desired, float dt)
+{
+  if (Empty() || m_ActiveLayer < 0)
+    return;
+  m_SearchTimer += dt;
+  if (m_SearchTimer < settings.searchInterval)
+    return;
+  m_SearchTimer = 0.f;
+
+  // pose of the playing frame, trajectory from the path relative to the current root
+  int current = CurrentFrame(animator);
+  float query[FEATURE_COUNT];
+  std::copy_n(&m_Features[static_cast<size_t>(current) * FEATURE_COUNT], TRAJECTORY_POSITION, query);
+  glm::vec3 hip = glm::vec3(animator.GetPreOffSetMatrices()[m_HipBone][3]);
+  glm::vec2 root(hip.x, hip.z);
+  for (int k = 0; k < TRAJECTORY_SAMPLES; ++k)
+  {
+    glm::vec2 position = desired.position[k] - root;
+    glm::vec2 heading = Heading(desired.direction[k]);
+    int p = TRAJECTORY_POSITION + 2 * k;
+    int d = TRAJECTORY_DIRECTION + 2 * k;
+    query[p] = (position.x - m_Offset[p]) * m_Scale[p];
+    query[p + 1] = (position.y - m_Offset[p + 1]) * m_Scale[p + 1];
+    query[d] = (heading.x - m_Offset[d]) * m_Scale[d];
+    query[d + 1] = (heading.y - m_Offset[d + 1]) * m_Scale[d + 1];
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int best = useKDTree ? m_Tree.Nearest(query, matchCost) : m_Tree.NearestBruteForce(query, matchCost);
+  searchMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+  matchedFrame = best;
+  if (best < 0)
+    return;
+
+  // a match next to the playing frame means keep playing
+  const Frame& target = m_Frames[best];
+  if (target.clip == m_Frames[current].clip)
+  {
+    int count = m_ClipFirstFrame[target.clip + 1] - m_ClipFirstFrame[target.clip];
+    int distance = std::abs(best - current);
+    distance = std::min(distance, count - distance);
+    if (distance <= settings.sameClipWindow * settings.sampleRate)
+      return;
+  }
+
+  int layer = 2 * target.clip;
+  if (layer == m_ActiveLayer)
+    ++layer;
+  animator.SeekLayer(m_Layers[layer], target.time);
+  animator.CrossFade(m_Layers[layer], settings.blendTime);
+  m_ActiveLayer = layer;
+  ++transitions;
+}
@@ -9,6 +9,9 @@
 #include "Transform.h"
 #include "Octree.h"
 #include "BspTree.h"
+#include "OcclusionCuller.h"
+#include "MeshBVH.h"
+#include "ConvexDecomposition.h"
 #include "GJK.h"
 #include "Physics.h"
 #include <iostream>
@@ -47,6 +50,9 @@ ObjectManager::~ObjectManager()
       delete Objmodel;
     }
   }
+  delete occlusionController.culler;
+  delete closestPointController.bvh;
+  delete gjkController.decomposition;
 }
 
 void ObjectManager::CreateSpringMassDamperSystem()
@@ -278,6 +284,9 @@ void ObjectManager::Setup()
   //gjk
   gjkController.simplex = new Simplex();
 
+  // occlusion culling
+  occlusionController.culler = new OcclusionCuller(occlusionController.width, occlusionController.height);
+
   renderModel = false;
 }
 
@@ -310,11 +319,24 @@ void ObjectManager::Update()
   {
     octreeController.Update(&octreeController.tree->root_);
   }
-  // gjk only update sphere (movable object)
-  bvs_gjk_[0]->bv_object->SetPosition(bvs_gjk_[0]->parent->GetPosition());
-  bvs_gjk_[0]->Update(); // update bounding volume center and size in world space, need to be called before BuildModelMatrix()
-  bvs_gjk_[0]->bv_object->BuildModelMatrix();
+  // gjk update bounding volumes of movable objects
+  for (auto& obj : container_)
+  {
+    if (!obj || !obj->bv)
+      continue;
+    obj->bv->bv_object->SetPosition(obj->bv->parent->GetPosition());
+    obj->bv->Update(); // update bounding volume center and size in world space, need to be called before BuildModelMatrix()
+    obj->bv->bv_object->BuildModelMatrix();
+  }
 
+  // gjk caches are keyed by leaf pointers, a rebuilt tree can reuse the freed addresses
+  if (octreeController.buildFlag || octreeController.deleteFlag)
+  {
+    bvs_gjk_.resize(1); // keep the sphere, drop colliding leaves
+    gjkController.manifolds.clear();
+    gjkController.simplexCache.clear();
+    gjkController.pairs.clear();
+  }
   // octree
   if (octreeController.buildFlag)
   {
@@ -328,6 +350,9 @@ void ObjectManager::Update()
     octreeController.buildFlag = false;
     octreeController.treeEmpty = false;
     octreeController.treeReady = true;
+    // world space bounds now, occluders are matched against them below
+    octreeController.Update(&octreeController.tree->root_);
+    occlusionController.occluderDirty = true;
   }
   else if (octreeController.deleteFlag)
   {
@@ -343,6 +368,7 @@ void ObjectManager::Update()
     bsptreeConroller.buildFlag = false;
     bsptreeConroller.treeEmpty = false;
     bsptreeConroller.treeReady = true;
+    occlusionController.occluderDirty = true;
   }
   else if (bsptreeConroller.deleteFlag)
   {
@@ -352,6 +378,103 @@ void ObjectManager::Update()
     bsptreeConroller.treeReady = false;
     bsptreeConroller.treeEmpty = true;
   }
+  // occlusion culling, bsp leaves are the occluders, octree nodes and objects are tested
+  if (occlusionController.enableFlag && bsptreeConroller.treeReady && !models_.empty())
+  {
+    auto* cm = Engine::managers_.GetManager<CameraManager*>();
+    OcclusionCuller* culler = occlusionController.culler;
+
+    if (occlusionController.occluderDirty)
+    {
+      bsptreeConroller.tree->SelectOccluders(occlusionController.max_occluders);
+      if (octreeController.treeReady)
+      {
+        // octree nodes holding occluder triangles are not tested against their own depth
+        occlusionController.ClearOccluders(&octreeController.tree->root_);
+        for (auto* leaf : bsptreeConroller.tree->occluder_nodes_)
+        {
+          for (size_t i = 0; i + 2 < leaf->indices_.size(); i += 3)
+          {
+            glm::vec3 center = (leaf->vertices_[leaf->indices_[i]] + leaf->vertices_[leaf->indices_[i + 1]] +
+              leaf->vertices_[leaf->indices_[i + 2]]) / 3.f;
+            occlusionController.MarkOccluder(&octreeController.tree->root_,
+              glm::vec3(models_[0]->modelTr * glm::vec4(center, 1.f)));
+          }
+        }
+      }
+      occlusionController.occluderDirty = false;
+    }
+    culler->BeginFrame(cm->WorldProj, cm->WorldView);
+    bsptreeConroller.tree->RasterizeOccluders(culler, models_[0]->modelTr);
+    culler->BuildHiZ();
+
+    occlusionController.visibleNodes = 0;
+    occlusionController.culledNodes = 0;
+    if (octreeController.treeReady)
+      occlusionController.Cull(&octreeController.tree->root_);
+
+    // each section is tested with its own bounds, the whole scene's octree root never fails
+    for (size_t i = 0; i < models_.size() && i < occlusionController.sectionMin.size(); ++i)
+    {
+      if (!models_[i])
+        continue;
+      glm::vec3 boxMin = occlusionController.sectionMin[i];
+      glm::vec3 boxMax = occlusionController.sectionMax[i];
+      glm::vec3 worldMin = glm::vec3(std::numeric_limits<float>::max());
+      glm::vec3 worldMax = glm::vec3(-std::numeric_limits<float>::max());
+      for (int c = 0; c < 8; ++c)
+      {
+        glm::vec3 corner = { (c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z };
+        corner = glm::vec3(models_[i]->modelTr * glm::vec4(corner, 1.f));
+        worldMin = glm::min(worldMin, corner);
+        worldMax = glm::max(worldMax, corner);
+      }
+      models_[i]->isVisible = culler->IsVisible(worldMin, worldMax);
+    }
+    for (auto& obj : container_)
+    {
+      if (obj && obj->bv)
+        obj->isVisible = culler->IsVisible(obj->bv->min_, obj->bv->max_);
+    }
+    occlusionController.active = true;
+  }
+  else if (occlusionController.active)
+  {
+    // disabled, make everything visible again
+    if (octreeController.treeReady)
+      occlusionController.Reset(&octreeController.tree->root_);
+    for (auto& obj : container_)
+    {
+      if (obj)
+        obj->isVisible = true;
+    }
+    for (auto& model : models_)
+    {
+      if (model)
+        model->isVisible = true;
+    }
+    occlusionController.active = false;
+  }
+  // closest surface point on model to the sphere, queried in model space
+  if (closestPointController.enableFlag && closestPointController.bvh && !models_.empty())
+  {
+    glm::vec3 spherePos = container_[0]->GetPosition();
+    glm::vec3 P = glm::vec3(glm::inverse(models_[0]->modelTr) * glm::vec4(spherePos, 1.f));
+
+    MeshBVH::Hit hit;
+    if (closestPointController.bvh->ClosestPoint(P, hit))
+    {
+      closestPointController.point = glm::vec3(models_[0]->modelTr * glm::vec4(hit.point_, 1.f));
+      closestPointController.distance = glm::distance(closestPointController.point, spherePos);
+      closestPointController.triangle = hit.triangle_;
+    }
+
+    std::vector<MeshBVH::Hit> hits;
+    closestPointController.bvh->KNearest(P, closestPointController.k, hits);
+    closestPointController.nearestTriangles.clear();
+    for (auto& h : hits)
+      closestPointController.nearestTriangles.push_back(h.triangle_);
+  }
   // gjk
   if (gjkController.startFlag && !gjkController.stopFlag)
   {
@@ -360,24 +483,41 @@ void ObjectManager::Update()
     float speed = 400.0f;
     float dt = Engine::managers_.GetManager<FrameRateManager*>()->delta_time;
     glm::vec3 pos = container_[0]->GetPosition();
-    pos += dt * speed * gjkController.dir;
-    container_[0]->SetPosition(pos);
+    glm::vec3 motion = dt * speed * gjkController.dir;
 
-    if (octreeController.tree->root_)
+    bool collided = false;
+    if (gjkController.continuous && octreeController.tree->root_)
     {
-      if (GJK::DetectCollision_BroadPhase(container_[0], octreeController.tree->root_))
-      {
-        gjkController.stopFlag = true;
-        Engine::managers_.GetManager<RenderManager*>()->simplexDraw = true;
+      // sweep this frame's motion and stop at the first contact, no tunneling
+      float toi = 1.f;
+      collided = GJK::DetectCollision_Continuous(container_[0], motion, octreeController.tree->root_, toi);
+      container_[0]->SetPosition(pos + toi * motion);
+    }
+    else
+    {
+      container_[0]->SetPosition(pos + motion);
+      if (octreeController.tree->root_)
+        collided = GJK::DetectCollision_BroadPhase(container_, octreeController.tree->root_);
+    }
 
-        if (!gjkController.simplex->vaoFlag_)
-          gjkController.simplex->CreateVAOs();
-      }
+    if (collided)
+    {
+      gjkController.stopFlag = true;
+      Engine::managers_.GetManager<RenderManager*>()->simplexDraw = true;
+
+      if (!gjkController.simplex->vaoFlag_)
+        gjkController.simplex->CreateVAOs();
     }
   }
+  // cached contacts follow the objects and expire once separated
+  gjkController.RefreshManifolds();
   if (gjkController.resetFlag)
   {
-    bvs_gjk_.pop_back();
+    bvs_gjk_.resize(1); // keep the sphere, drop colliding leaves
+    gjkController.manifolds.clear();
+    gjkController.pairs.clear();
+    gjkController.simplexCache.clear();
+    gjkController.contact = GJK::Contact();
     gjkController.simplex->vertices_.clear();
     gjkController.simplex->indices_.clear();
     gjkController.simplex->vaoFlag_ = false;
@@ -418,6 +558,14 @@ void ObjectManager::AddBoundingVolumeGJK(BoundingVolume* bv)
 
 void ObjectManager::Draw(ShaderProgram* shaderProgram)
 {
+  // only model meshes set this, shapes always go through the shader's skinning
+  int skinnedLoc = glGetUniformLocation(shaderProgram->programID, "preSkinned");
+  glUniform1i(skinnedLoc, 0);
+  int instancedLoc = glGetUniformLocation(shaderProgram->programID, "instanced");
+  glUniform1i(instancedLoc, 0);
+  int dualQuaternionLoc = glGetUniformLocation(shaderProgram->programID, "dualQuaternion");
+  glUniform1i(dualQuaternionLoc, Engine::managers_.GetManager<RenderManager*>()->dualQuaternionSkinning ? 1 : 0);
+
   for (auto& obj : SpringMassDamperGeometry_)
   {
     if (obj)
@@ -458,7 +606,7 @@ void ObjectManager::Draw(ShaderProgram* shaderProgram)
 
   for (auto& obj : container_)
   {
-    if (obj)
+    if (obj && obj->isVisible)
     {
       int loc = glGetUniformLocation(shaderProgram->programID, "ModelTr");
       glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(obj->modelTr));
@@ -497,7 +645,7 @@ void ObjectManager::Draw(ShaderProgram* shaderProgram)
   {
     for (auto& model : models_)
     {
-      if (model)
+      if (model && model->isVisible)
       {
         if (model->model)
         {
@@ -528,6 +676,38 @@ void ObjectManager::Draw(ShaderProgram* shaderProgram)
         }
       }
     }
+
+    // crowd shares the animated model, one instanced draw per mesh
+    auto* am = Engine::managers_.GetManager<AnimationManager*>();
+    if (am->model && am->animator && !am->crowd.empty())
+    {
+      glUniform1i(instancedLoc, 1);
+      int loc = glGetUniformLocation(shaderProgram->programID, "paletteStride");
+      glUniform1i(loc, static_cast<int>(am->animator->GetFinalBoneMatrices().size()));
+
+      bool baked = am->bakedPlayback && !am->baked.Empty();
+      int bakedLoc = glGetUniformLocation(shaderProgram->programID, "baked");
+      glUniform1i(bakedLoc, baked ? 1 : 0);
+      if (baked)
+      {
+        loc = glGetUniformLocation(shaderProgram->programID, "bakedTime");
+        glUniform1f(loc, am->bakedTime);
+        loc = glGetUniformLocation(shaderProgram->programID, "bakedRate");
+        glUniform1f(loc, am->baked.sampleRate);
+        loc = glGetUniformLocation(shaderProgram->programID, "bakedFrames");
+        glUniform1i(loc, am->baked.frameCount);
+      }
+
+      loc = glGetUniformLocation(shaderProgram->programID, "isModel");
+      glUniform1i(loc, 1);
+
+      loc = glGetUniformLocation(shaderProgram->programID, "isTextureSupported");
+      glUniform1i(loc, am->model->textures_loaded.empty() ? 0 : 1);
+
+      am->model->DrawInstanced(shaderProgram, static_cast<int>(am->crowd.size()));
+      glUniform1i(instancedLoc, 0);
+      glUniform1i(bakedLoc, 0);
+    }
   }
 }
 
@@ -650,7 +830,9 @@ void ObjectManager::SectionLoader(const char* path)
       }
       delete models_[i];
       models_[i] = nullptr;
-      // delete animation data
+      // delete animation data, crowd animators and the bake refer to the clip
+      am->ClearCrowd();
+      am->baked = BakedAnimation();
       am->animation.reset();
       am->animator.reset();
       sm->getSpaceCurves().pop_back();
@@ -659,6 +841,8 @@ void ObjectManager::SectionLoader(const char* path)
   models_.clear();
   total_model_indices_.clear();
   total_model_vertices_.clear();
+  occlusionController.sectionMin.clear();
+  occlusionController.sectionMax.clear();
 
   for (auto p : parts)
   {
@@ -672,11 +856,14 @@ void ObjectManager::SectionLoader(const char* path)
     // animation data
     if (am->animation && am->animator)
     {
+      am->ClearCrowd();
       am->animation.reset();
       am->animator.reset();
     }
     am->animation = std::make_unique<SkeletalAnimation>(p, testObj->model);
     am->animator = std::make_unique<Animator>(am->animation.get());
+    am->model = testObj->model;
+    am->LoadBlendClips(p);
 
     // set up VAO for bone draw hierarchically
     am->animation->SetUpVAO();
@@ -717,8 +904,32 @@ void ObjectManager::SectionLoader(const char* path)
       total_model_vertices_.push_back(testObj->model->meshes[0].Position[i]);
     }
 
+    // section bounds over every mesh, for occlusion culling
+    glm::vec3 sectionMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 sectionMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (auto& mesh : testObj->model->meshes)
+    {
+      for (auto& position : mesh.Position)
+      {
+        sectionMin = glm::min(sectionMin, position);
+        sectionMax = glm::max(sectionMax, position);
+      }
+    }
+    occlusionController.sectionMin.push_back(sectionMin);
+    occlusionController.sectionMax.push_back(sectionMax);
+
     AddModel(testObj);
   }
+
+  // distance query structure over all loaded geometry
+  if (!closestPointController.bvh)
+    closestPointController.bvh = new MeshBVH();
+  closestPointController.bvh->Build(total_model_vertices_, total_model_indices_);
+
+  // convex pieces for gjk, rebuilt only when the loaded geometry changes
+  if (!gjkController.decomposition)
+    gjkController.decomposition = new ConvexDecomposition();
+  gjkController.decomposition->BuildCached(total_model_vertices_, total_model_indices_, "./cache");
 }
 
 // octree controller
@@ -739,7 +950,7 @@ void ObjectManager::OctreeController::Update(Octree::TreeNode** node)
 // draw octree recursively
 void ObjectManager::OctreeController::Draw(ShaderProgram* shaderProgram, Octree::TreeNode** node)
 {
-  if (!(*node))
+  if (!(*node) || !(*node)->visible_)
     return;
 
   int loc = glGetUniformLocation(shaderProgram->programID, "ModelTr");
@@ -754,3 +965,80 @@ void ObjectManager::OctreeController::Draw(ShaderProgram* shaderProgram, Octree:
     Draw(shaderProgram, &(*node)->children_[i]);
   }
 }
+
+// gjk controller
+// move cached contact points with their objects, drop pairs without contacts
+void ObjectManager::GJK_Controller::RefreshManifolds()
+{
+  for (auto it = manifolds.begin(); it != manifolds.end();)
+  {
+    auto& cached = it->second;
+    cached.manifold.Refresh(cached.objectA->modelTr, cached.objectB->modelTr);
+    if (cached.manifold.count == 0)
+      it = manifolds.erase(it);
+    else
+      ++it;
+  }
+}
+
+// occlusion controller
+// test octree nodes against hi-z buffer, children of a hidden node are skipped
+void ObjectManager::OcclusionController::Cull(Octree::TreeNode** node)
+{
+  if (!(*node))
+    return;
+
+  (*node)->visible_ = (*node)->occluder_ || culler->IsVisible((*node)->bv_->min_, (*node)->bv_->max_);
+  if (!(*node)->visible_)
+  {
+    ++culledNodes;
+    return;
+  }
+  ++visibleNodes;
+  for (int i = 0; i < MAX_CHILDREN; ++i)
+  {
+    Cull(&(*node)->children_[i]);
+  }
+}
+
+void ObjectManager::OcclusionController::MarkOccluder(Octree::TreeNode** node, const glm::vec3& point)
+{
+  if (!(*node))
+    return;
+
+  const glm::vec3& min = (*node)->bv_->min_;
+  const glm::vec3& max = (*node)->bv_->max_;
+  if (point.x < min.x || point.y < min.y || point.z < min.z || point.x > max.x || point.y > max.y || point.z > max.z)
+    return;
+
+  (*node)->occluder_ = true;
+  for (int i = 0; i < MAX_CHILDREN; ++i)
+  {
+    MarkOccluder(&(*node)->children_[i], point);
+  }
+}
+
+void ObjectManager::OcclusionController::ClearOccluders(Octree::TreeNode** node)
+{
+  if (!(*node))
+    return;
+
+  (*node)->occluder_ = false;
+  for (int i = 0; i < MAX_CHILDREN; ++i)
+  {
+    ClearOccluders(&(*node)->children_[i]);
+  }
+}
+
+// mark whole octree visible
+void ObjectManager::OcclusionController::Reset(Octree::TreeNode** node)
+{
+  if (!(*node))
+    return;
+
+  (*node)->visible_ = true;
+  for (int i = 0; i < MAX_CHILDREN; ++i)
+  {
+    Reset(&(*node)->children_[i]);
+  }
+}
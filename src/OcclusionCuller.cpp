@@ -0,0 +1,261 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <xmmintrin.h>
+
+namespace
+{
+  // triangles with a vertex behind this w are dropped, skipping an occluder is always safe
+  constexpr float NEAR_W = 1e-4f;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+  Resize(width, height);
+}
+
+void OcclusionCuller::Resize(int width, int height)
+{
+  // row width is a multiple of 4 so a row can be walked with 4-wide sse
+  width_ = std::max(4, (width + 3) & ~3);
+  height_ = std::max(1, height);
+
+  hiZ_.clear();
+  levelSize_.clear();
+
+  glm::ivec2 size = { width_, height_ };
+  while (true)
+  {
+    levelSize_.push_back(size);
+    hiZ_.emplace_back(static_cast<size_t>(size.x) * size.y, 1.f);
+    if (size.x == 1 && size.y == 1)
+      break;
+    size = { std::max(1, (size.x + 1) / 2), std::max(1, (size.y + 1) / 2) };
+  }
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& worldProj, const glm::mat4& worldView)
+{
+  viewProj_ = worldProj * worldView;
+  std::fill(hiZ_[0].begin(), hiZ_[0].end(), 1.f);
+  rasterizedTriangles = 0;
+}
+
+void OcclusionCuller::RasterizeOccluder(const std::vector<glm::vec3>& vertices,
+  const std::vector<unsigned int>& indices,
+  const glm::mat4& modelTr)
+{
+  glm::mat4 mvp = viewProj_ * modelTr;
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    glm::vec4 v0 = mvp * glm::vec4(vertices[indices[i]], 1.f);
+    glm::vec4 v1 = mvp * glm::vec4(vertices[indices[i + 1]], 1.f);
+    glm::vec4 v2 = mvp * glm::vec4(vertices[indices[i + 2]], 1.f);
+
+    // no near plane clipping, partially visible triangles are not occluders
+    if (v0.w < NEAR_W || v1.w < NEAR_W || v2.w < NEAR_W)
+      continue;
+
+    RasterizeTriangle(v0, v1, v2);
+  }
+}
+
+glm::vec3 OcclusionCuller::ToScreen(const glm::vec4& clip) const
+{
+  glm::vec3 ndc = glm::vec3(clip) / clip.w;
+  return {
+    (ndc.x * 0.5f + 0.5f) * width_,
+    (ndc.y * 0.5f + 0.5f) * height_,
+    ndc.z * 0.5f + 0.5f
+  };
+}
+
+// half-space rasterizer, 4 pixels of a row per iteration
+void OcclusionCuller::RasterizeTriangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2)
+{
+  glm::vec3 p0 = ToScreen(v0);
+  glm::vec3 p1 = ToScreen(v1);
+  glm::vec3 p2 = ToScreen(v2);
+
+  // twice the signed area, flip winding so both faces are rasterized
+  float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+  if (std::abs(area) < 1e-6f)
+    return;
+  if (area < 0.f)
+  {
+    std::swap(p1, p2);
+    area = -area;
+  }
+
+  // screen bounds
+  int minX = static_cast<int>(std::floor(std::min({ p0.x, p1.x, p2.x })));
+  int maxX = static_cast<int>(std::ceil(std::max({ p0.x, p1.x, p2.x })));
+  int minY = static_cast<int>(std::floor(std::min({ p0.y, p1.y, p2.y })));
+  int maxY = static_cast<int>(std::ceil(std::max({ p0.y, p1.y, p2.y })));
+
+  minX = std::max(minX, 0) & ~3;
+  minY = std::max(minY, 0);
+  maxX = std::min(maxX, width_ - 1);
+  maxY = std::min(maxY, height_ - 1);
+  if (minX > maxX || minY > maxY)
+    return;
+
+  ++rasterizedTriangles;
+
+  // edge function e(x,y) = a*x + b*y + c, positive inside
+  float a0 = p1.y - p2.y, b0 = p2.x - p1.x, c0 = p1.x * p2.y - p2.x * p1.y;
+  float a1 = p2.y - p0.y, b1 = p0.x - p2.x, c1 = p2.x * p0.y - p0.x * p2.y;
+  float a2 = p0.y - p1.y, b2 = p1.x - p0.x, c2 = p0.x * p1.y - p1.x * p0.y;
+
+  // depth plane from barycentric weights
+  float invArea = 1.f / area;
+  float za = (a0 * p0.z + a1 * p1.z + a2 * p2.z) * invArea;
+  float zb = (b0 * p0.z + b1 * p1.z + b2 * p2.z) * invArea;
+  float zc = (c0 * p0.z + c1 * p1.z + c2 * p2.z) * invArea;
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 offsetX = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f); // pixel centers
+  const __m128 stepX = _mm_set1_ps(4.f);
+
+  const __m128 A0 = _mm_set1_ps(a0), A1 = _mm_set1_ps(a1), A2 = _mm_set1_ps(a2), ZA = _mm_set1_ps(za);
+  const __m128 step0 = _mm_mul_ps(A0, stepX);
+  const __m128 step1 = _mm_mul_ps(A1, stepX);
+  const __m128 step2 = _mm_mul_ps(A2, stepX);
+  const __m128 stepZ = _mm_mul_ps(ZA, stepX);
+
+  std::vector<float>& depth = hiZ_[0];
+
+  for (int y = minY; y <= maxY; ++y)
+  {
+    float py = y + 0.5f;
+    __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(minX)), offsetX);
+
+    __m128 e0 = _mm_add_ps(_mm_mul_ps(A0, px), _mm_set1_ps(b0 * py + c0));
+    __m128 e1 = _mm_add_ps(_mm_mul_ps(A1, px), _mm_set1_ps(b1 * py + c1));
+    __m128 e2 = _mm_add_ps(_mm_mul_ps(A2, px), _mm_set1_ps(b2 * py + c2));
+    __m128 z = _mm_add_ps(_mm_mul_ps(ZA, px), _mm_set1_ps(zb * py + zc));
+
+    float* row = depth.data() + static_cast<size_t>(y) * width_;
+    for (int x = minX; x <= maxX; x += 4)
+    {
+      __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+      if (_mm_movemask_ps(inside))
+      {
+        __m128 old = _mm_loadu_ps(row + x);
+        __m128 closer = _mm_min_ps(old, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+      }
+      e0 = _mm_add_ps(e0, step0);
+      e1 = _mm_add_ps(e1, step1);
+      e2 = _mm_add_ps(e2, step2);
+      z = _mm_add_ps(z, stepZ);
+    }
+  }
+}
+
+// each texel keeps the farthest depth of its footprint
+void OcclusionCuller::BuildHiZ()
+{
+  for (size_t level = 1; level < hiZ_.size(); ++level)
+  {
+    const std::vector<float>& src = hiZ_[level - 1];
+    std::vector<float>& dst = hiZ_[level];
+    glm::ivec2 srcSize = levelSize_[level - 1];
+    glm::ivec2 dstSize = levelSize_[level];
+
+    for (int y = 0; y < dstSize.y; ++y)
+    {
+      int y0 = std::min(2 * y, srcSize.y - 1);
+      int y1 = std::min(2 * y + 1, srcSize.y - 1);
+      for (int x = 0; x < dstSize.x; ++x)
+      {
+        int x0 = std::min(2 * x, srcSize.x - 1);
+        int x1 = std::min(2 * x + 1, srcSize.x - 1);
+        dst[y * dstSize.x + x] = std::max(
+          std::max(src[y0 * srcSize.x + x0], src[y0 * srcSize.x + x1]),
+          std::max(src[y1 * srcSize.x + x0], src[y1 * srcSize.x + x1]));
+      }
+    }
+  }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& min, const glm::vec3& max) const
+{
+  glm::vec2 screenMin = glm::vec2(std::numeric_limits<float>::max());
+  glm::vec2 screenMax = glm::vec2(-std::numeric_limits<float>::max());
+  float nearestZ = 1.f;
+
+  for (int i = 0; i < 8; ++i)
+  {
+    glm::vec3 corner = {
+      (i & 1) ? max.x : min.x,
+      (i & 2) ? max.y : min.y,
+      (i & 4) ? max.z : min.z
+    };
+    glm::vec4 clip = viewProj_ * glm::vec4(corner, 1.f);
+
+    // box crosses the near plane (camera may be inside)
+    if (clip.w < NEAR_W)
+      return true;
+
+    glm::vec3 p = ToScreen(clip);
+    screenMin = glm::min(screenMin, glm::vec2(p));
+    screenMax = glm::max(screenMax, glm::vec2(p));
+    nearestZ = std::min(nearestZ, p.z);
+  }
+
+  // outside the view frustum
+  if (screenMax.x < 0.f || screenMax.y < 0.f || screenMin.x >= width_ || screenMin.y >= height_)
+    return false;
+
+  int x0 = std::max(0, static_cast<int>(screenMin.x));
+  int y0 = std::max(0, static_cast<int>(screenMin.y));
+  int x1 = std::min(width_ - 1, static_cast<int>(screenMax.x));
+  int y1 = std::min(height_ - 1, static_cast<int>(screenMax.y));
+
+  // pick the level where the footprint spans about 2x2 texels
+  int extent = std::max(x1 - x0, y1 - y0);
+  int level = 0;
+  while (extent > 1 && level + 1 < static_cast<int>(hiZ_.size()))
+  {
+    extent >>= 1;
+    ++level;
+  }
+  x0 >>= level; x1 >>= level;
+  y0 >>= level; y1 >>= level;
+
+  const std::vector<float>& depth = hiZ_[level];
+  int levelWidth = levelSize_[level].x;
+  for (int y = y0; y <= y1; ++y)
+  {
+    for (int x = x0; x <= x1; ++x)
+    {
+      // some occluder pixel is behind the nearest point of the box
+      if (nearestZ <= depth[y * levelWidth + x])
+        return true;
+    }
+  }
+  return false;
+}
+
+int OcclusionCuller::GetWidth() const
+{
+  return width_;
+}
+
+int OcclusionCuller::GetHeight() const
+{
+  return height_;
+}
+
+int OcclusionCuller::GetLevelCount() const
+{
+  return static_cast<int>(hiZ_.size());
+}
+
+const std::vector<float>& OcclusionCuller::GetDepthBuffer() const
+{
+  return hiZ_[0];
+}
@@ -0,0 +1,65 @@
+#include "PoseBuffer.h"
+#include "SkeletalAnimation.h"
+#include "VQS.h"
+#include "QuaternionBatch.h"
+
+size_t PoseBuffer::Size() const
+{
+  return translation.size();
+}
+
+void PoseBuffer::SetBind(const FlatSkeleton& skeleton)
+{
+  size_t count = skeleton.parent.size();
+  translation.resize(count);
+  rotation.resize(count);
+  scale.resize(count);
+  animated.assign(count, 0);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const glm::mat4& m = skeleton.transformation[i];
+    glm::vec3 s(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+    glm::mat3 basis(glm::vec3(m[0]) / s.x, glm::vec3(m[1]) / s.y, glm::vec3(m[2]) / s.z);
+    translation[i] = glm::vec3(m[3]);
+    rotation[i] = Utility::ConvertMatrixToQuaternion(basis).normalize();
+    scale[i] = s;
+  }
+}
+
+void PoseBuffer::Set(size_t node, const VQS& pose)
+{
+  translation[node] = pose.getTranslation();
+  rotation[node] = pose.getRotation();
+  scale[node] = pose.getScale();
+  animated[node] = 1;
+}
+
+void PoseBuffer::Blend(const PoseBuffer& other, float t)
+{
+  for (size_t i = 0; i < translation.size(); ++i)
+  {
+    translation[i] += (other.translation[i] - translation[i]) * t;
+    scale[i] += (other.scale[i] - scale[i]) * t;
+    animated[i] |= other.animated[i];
+  }
+  QuaternionBatch::Nlerp(rotation.data(), other.rotation.data(), t, rotation.data(), rotation.size());
+}
+
+glm::mat4 PoseBuffer::LocalTransform(const FlatSkeleton& skeleton, size_t node) const
+{
+  if (!animated[node])
+    return skeleton.transformation[node];
+  return VQS(translation[node], rotation[node], scale[node]).toMat4();
+}
+
+void PoseBuffer::LocalTransforms(const FlatSkeleton& skeleton, std::vector<glm::mat4>& out) const
+{
+  out.resize(Size());
+  QuaternionBatch::ToMat4(translation.data(), rotation.data(), scale.data(), out.data(), Size());
+  for (size_t i = 0; i < out.size(); ++i)
+  {
+    if (!animated[i])
+      out[i] = skeleton.transformation[i];
+  }
+}
@@ -1,5 +1,6 @@
 #include "Quaternion.h"
 #include <glm/glm/gtx/norm.hpp>
+#include <cmath>
 
 Quaternion::Quaternion() : _s(1.0), _v(0) // identity quaternion
 {
@@ -261,6 +262,44 @@ Quaternion Interpolation::Slerp(Quaternion q1, Quaternion q2, float t)
   }
 }
 
+// written on the components, the operators copy and normalize divides per component
+Quaternion Interpolation::Nlerp(Quaternion q1, Quaternion q2, float t)
+{
+  float w2 = std::copysign(t, q1._s * q2._s + glm::dot(q1._v, q2._v)); // shorter arc without a branch
+  float w1 = 1.f - t;
+  float s = q1._s * w1 + q2._s * w2;
+  glm::vec3 v = q1._v * w1 + q2._v * w2;
+  float inverseLength = 1.f / glm::sqrt(s * s + glm::dot(v, v));
+  return Quaternion(s * inverseLength, v * inverseLength);
+}
+
+float Interpolation::CorrectedNlerpFactor(float cosTheta, float t)
+{
+  float d = std::abs(cosTheta);
+  float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+  float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+  float k = a * (t - 0.5f) * (t - 0.5f) + b;
+  return t + t * (t - 0.5f) * (t - 1.f) * k;
+}
+
+Quaternion Interpolation::CorrectedNlerp(Quaternion q1, Quaternion q2, float t)
+{
+  return Nlerp(q1, q2, CorrectedNlerpFactor(q1._s * q2._s + glm::dot(q1._v, q2._v), t));
+}
+
+Quaternion Interpolation::Interpolate(Quaternion q1, Quaternion q2, float t, RotationInterpolation mode)
+{
+  switch (mode)
+  {
+  case RotationInterpolation::CorrectedNlerp:
+    return CorrectedNlerp(q1, q2, t);
+  case RotationInterpolation::Nlerp:
+    return Nlerp(q1, q2, t);
+  default:
+    return Slerp(q1, q2, t).normalize();
+  }
+}
+
 glm::vec3 Interpolation::lerp(glm::vec3 v1, glm::vec3 v2, float t)
 {
   return (1 - t) * v1 + t * v2;
@@ -268,6 +307,10 @@ glm::vec3 Interpolation::lerp(glm::vec3 v1, glm::vec3 v2, float t)
 
 glm::vec3 Interpolation::Elerp(glm::vec3 s1, glm::vec3 s2, float t)
 {
+  // most scale tracks are constant, skip the three pow calls
+  if (s1 == s2)
+    return s1;
+
   glm::vec3 divide = (s2 / s1);
   divide.x = glm::pow(divide.x, t);
   divide.y = glm::pow(divide.y, t);
@@ -276,13 +319,27 @@ glm::vec3 Interpolation::Elerp(glm::vec3 s1, glm::vec3 s2, float t)
   return s1 * divide;
 }
 
+// branches on the largest diagonal term so half turns do not divide by a vanishing scalar
 Quaternion Utility::ConvertMatrixToQuaternion(glm::mat3 m)
 {
-  float scalar = glm::sqrt(m[0][0] + m[1][1] + m[2][2] + 1.f) / 2.f;
-  float denom = 4.f * scalar;
-  glm::vec3 vector = { (m[1][2] - m[2][1]) / denom, (m[2][0] - m[0][2]) / denom, (m[0][1] - m[1][0]) / denom };
-
-  return Quaternion(scalar, vector);
+  float trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0.f)
+  {
+    float s = glm::sqrt(trace + 1.f) * 2.f;
+    return Quaternion(0.25f * s, (m[1][2] - m[2][1]) / s, (m[2][0] - m[0][2]) / s, (m[0][1] - m[1][0]) / s);
+  }
+  if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+  {
+    float s = glm::sqrt(1.f + m[0][0] - m[1][1] - m[2][2]) * 2.f;
+    return Quaternion((m[1][2] - m[2][1]) / s, 0.25f * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s);
+  }
+  if (m[1][1] > m[2][2])
+  {
+    float s = glm::sqrt(1.f + m[1][1] - m[0][0] - m[2][2]) * 2.f;
+    return Quaternion((m[2][0] - m[0][2]) / s, (m[1][0] + m[0][1]) / s, 0.25f * s, (m[2][1] + m[1][2]) / s);
+  }
+  float s = glm::sqrt(1.f + m[2][2] - m[0][0] - m[1][1]) * 2.f;
+  return Quaternion((m[0][1] - m[1][0]) / s, (m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25f * s);
 }
 
 std::ostream& operator<<(std::ostream& out, Quaternion& q)
@@ -0,0 +1,409 @@
+#include "QuaternionBatch.h"
+#include <xmmintrin.h>
+#include <algorithm>
+
+static_assert(sizeof(Quaternion) == 4 * sizeof(float), "Quaternion is loaded as four packed floats");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 arrays are read as packed floats");
+
+namespace
+{
+  // one register per component, lane i is element i
+  struct Quat4
+  {
+    __m128 s, x, y, z;
+  };
+
+  struct Vec4x3
+  {
+    __m128 x, y, z;
+  };
+
+  Quat4 Load(const Quaternion* q)
+  {
+    Quat4 r;
+    r.s = _mm_loadu_ps(&q[0]._s);
+    r.x = _mm_loadu_ps(&q[1]._s);
+    r.y = _mm_loadu_ps(&q[2]._s);
+    r.z = _mm_loadu_ps(&q[3]._s);
+    _MM_TRANSPOSE4_PS(r.s, r.x, r.y, r.z);
+    return r;
+  }
+
+  void Store(Quat4 r, Quaternion* q)
+  {
+    _MM_TRANSPOSE4_PS(r.s, r.x, r.y, r.z);
+    _mm_storeu_ps(&q[0]._s, r.s);
+    _mm_storeu_ps(&q[1]._s, r.x);
+    _mm_storeu_ps(&q[2]._s, r.y);
+    _mm_storeu_ps(&q[3]._s, r.z);
+  }
+
+  Vec4x3 Load(const glm::vec3* v)
+  {
+    Vec4x3 r;
+    r.x = _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x);
+    r.y = _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y);
+    r.z = _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z);
+    return r;
+  }
+
+  void Store(const Vec4x3& r, glm::vec3* v)
+  {
+    alignas(16) float x[4], y[4], z[4];
+    _mm_store_ps(x, r.x);
+    _mm_store_ps(y, r.y);
+    _mm_store_ps(z, r.z);
+    for (int i = 0; i < 4; ++i)
+      v[i] = glm::vec3(x[i], y[i], z[i]);
+  }
+
+  __m128 Dot(const Quat4& a, const Quat4& b)
+  {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.s, b.s), _mm_mul_ps(a.x, b.x)),
+      _mm_add_ps(_mm_mul_ps(a.y, b.y), _mm_mul_ps(a.z, b.z)));
+  }
+
+  // flip b onto a's hemisphere, returns the now non negative dot product
+  __m128 ShorterArc(const Quat4& a, Quat4& b)
+  {
+    __m128 d = Dot(a, b);
+    __m128 sign = _mm_and_ps(_mm_cmplt_ps(d, _mm_setzero_ps()), _mm_set1_ps(-0.f));
+    b.s = _mm_xor_ps(b.s, sign);
+    b.x = _mm_xor_ps(b.x, sign);
+    b.y = _mm_xor_ps(b.y, sign);
+    b.z = _mm_xor_ps(b.z, sign);
+    return _mm_xor_ps(d, sign);
+  }
+
+  Quat4 Normalize(const Quat4& q)
+  {
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(Dot(q, q)));
+    return { _mm_mul_ps(q.s, inv), _mm_mul_ps(q.x, inv), _mm_mul_ps(q.y, inv), _mm_mul_ps(q.z, inv) };
+  }
+
+  Quat4 Multiply(const Quat4& a, const Quat4& b)
+  {
+    Quat4 r;
+    r.s = _mm_sub_ps(_mm_mul_ps(a.s, b.s),
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z)));
+    r.x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.s, b.x), _mm_mul_ps(b.s, a.x)),
+      _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)));
+    r.y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.s, b.y), _mm_mul_ps(b.s, a.y)),
+      _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)));
+    r.z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.s, b.z), _mm_mul_ps(b.s, a.z)),
+      _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)));
+    return r;
+  }
+
+  // q * v * conjugate(q) for unit q, as Quaternion::operator*(vec3)
+  Vec4x3 Rotate(const Quat4& q, const Vec4x3& v)
+  {
+    // t = 2 * cross(q.v, v), v' = v + s * t + cross(q.v, t)
+    __m128 two = _mm_set1_ps(2.f);
+    __m128 tx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q.y, v.z), _mm_mul_ps(q.z, v.y)));
+    __m128 ty = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q.z, v.x), _mm_mul_ps(q.x, v.z)));
+    __m128 tz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q.x, v.y), _mm_mul_ps(q.y, v.x)));
+    Vec4x3 r;
+    r.x = _mm_add_ps(_mm_add_ps(v.x, _mm_mul_ps(q.s, tx)), _mm_sub_ps(_mm_mul_ps(q.y, tz), _mm_mul_ps(q.z, ty)));
+    r.y = _mm_add_ps(_mm_add_ps(v.y, _mm_mul_ps(q.s, ty)), _mm_sub_ps(_mm_mul_ps(q.z, tx), _mm_mul_ps(q.x, tz)));
+    r.z = _mm_add_ps(_mm_add_ps(v.z, _mm_mul_ps(q.s, tz)), _mm_sub_ps(_mm_mul_ps(q.x, ty), _mm_mul_ps(q.y, tx)));
+    return r;
+  }
+
+  Quat4 Nlerp(const Quat4& a, Quat4 b, __m128 t)
+  {
+    ShorterArc(a, b);
+    Quat4 r;
+    r.s = _mm_add_ps(a.s, _mm_mul_ps(_mm_sub_ps(b.s, a.s), t));
+    r.x = _mm_add_ps(a.x, _mm_mul_ps(_mm_sub_ps(b.x, a.x), t));
+    r.y = _mm_add_ps(a.y, _mm_mul_ps(_mm_sub_ps(b.y, a.y), t));
+    r.z = _mm_add_ps(a.z, _mm_mul_ps(_mm_sub_ps(b.z, a.z), t));
+    return Normalize(r);
+  }
+
+  // "a fast and accurate algorithm for computing slerp", d. eberly. the slerp weights
+  // sin(t * theta) / sin(theta) are series in cos(theta) - 1, evaluated with horner's rule
+  constexpr int SLERP_TERMS = 8;
+  constexpr float SLERP_MU = 1.85298109240830f; // corrects the truncated last term
+  struct SlerpCoefficients
+  {
+    float u[SLERP_TERMS];
+    float v[SLERP_TERMS];
+    SlerpCoefficients()
+    {
+      for (int i = 0; i < SLERP_TERMS; ++i)
+      {
+        float n = static_cast<float>(i + 1);
+        u[i] = 1.f / (n * (2.f * n + 1.f));
+        v[i] = n / (2.f * n + 1.f);
+      }
+      u[SLERP_TERMS - 1] *= SLERP_MU;
+      v[SLERP_TERMS - 1] *= SLERP_MU;
+    }
+  };
+  const SlerpCoefficients slerpCoefficients;
+
+  Quat4 Slerp(const Quat4& a, Quat4 b, __m128 t)
+  {
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 xm1 = _mm_sub_ps(ShorterArc(a, b), one);
+    __m128 d = _mm_sub_ps(one, t);
+    __m128 sqrT = _mm_mul_ps(t, t);
+    __m128 sqrD = _mm_mul_ps(d, d);
+
+    __m128 weightT = one;
+    __m128 weightD = one;
+    for (int i = SLERP_TERMS - 1; i >= 0; --i)
+    {
+      __m128 u = _mm_set1_ps(slerpCoefficients.u[i]);
+      __m128 v = _mm_set1_ps(slerpCoefficients.v[i]);
+      __m128 bT = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrT), v), xm1);
+      __m128 bD = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrD), v), xm1);
+      weightT = _mm_add_ps(one, _mm_mul_ps(bT, weightT));
+      weightD = _mm_add_ps(one, _mm_mul_ps(bD, weightD));
+    }
+    weightT = _mm_mul_ps(weightT, t);
+    weightD = _mm_mul_ps(weightD, d);
+
+    Quat4 r;
+    r.s = _mm_add_ps(_mm_mul_ps(a.s, weightD), _mm_mul_ps(b.s, weightT));
+    r.x = _mm_add_ps(_mm_mul_ps(a.x, weightD), _mm_mul_ps(b.x, weightT));
+    r.y = _mm_add_ps(_mm_mul_ps(a.y, weightD), _mm_mul_ps(b.y, weightT));
+    r.z = _mm_add_ps(_mm_mul_ps(a.z, weightD), _mm_mul_ps(b.z, weightT));
+    return Normalize(r);
+  }
+
+  // Interpolation::CorrectedNlerpFactor per lane, then nlerp
+  Quat4 CorrectedNlerp(const Quat4& a, Quat4 b, __m128 t)
+  {
+    __m128 d = ShorterArc(a, b);
+    __m128 half = _mm_sub_ps(t, _mm_set1_ps(0.5f));
+    __m128 k0 = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f),
+      _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+    __m128 k1 = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f),
+      _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+    __m128 k = _mm_add_ps(_mm_mul_ps(k0, _mm_mul_ps(half, half)), k1);
+    __m128 bent = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, half), _mm_mul_ps(_mm_sub_ps(t, _mm_set1_ps(1.f)), k)));
+    return Nlerp(a, b, bent);
+  }
+
+  // runs block(i, lanes) for every group of four, the tail is copied through
+  // identity padded scratch arrays by the caller's block
+  template <typename Block>
+  void ForEachBlock(size_t count, Block block)
+  {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+      block(i, 4);
+    if (i < count)
+      block(i, static_cast<int>(count - i));
+  }
+
+  // copies up to four elements into a padded group, so tails run through the same kernel
+  template <typename T>
+  const T* Pad(const T* in, int lanes, T (&scratch)[4], const T& fill)
+  {
+    if (lanes == 4)
+      return in;
+    for (int k = 0; k < 4; ++k)
+      scratch[k] = k < lanes ? in[k] : fill;
+    return scratch;
+  }
+
+  template <typename T, typename Result>
+  void Write(const Result& result, T* out, int lanes)
+  {
+    if (lanes == 4)
+    {
+      Store(result, out);
+      return;
+    }
+    T scratch[4];
+    Store(result, scratch);
+    std::copy(scratch, scratch + lanes, out);
+  }
+
+  __m128 LoadT(const float* t, int lanes)
+  {
+    alignas(16) float padded[4] = { 0.f, 0.f, 0.f, 0.f };
+    std::copy(t, t + lanes, padded);
+    return _mm_load_ps(padded);
+  }
+}
+
+void QuaternionBatch::Multiply(const Quaternion* a, const Quaternion* b, Quaternion* out, size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sa[4], sb[4];
+      Quat4 qa = Load(Pad(a + i, lanes, sa, Quaternion()));
+      Quat4 qb = Load(Pad(b + i, lanes, sb, Quaternion()));
+      Write(::Multiply(qa, qb), out + i, lanes);
+    });
+}
+
+void QuaternionBatch::Nlerp(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sa[4], sb[4];
+      Quat4 qa = Load(Pad(a + i, lanes, sa, Quaternion()));
+      Quat4 qb = Load(Pad(b + i, lanes, sb, Quaternion()));
+      Write(::Nlerp(qa, qb, LoadT(t + i, lanes)), out + i, lanes);
+    });
+}
+
+void QuaternionBatch::Nlerp(const Quaternion* a, const Quaternion* b, float t, Quaternion* out, size_t count)
+{
+  __m128 weight = _mm_set1_ps(t);
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sa[4], sb[4];
+      Quat4 qa = Load(Pad(a + i, lanes, sa, Quaternion()));
+      Quat4 qb = Load(Pad(b + i, lanes, sb, Quaternion()));
+      Write(::Nlerp(qa, qb, weight), out + i, lanes);
+    });
+}
+
+void QuaternionBatch::Slerp(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sa[4], sb[4];
+      Quat4 qa = Load(Pad(a + i, lanes, sa, Quaternion()));
+      Quat4 qb = Load(Pad(b + i, lanes, sb, Quaternion()));
+      Write(::Slerp(qa, qb, LoadT(t + i, lanes)), out + i, lanes);
+    });
+}
+
+void QuaternionBatch::CorrectedNlerp(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out,
+  size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sa[4], sb[4];
+      Quat4 qa = Load(Pad(a + i, lanes, sa, Quaternion()));
+      Quat4 qb = Load(Pad(b + i, lanes, sb, Quaternion()));
+      Write(::CorrectedNlerp(qa, qb, LoadT(t + i, lanes)), out + i, lanes);
+    });
+}
+
+void QuaternionBatch::Interpolate(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out,
+  size_t count, RotationInterpolation mode)
+{
+  switch (mode)
+  {
+  case RotationInterpolation::CorrectedNlerp:
+    CorrectedNlerp(a, b, t, out, count);
+    break;
+  case RotationInterpolation::Nlerp:
+    Nlerp(a, b, t, out, count);
+    break;
+  default:
+    Slerp(a, b, t, out, count);
+    break;
+  }
+}
+
+void QuaternionBatch::ToMat4(const glm::vec3* translation, const Quaternion* rotation, const glm::vec3* scale,
+  glm::mat4* out, size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sq[4];
+      glm::vec3 st[4], ss[4];
+      Quat4 q = Load(Pad(rotation + i, lanes, sq, Quaternion()));
+      Vec4x3 t = Load(Pad(translation + i, lanes, st, glm::vec3(0.f)));
+      Vec4x3 s = Load(Pad(scale + i, lanes, ss, glm::vec3(1.f)));
+
+      // Quaternion::toMat3 columns, scaled per axis
+      __m128 one = _mm_set1_ps(1.f);
+      __m128 two = _mm_set1_ps(2.f);
+      __m128 xx = _mm_mul_ps(q.x, q.x), yy = _mm_mul_ps(q.y, q.y), zz = _mm_mul_ps(q.z, q.z);
+      __m128 xy = _mm_mul_ps(q.x, q.y), xz = _mm_mul_ps(q.x, q.z), yz = _mm_mul_ps(q.y, q.z);
+      __m128 sx = _mm_mul_ps(q.s, q.x), sy = _mm_mul_ps(q.s, q.y), sz = _mm_mul_ps(q.s, q.z);
+
+      __m128 m[12];
+      m[0] = _mm_mul_ps(s.x, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+      m[1] = _mm_mul_ps(s.x, _mm_mul_ps(two, _mm_add_ps(xy, sz)));
+      m[2] = _mm_mul_ps(s.x, _mm_mul_ps(two, _mm_sub_ps(xz, sy)));
+      m[3] = _mm_mul_ps(s.y, _mm_mul_ps(two, _mm_sub_ps(xy, sz)));
+      m[4] = _mm_mul_ps(s.y, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+      m[5] = _mm_mul_ps(s.y, _mm_mul_ps(two, _mm_add_ps(yz, sx)));
+      m[6] = _mm_mul_ps(s.z, _mm_mul_ps(two, _mm_add_ps(xz, sy)));
+      m[7] = _mm_mul_ps(s.z, _mm_mul_ps(two, _mm_sub_ps(yz, sx)));
+      m[8] = _mm_mul_ps(s.z, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+      m[9] = t.x;
+      m[10] = t.y;
+      m[11] = t.z;
+
+      alignas(16) float lane[12][4];
+      for (int k = 0; k < 12; ++k)
+        _mm_store_ps(lane[k], m[k]);
+      for (int l = 0; l < lanes; ++l)
+      {
+        glm::mat4& r = out[i + l];
+        r[0] = glm::vec4(lane[0][l], lane[1][l], lane[2][l], 0.f);
+        r[1] = glm::vec4(lane[3][l], lane[4][l], lane[5][l], 0.f);
+        r[2] = glm::vec4(lane[6][l], lane[7][l], lane[8][l], 0.f);
+        r[3] = glm::vec4(lane[9][l], lane[10][l], lane[11][l], 1.f);
+      }
+    });
+}
+
+void QuaternionBatch::Compose(const glm::vec3* translationA, const Quaternion* rotationA, const glm::vec3* scaleA,
+  const glm::vec3* translationB, const Quaternion* rotationB, const glm::vec3* scaleB,
+  glm::vec3* translation, Quaternion* rotation, glm::vec3* scale, size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sqa[4], sqb[4];
+      glm::vec3 sta[4], ssa[4], stb[4], ssb[4];
+      Quat4 qa = Load(Pad(rotationA + i, lanes, sqa, Quaternion()));
+      Quat4 qb = Load(Pad(rotationB + i, lanes, sqb, Quaternion()));
+      Vec4x3 ta = Load(Pad(translationA + i, lanes, sta, glm::vec3(0.f)));
+      Vec4x3 sa = Load(Pad(scaleA + i, lanes, ssa, glm::vec3(1.f)));
+      Vec4x3 tb = Load(Pad(translationB + i, lanes, stb, glm::vec3(0.f)));
+      Vec4x3 sb = Load(Pad(scaleB + i, lanes, ssb, glm::vec3(1.f)));
+
+      // v = qa * (sa * vb) + va, q = qa * qb, s = sa * sb
+      Vec4x3 scaled = { _mm_mul_ps(sa.x, tb.x), _mm_mul_ps(sa.y, tb.y), _mm_mul_ps(sa.z, tb.z) };
+      Vec4x3 v = Rotate(qa, scaled);
+      v.x = _mm_add_ps(v.x, ta.x);
+      v.y = _mm_add_ps(v.y, ta.y);
+      v.z = _mm_add_ps(v.z, ta.z);
+      Vec4x3 s = { _mm_mul_ps(sa.x, sb.x), _mm_mul_ps(sa.y, sb.y), _mm_mul_ps(sa.z, sb.z) };
+
+      Write(v, translation + i, lanes);
+      Write(::Multiply(qa, qb), rotation + i, lanes);
+      Write(s, scale + i, lanes);
+    });
+}
+
+void QuaternionBatch::Inverse(const glm::vec3* translationIn, const Quaternion* rotationIn, const glm::vec3* scaleIn,
+  glm::vec3* translation, Quaternion* rotation, glm::vec3* scale, size_t count)
+{
+  ForEachBlock(count, [&](size_t i, int lanes)
+    {
+      Quaternion sq[4];
+      glm::vec3 st[4], ss[4];
+      Quat4 q = Load(Pad(rotationIn + i, lanes, sq, Quaternion()));
+      Vec4x3 t = Load(Pad(translationIn + i, lanes, st, glm::vec3(0.f)));
+      Vec4x3 s = Load(Pad(scaleIn + i, lanes, ss, glm::vec3(1.f)));
+
+      // v = (conjugate(q) * -v) / s, q = conjugate(q), s = 1 / s
+      __m128 one = _mm_set1_ps(1.f);
+      __m128 sign = _mm_set1_ps(-0.f);
+      Quat4 conjugate = { q.s, _mm_xor_ps(q.x, sign), _mm_xor_ps(q.y, sign), _mm_xor_ps(q.z, sign) };
+      Vec4x3 negated = { _mm_xor_ps(t.x, sign), _mm_xor_ps(t.y, sign), _mm_xor_ps(t.z, sign) };
+      Vec4x3 inverseScale = { _mm_div_ps(one, s.x), _mm_div_ps(one, s.y), _mm_div_ps(one, s.z) };
+      Vec4x3 v = Rotate(conjugate, negated);
+      v.x = _mm_mul_ps(v.x, inverseScale.x);
+      v.y = _mm_mul_ps(v.y, inverseScale.y);
+      v.z = _mm_mul_ps(v.z, inverseScale.z);
+
+      Write(v, translation + i, lanes);
+      Write(conjugate, rotation + i, lanes);
+      Write(inverseScale, scale + i, lanes);
+    });
+}
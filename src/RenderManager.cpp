@@ -2,6 +2,7 @@
 #include "Engine.h"
 #include "Shader.h"
 #include "Transform.h"
+#include "Skinning.h"
 
 void RenderManager::Setup()
 {
@@ -60,6 +61,10 @@ void RenderManager::Setup()
   Spring_Program->AddShader("./shaders/spring.frag", GL_FRAGMENT_SHADER);
   Spring_Program->LinkProgram();
 
+  Skin_Program = new ShaderProgram();
+  Skin_Program->AddShader("./shaders/skin.vert", GL_VERTEX_SHADER);
+  Skin_Program->LinkProgram();
+
   clearColor_ = { 0.22f,0.22f,0.22f };
   // create empty vao
   glCreateVertexArrays(1, &emptyVAOid_);
@@ -70,6 +75,8 @@ void RenderManager::Setup()
 
 void RenderManager::Update()
 {
+  UploadBonePalette();
+  SkinningPass();
   MRT_Pass();
   ShadowPass();
   LightingPass();
@@ -327,6 +334,151 @@ void RenderManager::EndFrame()
   glfwSwapBuffers(Engine::managers_.GetManager<WindowManager*>()->GetHandle());
 }
 
+namespace
+{
+  // grow only storage buffer bound to an indexed ssbo binding, the bound range is the data size
+  template <typename T>
+  void UploadStorage(GLuint& buffer, size_t& capacity, GLuint binding, const std::vector<T>& data)
+  {
+    if (data.size() > capacity)
+    {
+      if (buffer)
+        glDeleteBuffers(1, &buffer);
+      glCreateBuffers(1, &buffer);
+      glNamedBufferStorage(buffer, data.size() * sizeof(T), nullptr, GL_DYNAMIC_STORAGE_BIT);
+      capacity = data.size();
+    }
+    glNamedBufferSubData(buffer, 0, data.size() * sizeof(T), data.data());
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, 0, data.size() * sizeof(T));
+  }
+}
+
+void RenderManager::UploadBonePalette()
+{
+  bonePalette_.clear();
+  instanceTransforms_.clear();
+  instancePlayback_.clear();
+  dualQuaternionPalette_.clear();
+
+  // only one of the two palettes is filled, the other keeps a single placeholder
+  auto* am = Engine::managers_.GetManager<AnimationManager*>();
+  auto appendPalette = [this](Animator& animator)
+  {
+    if (dualQuaternionSkinning)
+    {
+      auto& dualQuaternions = animator.GetFinalBoneDualQuaternions();
+      dualQuaternionPalette_.insert(dualQuaternionPalette_.end(), dualQuaternions.begin(), dualQuaternions.end());
+    }
+    else
+    {
+      auto& transforms = animator.GetFinalBoneMatrices();
+      bonePalette_.insert(bonePalette_.end(), transforms.begin(), transforms.end());
+    }
+  };
+  if (am->animator)
+    appendPalette(*am->animator);
+  // every crowd palette has the primary's size, instance i starts at (i + 1) * size
+  bool baked = am->bakedPlayback && !am->baked.Empty();
+  for (auto& instance : am->crowd)
+  {
+    if (baked)
+    {
+      instancePlayback_.push_back(glm::vec4(instance.phaseOffset, instance.playbackSpeed, 0.f, 0.f));
+    }
+    else
+    {
+      appendPalette(*instance.animator);
+    }
+    instanceTransforms_.push_back(instance.modelTr);
+  }
+
+  // unanimated scenes still bind one identity matrix so the programs have a valid buffer
+  if (bonePalette_.empty())
+    bonePalette_.push_back(glm::mat4(1.f));
+  if (instanceTransforms_.empty())
+    instanceTransforms_.push_back(glm::mat4(1.f));
+  if (instancePlayback_.empty())
+    instancePlayback_.push_back(glm::vec4(0.f, 1.f, 0.f, 0.f));
+  if (dualQuaternionPalette_.empty())
+    dualQuaternionPalette_.push_back(DualQuaternion());
+
+  CHECKERROR;
+  UploadStorage(bonePaletteSSBO_, bonePaletteCapacity_, BONE_PALETTE_BINDING, bonePalette_);
+  UploadStorage(instanceSSBO_, instanceCapacity_, INSTANCE_BINDING, instanceTransforms_);
+  UploadStorage(instancePlaybackSSBO_, instancePlaybackCapacity_, INSTANCE_PLAYBACK_BINDING, instancePlayback_);
+  UploadStorage(dualQuaternionSSBO_, dualQuaternionCapacity_, DUAL_QUATERNION_BINDING, dualQuaternionPalette_);
+  // the baked clip only changes when it is rebaked
+  if (bakedVersion_ != am->bakeVersion || !bakedSSBO_)
+  {
+    bakedVersion_ = am->bakeVersion;
+    UploadStorage(bakedSSBO_, bakedCapacity_, BAKED_BINDING,
+      am->baked.Empty() ? std::vector<glm::mat4>(1, glm::mat4(1.f)) : am->baked.matrices);
+  }
+  CHECKERROR;
+}
+
+void RenderManager::SkinningPass()
+{
+  auto* am = Engine::managers_.GetManager<AnimationManager*>();
+  if (!am->model || !am->animator)
+    return;
+
+  auto& meshes = am->model->meshes;
+  if (!preSkinning)
+  {
+    for (auto& mesh : meshes)
+      mesh.preSkinned = false;
+    return;
+  }
+
+  CHECKERROR;
+  if (cpuSkinning)
+  {
+    for (auto& mesh : meshes)
+    {
+      mesh.SetupSkinnedBuffer();
+      mesh.skinnedVertices.resize(2 * mesh.Position.size());
+      if (dualQuaternionSkinning)
+      {
+        auto& palette = am->animator->GetFinalBoneDualQuaternions();
+        Skinning::SkinVerticesDualQuaternion(mesh.Position.data(), mesh.Normal.data(), mesh.m_BoneIDs.data(),
+          mesh.m_Weights.data(), mesh.Position.size(), palette.data(), palette.size(), mesh.skinnedVertices.data());
+      }
+      else
+      {
+        auto& palette = am->animator->GetFinalBoneMatrices();
+        Skinning::SkinVertices(mesh.Position.data(), mesh.Normal.data(), mesh.m_BoneIDs.data(), mesh.m_Weights.data(),
+          mesh.Position.size(), palette.data(), palette.size(), mesh.skinnedVertices.data());
+      }
+      glNamedBufferSubData(mesh.skinnedVBO, 0, mesh.skinnedVertices.size() * sizeof(glm::vec3), mesh.skinnedVertices.data());
+      mesh.preSkinned = true;
+    }
+  }
+  else
+  {
+    // every vertex is one point, the palette is bound by UploadBonePalette
+    glEnable(GL_RASTERIZER_DISCARD);
+    Skin_Program->Use();
+    int loc = glGetUniformLocation(Skin_Program->programID, "dualQuaternion");
+    glUniform1i(loc, dualQuaternionSkinning ? 1 : 0);
+    for (auto& mesh : meshes)
+    {
+      mesh.SetupSkinnedBuffer();
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, mesh.skinnedVBO);
+      glBindVertexArray(mesh.VAO);
+      glBeginTransformFeedback(GL_POINTS);
+      glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(mesh.Position.size()));
+      glEndTransformFeedback();
+      mesh.preSkinned = true;
+    }
+    glBindVertexArray(0);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    Skin_Program->UnUse();
+    glDisable(GL_RASTERIZER_DISCARD);
+  }
+  CHECKERROR;
+}
+
 void RenderManager::MRT_Pass()
 {
   glViewport(0, 0, width, height);
@@ -351,21 +503,7 @@ void RenderManager::MRT_Pass()
   loc = glGetUniformLocation(MRT_Program->programID, "WorldInverse");
   glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(Engine::managers_.GetManager<CameraManager*>()->WorldInverse));
 
-  // send animation data to shader
-  CHECKERROR;
-  auto* am = Engine::managers_.GetManager<AnimationManager*>();
-  if (am->animator)
-  {
-    auto transforms = am->animator->GetFinalBoneMatrices();
-    for (int i = 0; i < transforms.size(); ++i)
-    {
-      std::string name = "finalBonesMatrices[" + std::to_string(i) + "]";
-      loc = glGetUniformLocation(MRT_Program->programID, name.c_str());
-      glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(transforms[i]));
-    }
-  }
-
-
+  // bone palette is already bound by UploadBonePalette
   CHECKERROR;
   Engine::managers_.GetManager<ObjectManager*>()->Draw(MRT_Program);
 
@@ -402,20 +540,6 @@ void RenderManager::ShadowPass()
   loc = glGetUniformLocation(Shadow_Program->programID, "ProjectionMatrix");
   glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(sun.SunProj));
 
-  // send animation data to shader
-  CHECKERROR;
-  auto* am = Engine::managers_.GetManager<AnimationManager*>();
-  if (am->animator)
-  {
-    auto transforms = am->animator->GetFinalBoneMatrices();
-    for (int i = 0; i < transforms.size(); ++i)
-    {
-      std::string name = "finalBonesMatrices[" + std::to_string(i) + "]";
-      loc = glGetUniformLocation(Shadow_Program->programID, name.c_str());
-      glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(transforms[i]));
-    }
-  }
-
   CHECKERROR;
   Engine::managers_.GetManager<ObjectManager*>()->Draw(Shadow_Program);
   CHECKERROR;
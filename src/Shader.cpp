@@ -1,6 +1,9 @@
 #include "Shader.h"
 #include <fstream>
 #include <iostream>
+#include <sstream>
+
+constexpr int MAX_INCLUDE_DEPTH = 8;
 
 char* ShaderProgram::ReadFile(const char* name)
 {
@@ -18,6 +21,35 @@ char* ShaderProgram::ReadFile(const char* name)
   return content;
 }
 
+std::string ShaderProgram::ReadSource(const std::string& name, int depth)
+{
+  std::ifstream file(name);
+  if (!file)
+  {
+    std::cout << "Shader source not found: " << name << std::endl;
+    return std::string();
+  }
+
+  std::string directory = name.substr(0, name.find_last_of("/\\") + 1);
+  std::stringstream source;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    size_t first = line.find('"');
+    size_t last = line.rfind('"');
+    if (line.compare(0, 8, "#include") == 0 && first != std::string::npos && last > first)
+    {
+      if (depth < MAX_INCLUDE_DEPTH)
+        source << ReadSource(directory + line.substr(first + 1, last - first - 1), depth + 1);
+      else
+        std::cout << "Shader include too deep in " << name << std::endl;
+      continue;
+    }
+    source << line << '\n';
+  }
+  return source.str();
+}
+
 ShaderProgram::ShaderProgram()
 {
   programID = glCreateProgram();
@@ -30,16 +62,15 @@ ShaderProgram::~ShaderProgram()
 
 void ShaderProgram::AddShader(const char* fileName, const GLenum type)
 {
-  // Read the source from the named file
-  char* src = ReadFile(fileName);
-  const char* psrc[1] = { src };
+  // Read the source from the named file, shared code is pulled in by #include
+  std::string src = ReadSource(fileName);
+  const char* psrc[1] = { src.c_str() };
 
   // Create a shader and attach, hand it the source, and compile it.
   int shader = glCreateShader(type);
   glAttachShader(programID, shader);
   glShaderSource(shader, 1, psrc, NULL);
   glCompileShader(shader);
-  delete src;
 
   // Get the compilation status
   int status;
@@ -1,8 +1,43 @@
 #include "Shape.h"
 #include "transform.h"
+#include "ConvexHull.h"
+#include "MeshBVH.h"
 #include <algorithm>
 #include <iostream>
 
+Shape::~Shape()
+{
+  delete hull_;
+  delete bvh_;
+}
+
+ConvexHull* Shape::GetHull()
+{
+  if (!hull_)
+    hull_ = new ConvexHull(Pnt);
+  return hull_;
+}
+
+MeshBVH* Shape::GetBVH()
+{
+  if (!bvh_)
+  {
+    std::vector<glm::vec3> vertices(Pnt.size());
+    for (size_t i = 0; i < Pnt.size(); ++i)
+      vertices[i] = glm::vec3(Pnt[i]);
+    std::vector<unsigned int> indices;
+    indices.reserve(Tri.size() * 3);
+    for (auto& tri : Tri)
+    {
+      indices.push_back(tri.x);
+      indices.push_back(tri.y);
+      indices.push_back(tri.z);
+    }
+    bvh_ = new MeshBVH(vertices, indices);
+  }
+  return bvh_;
+}
+
 void Shape::pushquad(std::vector<glm::ivec3>& Tri, int i, int j, int k, int l)
 {
   Tri.push_back(glm::ivec3(i, j, k));
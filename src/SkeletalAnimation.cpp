@@ -1,34 +1,112 @@
 #include "SkeletalAnimation.h"
 
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
 #include "Engine.h"
 #include "Transform.h"
+#include "MappedFile.h"
+
+namespace
+{
+  constexpr uint32_t CACHE_MAGIC = 0x4d494e41; // "ANIM"
+  constexpr uint32_t CACHE_VERSION = 1;
+  const char* CACHE_DIR = "./cache";
+  constexpr int CACHE_MAX_DEPTH = 256; // deeper node trees are treated as corrupt
+  // smallest serialized node: name length, transformation and child count
+  constexpr size_t CACHE_MIN_NODE_SIZE = sizeof(uint32_t) + sizeof(glm::mat4) + sizeof(int);
+
+  // bounds checked reads from a mapped cache file
+  struct CacheReader
+  {
+    const unsigned char* cursor;
+    const unsigned char* end;
+
+    bool Read(void* dest, size_t size)
+    {
+      if (static_cast<size_t>(end - cursor) < size)
+        return false;
+      memcpy(dest, cursor, size);
+      cursor += size;
+      return true;
+    }
+
+    size_t Remaining() const
+    {
+      return static_cast<size_t>(end - cursor);
+    }
+
+    // counts come from the file, they are checked against what is left before allocating
+    template <typename T>
+    bool Read(std::vector<T>& dest, uint32_t count)
+    {
+      if (Remaining() / sizeof(T) < count)
+        return false;
+      dest.resize(count);
+      return Read(dest.data(), count * sizeof(T));
+    }
+
+    bool Read(std::string& dest)
+    {
+      uint32_t length = 0;
+      if (!Read(&length, sizeof(length)) || static_cast<size_t>(end - cursor) < length)
+        return false;
+      dest.assign(reinterpret_cast<const char*>(cursor), length);
+      cursor += length;
+      return true;
+    }
+
+    bool Read(NodeData& node, int depth = 0)
+    {
+      if (depth > CACHE_MAX_DEPTH || !Read(node.name) || !Read(&node.transformation, sizeof(node.transformation)) ||
+        !Read(&node.childrenCount, sizeof(node.childrenCount)) || node.childrenCount < 0 ||
+        Remaining() / CACHE_MIN_NODE_SIZE < static_cast<size_t>(node.childrenCount))
+        return false;
+      node.children.resize(node.childrenCount);
+      for (auto& child : node.children)
+      {
+        if (!Read(child, depth + 1))
+          return false;
+      }
+      return true;
+    }
+  };
+
+  void WriteString(std::ofstream& file, const std::string& s)
+  {
+    uint32_t length = static_cast<uint32_t>(s.size());
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(s.data(), length);
+  }
+
+  void WriteNode(std::ofstream& file, const NodeData& node)
+  {
+    WriteString(file, node.name);
+    file.write(reinterpret_cast<const char*>(&node.transformation), sizeof(node.transformation));
+    file.write(reinterpret_cast<const char*>(&node.childrenCount), sizeof(node.childrenCount));
+    for (auto& child : node.children)
+      WriteNode(file, child);
+  }
+}
 
 void SkeletalAnimation::ReadMissingBones(const aiAnimation* animation, Model& model)
 {
   int size = animation->mNumChannels;
 
-  auto& boneInfoMap = model.getBoneInfoMap();//getting m_BoneInfoMap from Model class
-  int& boneCount = model.getBoneCount(); //getting the m_BoneCounter from Model class
+  BoneTable& boneTable = model.getBoneTable(); // bones of the mesh are already interned
 
   //reading channels(bones engaged in an animation and their keyframes)
   for (int i = 0; i < size; i++)
   {
     auto channel = animation->mChannels[i];
-    std::string boneName = channel->mNodeName.data;
-
-    if (boneInfoMap.find(boneName) == boneInfoMap.end())
-    {
-      boneInfoMap[boneName].id = boneCount;
-      boneCount++;
-    }
-    m_Bones.push_back(
-      Bone(channel->mNodeName.data, boneInfoMap[channel->mNodeName.data].id, channel)
-    );
+    m_Bones.push_back(Bone(channel->mNodeName.data, boneTable.Intern(channel->mNodeName.data), channel));
   }
 
-  m_BoneInfoMap = boneInfoMap;
+  m_BoneTable = &boneTable;
+  BuildBoneTracks();
 }
 
 void SkeletalAnimation::ReadHeirarchyData(NodeData& dest, const aiNode* src)
@@ -42,13 +120,10 @@ void SkeletalAnimation::ReadHeirarchyData(NodeData& dest, const aiNode* src)
   dest.transformation = AssimpHelper::ConvertRowMajorToColumnMajor(matrix);
   dest.childrenCount = src->mNumChildren;
 
-  // go through each children and read them
+  // go through each children and read them in place
+  dest.children.resize(src->mNumChildren);
   for (int i = 0; i < src->mNumChildren; i++)
-  {
-    NodeData newData;
-    ReadHeirarchyData(newData, src->mChildren[i]);
-    dest.children.push_back(newData);
-  }
+    ReadHeirarchyData(dest.children[i], src->mChildren[i]);
 }
 
 SkeletalAnimation::~SkeletalAnimation()
@@ -60,26 +135,178 @@ SkeletalAnimation::~SkeletalAnimation()
 
 SkeletalAnimation::SkeletalAnimation(const std::string& animationPath, Model* model)
 {
-  Assimp::Importer importer;
-  const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
-  assert(scene && scene->mRootNode);
-  auto animation = scene->mAnimations[0];
-  m_Duration = animation->mDuration;
-  m_TicksPerSecond = animation->mTicksPerSecond;
-  ReadHeirarchyData(m_RootNode, scene->mRootNode);
-  ReadMissingBones(animation, *model);
-}
+  // assimp only runs on the first import, later loads map the baked file
+  uint64_t key = HashFile(animationPath);
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.anim", static_cast<unsigned long long>(key));
+  std::string cachePath = std::string(CACHE_DIR) + "/" + name;
 
-Bone* SkeletalAnimation::FindBone(const std::string& name)
-{
-  for (int i = 0; i < m_Bones.size(); ++i)
+  if (!LoadCache(cachePath, key, *model))
   {
-    if (m_Bones[i].getBoneName() == name)
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
+    assert(scene && scene->mRootNode);
+    auto animation = scene->mAnimations[0];
+    m_Duration = animation->mDuration;
+    m_TicksPerSecond = animation->mTicksPerSecond;
+    ReadHeirarchyData(m_RootNode, scene->mRootNode);
+    ReadMissingBones(animation, *model);
+
+    std::error_code error;
+    std::filesystem::create_directories(CACHE_DIR, error);
+    if (key != 0 && !SaveCache(cachePath, key))
+      std::cout << "SkeletalAnimation: failed to write " << cachePath << std::endl;
+  }
+
+  // names are resolved once here, never while animating
+  BuildFlatSkeleton(m_RootNode, -1);
+
+  // children come after parents, so one backward pass accumulates every subtree
+  m_Skeleton.reach.assign(m_Skeleton.parent.size(), 0.f);
+  for (size_t i = m_Skeleton.parent.size(); i-- > 0;)
+  {
+    int parent = m_Skeleton.parent[i];
+    if (parent >= 0)
     {
-      return &m_Bones[i];
+      float length = glm::length(glm::vec3(m_Skeleton.transformation[i][3]));
+      m_Skeleton.reach[parent] = std::max(m_Skeleton.reach[parent], length + m_Skeleton.reach[i]);
     }
+    m_Skeleton.maxReach = std::max(m_Skeleton.maxReach, m_Skeleton.reach[i]);
+  }
+
+  m_CompressedClip.Compress(m_Bones, m_Skeleton, m_Duration);
+}
+
+// fnv-1a over the file contents, 0 when the file can not be read
+uint64_t SkeletalAnimation::HashFile(const std::string& path)
+{
+  MappedFile file(path);
+  if (!file.IsOpen())
+    return 0;
+
+  return HashBytes(file.Data(), file.Size());
+}
+
+// magic, version, key, duration, ticks, node tree in pre-order, then every bone's tracks
+bool SkeletalAnimation::SaveCache(const std::string& path, uint64_t key) const
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  uint32_t header[2] = { CACHE_MAGIC, CACHE_VERSION };
+  int32_t ticks = m_TicksPerSecond;
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+  file.write(reinterpret_cast<const char*>(&m_Duration), sizeof(m_Duration));
+  file.write(reinterpret_cast<const char*>(&ticks), sizeof(ticks));
+  WriteNode(file, m_RootNode);
+
+  uint32_t boneCount = static_cast<uint32_t>(m_Bones.size());
+  file.write(reinterpret_cast<const char*>(&boneCount), sizeof(boneCount));
+  for (auto& bone : m_Bones)
+  {
+    WriteString(file, bone.getBoneName());
+    uint32_t keyCount = static_cast<uint32_t>(bone.getTimes().size());
+    file.write(reinterpret_cast<const char*>(&keyCount), sizeof(keyCount));
+    file.write(reinterpret_cast<const char*>(bone.getTimes().data()), keyCount * sizeof(float));
+    file.write(reinterpret_cast<const char*>(bone.getPositions().data()), keyCount * sizeof(glm::vec3));
+    file.write(reinterpret_cast<const char*>(bone.getRotations().data()), keyCount * sizeof(Quaternion));
+    file.write(reinterpret_cast<const char*>(bone.getScales().data()), keyCount * sizeof(glm::vec3));
   }
-  return nullptr;
+  return static_cast<bool>(file);
+}
+
+// bone ids are not baked, they are resolved against the model like ReadMissingBones does
+bool SkeletalAnimation::LoadCache(const std::string& path, uint64_t key, Model& model)
+{
+  if (key == 0)
+    return false;
+
+  MappedFile file(path);
+  if (!file.IsOpen())
+    return false;
+
+  CacheReader reader = { file.Data(), file.Data() + file.Size() };
+  uint32_t header[2] = {};
+  uint64_t fileKey = 0;
+  int32_t ticks = 0;
+  uint32_t boneCount = 0;
+  NodeData root;
+  if (!reader.Read(header, sizeof(header)) || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION ||
+    !reader.Read(&fileKey, sizeof(fileKey)) || fileKey != key ||
+    !reader.Read(&m_Duration, sizeof(m_Duration)) || !reader.Read(&ticks, sizeof(ticks)) ||
+    !reader.Read(root) || !reader.Read(&boneCount, sizeof(boneCount)))
+    return false;
+
+  // every bone stores at least its name length and key count
+  if (reader.Remaining() / (2 * sizeof(uint32_t)) < boneCount)
+    return false;
+
+  std::vector<std::string> names(boneCount);
+  std::vector<std::vector<float>> times(boneCount);
+  std::vector<std::vector<glm::vec3>> positions(boneCount);
+  std::vector<std::vector<Quaternion>> rotations(boneCount);
+  std::vector<std::vector<glm::vec3>> scales(boneCount);
+  for (uint32_t i = 0; i < boneCount; ++i)
+  {
+    uint32_t keyCount = 0;
+    if (!reader.Read(names[i]) || !reader.Read(&keyCount, sizeof(keyCount)) || keyCount == 0 ||
+      !reader.Read(times[i], keyCount) || !reader.Read(positions[i], keyCount) ||
+      !reader.Read(rotations[i], keyCount) || !reader.Read(scales[i], keyCount))
+      return false;
+  }
+
+  // the file is valid, commit
+  m_TicksPerSecond = ticks;
+  m_RootNode = std::move(root);
+
+  BoneTable& boneTable = model.getBoneTable();
+  m_Bones.reserve(boneCount);
+  for (uint32_t i = 0; i < boneCount; ++i)
+  {
+    m_Bones.emplace_back(names[i], boneTable.Intern(names[i]), std::move(times[i]), std::move(positions[i]),
+      std::move(rotations[i]), std::move(scales[i]));
+  }
+  m_BoneTable = &boneTable;
+  BuildBoneTracks();
+  return true;
+}
+
+void SkeletalAnimation::BuildBoneTracks()
+{
+  m_BoneTracks.assign(m_BoneTable->Size(), -1);
+  for (size_t i = 0; i < m_Bones.size(); ++i)
+    m_BoneTracks[m_Bones[i].getBoneID()] = static_cast<int>(i);
+}
+
+// pre-order walk, a node is appended before any of its children
+void SkeletalAnimation::BuildFlatSkeleton(const NodeData& node, int parent)
+{
+  int index = static_cast<int>(m_Skeleton.parent.size());
+  m_Skeleton.parent.push_back(parent);
+  m_Skeleton.transformation.push_back(node.transformation);
+  m_Skeleton.name.push_back(node.name);
+
+  int boneID = m_BoneTable->Find(node.name);
+  m_Skeleton.bone.push_back(boneID >= 0 ? m_BoneTracks[boneID] : -1);
+  m_Skeleton.boneID.push_back(boneID);
+  m_Skeleton.offset.push_back(boneID >= 0 ? m_BoneTable->Offset(boneID) : glm::mat4(1.f));
+
+  for (int i = 0; i < node.childrenCount; ++i)
+    BuildFlatSkeleton(node.children[i], index);
+}
+
+Bone* SkeletalAnimation::FindBone(const std::string& name)
+{
+  return FindBone(m_BoneTable->Find(name));
+}
+
+Bone* SkeletalAnimation::FindBone(int boneID)
+{
+  if (boneID < 0 || boneID >= static_cast<int>(m_BoneTracks.size()) || m_BoneTracks[boneID] < 0)
+    return nullptr;
+  return &m_Bones[m_BoneTracks[boneID]];
 }
 
 float SkeletalAnimation::GetTicksPerSecond()
@@ -97,9 +324,20 @@ const NodeData& SkeletalAnimation::GetRootNode()
   return m_RootNode;
 }
 
-std::map<std::string, BoneInfo>& SkeletalAnimation::GetBoneIDMap()
+const FlatSkeleton& SkeletalAnimation::GetSkeleton() const
+{
+  return m_Skeleton;
+}
+
+const CompressedClip& SkeletalAnimation::GetCompressedClip() const
 {
-  return m_BoneInfoMap;
+  return m_CompressedClip;
+}
+
+const BoneTable& SkeletalAnimation::GetBoneTable() const
+{
+  assert(m_BoneTable);
+  return *m_BoneTable;
 }
 
 std::vector<Bone>& SkeletalAnimation::GetBonesData()
@@ -141,8 +379,7 @@ void SkeletalAnimation::DrawBone(ShaderProgram* shaderProgram)
   CHECKERROR;
 }
 
-void SkeletalAnimation::SetUpHierarchicalRender(const NodeData& root, std::map<std::string, BoneInfo>& boneIDMap,
-                                                int index)
+void SkeletalAnimation::SetUpHierarchicalRender(const NodeData& root, int index)
 {
   Bone* bone = FindBone(root.name);
 
@@ -160,7 +397,7 @@ void SkeletalAnimation::SetUpHierarchicalRender(const NodeData& root, std::map<s
     boneLocalPosition.push_back(localPosition.xyz);
 
     // get each bone offset matrix to move to bone-space
-    glm::mat4 offsetMatrix = boneIDMap[root.name].offset;
+    glm::mat4 offsetMatrix = m_BoneTable->Offset(bone->getBoneID());
 
     // get bone-space position
     glm::vec4 finalPosition = Scale(1.f, -1.f, 1.f) * offsetMatrix * localPosition;
@@ -168,8 +405,8 @@ void SkeletalAnimation::SetUpHierarchicalRender(const NodeData& root, std::map<s
     // get the bone position
     bonePosition.push_back(glm::vec3(finalPosition));
 
-    // get name of each bone in the continuous order later good for updating vbo for animating bones
-    boneName.push_back(root.name);
+    // get id of each bone in the continuous order later good for updating vbo for animating bones
+    boneIDs.push_back(bone->getBoneID());
 
     // preset index = -1 to delay 1 call to draw hierarchial bones correctly where it starts at hips, start recording at spine
     if (index != -1)
@@ -185,11 +422,28 @@ void SkeletalAnimation::SetUpHierarchicalRender(const NodeData& root, std::map<s
     {
       auto* ikm = Engine::managers_.GetManager<InverseKinematicManager*>();
       IKData data;
-      data.name = bone->getBoneName();
+      data.boneID = bone->getBoneID();
       data.index = bonePosition.size() - 1;
       data.worldPosition = glm::vec3(finalPosition);
       data.localPosition = localPosition.xyz;
 
+      // joint limits are picked by name here so the solver never compares names
+      if (root.name == "LeftForeArm" || root.name == "LeftHandIndex1" ||
+        root.name == "LeftHandIndex2" || root.name == "LeftHandIndex3")
+      {
+        data.constraint = IKConstraint::Hinge; // elbow and fingers only bend inwards
+      }
+      else if (root.name == "LeftArm")
+      {
+        data.constraint = IKConstraint::BallSocket;
+        data.coneLimit = 2.617993878f; // 150 degree
+      }
+      else if (root.name == "LeftHand")
+      {
+        data.constraint = IKConstraint::BallSocket;
+        data.coneLimit = 0.5235987756f; // 30 degree
+      }
+
       ikm->m_CCDSolver.AddBoneToChain(data);
 
       // data to draw IK chain (final position)
@@ -200,14 +454,14 @@ void SkeletalAnimation::SetUpHierarchicalRender(const NodeData& root, std::map<s
   // recursively through the hierarchical bones
   for (int i = 0; i < root.childrenCount; ++i)
   {
-    SetUpHierarchicalRender(root.children[i], boneIDMap, index);
+    SetUpHierarchicalRender(root.children[i], index);
   }
 }
 
 void SkeletalAnimation::SetUpVAO()
 {
   // preset index = -1 to delay 1 call to draw hierarchial bones correctly where it starts at hips, start recording at spine
-  SetUpHierarchicalRender(m_RootNode, m_BoneInfoMap, -1);
+  SetUpHierarchicalRender(m_RootNode, -1);
 
   CHECKERROR;
   glCreateVertexArrays(1, &boneVAO);
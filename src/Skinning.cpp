@@ -0,0 +1,105 @@
+#include "Skinning.h"
+#include "DualQuaternion.h"
+#include <xmmintrin.h>
+
+namespace
+{
+  void Store3(const __m128 v, glm::vec3& out)
+  {
+    alignas(16) float temp[4];
+    _mm_store_ps(temp, v);
+    out = glm::vec3(temp[0], temp[1], temp[2]);
+  }
+}
+
+void Skinning::SkinVertices(const glm::vec3* positions, const glm::vec3* normals, const glm::ivec4* boneIDs,
+  const glm::vec4* weights, size_t count, const glm::mat4* palette, size_t paletteSize, glm::vec3* out)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    // blend the matrix columns first, then transform position and normal once
+    __m128 c0 = _mm_setzero_ps();
+    __m128 c1 = _mm_setzero_ps();
+    __m128 c2 = _mm_setzero_ps();
+    __m128 c3 = _mm_setzero_ps();
+    bool bindPose = false;
+    for (int k = 0; k < 4; ++k)
+    {
+      int id = boneIDs[i][k];
+      if (id == -1)
+        continue;
+      if (id < 0 || static_cast<size_t>(id) >= paletteSize)
+      {
+        bindPose = true;
+        break;
+      }
+
+      const float* m = glm::value_ptr(palette[id]);
+      __m128 w = _mm_set1_ps(weights[i][k]);
+      c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(m), w));
+      c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+      c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+      c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+    }
+
+    if (bindPose)
+    {
+      out[2 * i] = positions[i];
+      out[2 * i + 1] = normals[i];
+      continue;
+    }
+
+    const glm::vec3& p = positions[i];
+    __m128 position = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y))),
+      _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3));
+
+    const glm::vec3& n = normals[i];
+    __m128 normal = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n.x)), _mm_mul_ps(c1, _mm_set1_ps(n.y))),
+      _mm_mul_ps(c2, _mm_set1_ps(n.z)));
+
+    Store3(position, out[2 * i]);
+    Store3(normal, out[2 * i + 1]);
+  }
+}
+
+void Skinning::SkinVerticesDualQuaternion(const glm::vec3* positions, const glm::vec3* normals, const glm::ivec4* boneIDs,
+  const glm::vec4* weights, size_t count, const DualQuaternion* palette, size_t paletteSize, glm::vec3* out)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    DualQuaternion blended;
+    blended.real = glm::vec4(0.f);
+    glm::vec4 pivot(0.f); // first influence, later ones are flipped onto its hemisphere
+    bool bindPose = false;
+    for (int k = 0; k < 4; ++k)
+    {
+      int id = boneIDs[i][k];
+      if (id == -1)
+        continue;
+      if (id < 0 || static_cast<size_t>(id) >= paletteSize)
+      {
+        bindPose = true;
+        break;
+      }
+
+      const DualQuaternion& dq = palette[id];
+      if (pivot == glm::vec4(0.f))
+        pivot = dq.real;
+      float w = glm::dot(pivot, dq.real) < 0.f ? -weights[i][k] : weights[i][k];
+      blended = blended + dq * w;
+    }
+
+    if (bindPose || blended.real == glm::vec4(0.f))
+    {
+      out[2 * i] = positions[i];
+      out[2 * i + 1] = normals[i];
+      continue;
+    }
+
+    blended = blended.normalize();
+    out[2 * i] = blended.transformPoint(positions[i]);
+    out[2 * i + 1] = blended.transformVector(normals[i]);
+  }
+}
@@ -51,7 +51,7 @@ void SplineManager::Update()
     MoveAlongSpaceCurve(player, currCurve, t);
 
     // step size
-    t += Engine::managers_.GetManager<FrameRateManager*>()->delta_time / 10.f;
+    t += Engine::managers_.GetManager<FrameRateManager*>()->delta_time / LAP_SECONDS;
   }
 
   for (auto& curve : spaceCurves)
@@ -186,7 +186,7 @@ void SplineManager::MoveAlongSpaceCurve(Object* player, Spline& currCurve, float
   };
 
   // scale up to the same size as the curve
-  Position *= 500.f;
+  Position *= CURVE_SCALE;
   player->SetPosition(Position);
   player->BuildModelMatrix();
 
@@ -205,6 +205,26 @@ void SplineManager::MoveAlongSpaceCurve(Object* player, Spline& currCurve, float
   ikm->SetBoneOrientation(M);
 }
 
+void SplineManager::PredictTrajectory(const float* seconds, int count, glm::vec3* positions, glm::vec3* directions)
+{
+  Spline& curve = spaceCurves[index];
+  for (int i = 0; i < count; ++i)
+  {
+    // same speed profile as the player, the lap starts over past the end
+    float future = t + seconds[i] / LAP_SECONDS;
+    if (future > 1.f)
+      future -= 1.f;
+
+    float distance = GetS(future);
+    glm::vec3 position = curve.getInterpolatedPositionOnSpaceCurve(distance);
+    glm::vec3 ahead = curve.getInterpolatedPositionOnSpaceCurve(distance + 0.001f);
+    positions[i] = position * CURVE_SCALE;
+    glm::vec3 direction = ahead - position;
+    float length = glm::length(direction);
+    directions[i] = length > 0.f ? direction / length : glm::vec3(0.f, 0.f, 1.f);
+  }
+}
+
 std::vector<Spline>& SplineManager::getSpaceCurves()
 {
   return spaceCurves;
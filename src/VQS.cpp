@@ -17,9 +17,9 @@ VQS VQS::operator+(VQS rhs)
 {
   VQS vqs;
 
-  vqs.v += rhs.v;
-  vqs.q += rhs.q;
-  vqs.s += rhs.s;
+  vqs.v = v + rhs.v;
+  vqs.q = q + rhs.q;
+  vqs.s = s + rhs.s;
 
   return vqs;
 }
@@ -28,7 +28,7 @@ VQS VQS::operator*(VQS rhs)
 {
   VQS vqs;
 
-  vqs.v = rhs * v;
+  vqs.v = *this * rhs.v;
   vqs.q = q * rhs.q;
   vqs.s = rhs.s * s;
 
@@ -39,7 +39,6 @@ glm::vec3 VQS::operator*(glm::vec3 r)
 {
   glm::vec3 temp = s * r;
   temp = q * temp;
-  temp = q.inverse() * temp;
   temp = temp + v;
 
   return temp;
@@ -62,9 +61,8 @@ VQS VQS::inverse()
 
   glm::vec3 s_inverse(1.f / s.x, 1.f / s.y, 1.f / s.z);
   glm::vec3 temp;
-  temp = -v * s_inverse;
-  temp = q.inverse() * temp;
-  temp = q * temp;
+  temp = q.inverse() * -v;
+  temp = temp * s_inverse;
 
   vqs.v = temp;
   vqs.q = q.inverse();
@@ -83,3 +81,29 @@ VQS VQS::identity()
 
   return vqs;
 }
+
+glm::vec3 VQS::getTranslation() const
+{
+  return v;
+}
+
+Quaternion VQS::getRotation() const
+{
+  return q;
+}
+
+glm::vec3 VQS::getScale() const
+{
+  return s;
+}
+
+glm::mat4 VQS::toMat4()
+{
+  glm::mat4 res(q.toMat3());
+  res[0] *= s.x;
+  res[1] *= s.y;
+  res[2] *= s.z;
+  res[3] = glm::vec4(v, 1.f);
+
+  return res;
+}